@@ -0,0 +1,86 @@
+/**
+ * @file arena.cpp
+ * @brief Implementation of the Arena class.
+ */
+
+#include "arena.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <utility>
+#include <sys/mman.h>
+
+/**
+ * @brief Size of a transparent huge page.
+ */
+static const size_t hugePageSize = 2 << 20;
+
+Arena::Arena(size_t size, bool hugePages) :
+    m_data(nullptr),
+    m_size(size),
+    m_bytes(0),
+    m_hugePages(hugePages)
+{
+    if (hugePages)
+    {
+        // Anonymous mappings are page aligned and zero-filled
+        m_bytes = (size * sizeof(double) + hugePageSize - 1) / hugePageSize * hugePageSize;
+        void *block = mmap(nullptr, m_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (block == MAP_FAILED)
+        {
+            throw bad_alloc();
+        }
+#ifdef MADV_HUGEPAGE
+        madvise(block, m_bytes, MADV_HUGEPAGE);
+#endif
+        m_data = static_cast<double *>(block);
+    }
+    else
+    {
+        m_bytes = (size * sizeof(double) + alignment - 1) / alignment * alignment;
+        m_data = static_cast<double *>(aligned_alloc(alignment, m_bytes > 0 ? m_bytes : alignment));
+        if (!m_data)
+        {
+            throw bad_alloc();
+        }
+        memset(m_data, 0, m_bytes);
+    }
+}
+
+Arena::Arena(Arena &&other) noexcept :
+    m_data(exchange(other.m_data, nullptr)),
+    m_size(exchange(other.m_size, 0)),
+    m_bytes(exchange(other.m_bytes, 0)),
+    m_hugePages(exchange(other.m_hugePages, false))
+{
+}
+
+Arena &Arena::operator=(Arena &&other) noexcept
+{
+    if (this != &other)
+    {
+        release();
+        m_data = exchange(other.m_data, nullptr);
+        m_size = exchange(other.m_size, 0);
+        m_bytes = exchange(other.m_bytes, 0);
+        m_hugePages = exchange(other.m_hugePages, false);
+    }
+    return *this;
+}
+
+void Arena::release()
+{
+    if (!m_data)
+    {
+        return;
+    }
+    if (m_hugePages)
+    {
+        munmap(m_data, m_bytes);
+    }
+    else
+    {
+        free(m_data);
+    }
+    m_data = nullptr;
+}
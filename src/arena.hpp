@@ -0,0 +1,101 @@
+/**
+ * @file arena.hpp
+ * @brief Declaration of the Arena class, a single aligned allocation for network state.
+ */
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include <cstddef>
+
+using namespace std;
+
+/**
+ * @class Arena
+ * @brief One zero-initialized, 64-byte aligned block of doubles.
+ *
+ * Optionally backed by transparent huge pages: the block is then mapped in 2 MiB
+ * multiples and the kernel is advised to use huge pages for it.
+ */
+class Arena
+{
+public:
+    /**
+     * @brief Alignment of the block and of the regions returned by align(), in bytes.
+     */
+    static const size_t alignment = 64;
+
+private:
+    /**
+     * @brief The block.
+     */
+    double *m_data;
+
+    /**
+     * @brief Number of doubles in the block.
+     */
+    size_t m_size;
+
+    /**
+     * @brief Number of bytes allocated (or mapped).
+     */
+    size_t m_bytes;
+
+    /**
+     * @brief Whether the block was mapped for huge pages.
+     */
+    bool m_hugePages;
+
+    /**
+     * @brief Free the block.
+     */
+    void release();
+
+public:
+    /**
+     * @brief Constructor for an empty Arena.
+     */
+    Arena() : m_data(nullptr), m_size(0), m_bytes(0), m_hugePages(false) {}
+
+    /**
+     * @brief Constructor for the Arena class.
+     * @param size Number of doubles.
+     * @param hugePages Whether to back the block by transparent huge pages.
+     * @throws std::bad_alloc if the allocation fails.
+     */
+    Arena(size_t size, bool hugePages = false);
+
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+    Arena(Arena &&other) noexcept;
+    Arena &operator=(Arena &&other) noexcept;
+    ~Arena() { release(); }
+
+    /**
+     * @brief Round a number of doubles up, so consecutive regions stay aligned.
+     * @param count Number of doubles.
+     * @return The smallest multiple of `alignment / sizeof(double)` not less than `count`.
+     */
+    static size_t align(size_t count) { return (count + alignment / sizeof(double) - 1) / (alignment / sizeof(double)) * (alignment / sizeof(double)); }
+
+    /**
+     * @brief Get the block.
+     */
+    double *data() { return m_data; }
+
+    /**
+     * @brief Get the block.
+     */
+    const double *data() const { return m_data; }
+
+    /**
+     * @brief Get the number of doubles in the block.
+     */
+    size_t size() const { return m_size; }
+
+    /**
+     * @brief Check whether the block was mapped for huge pages.
+     */
+    bool hugePages() const { return m_hugePages; }
+};
+
+#endif // ARENA_HPP
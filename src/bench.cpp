@@ -0,0 +1,452 @@
+/**
+ * @file bench.cpp
+ * @brief Implementation of the microbenchmarks of the network kernels.
+ */
+
+#include "bench.hpp"
+#include <getopt.h>
+#include <unistd.h>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <stdexcept>
+
+void makeBatch(unsigned rows, unsigned numInputs, unsigned numOutputs, vector<double> &inputs, vector<double> &labels)
+{
+    mt19937 generator(42);
+    uniform_real_distribution<> distribution(0.0, 1.0);
+
+    inputs.resize(rows * numInputs);
+    for (double &value : inputs)
+    {
+        value = distribution(generator);
+    }
+
+    labels.assign(rows * numOutputs, 0.0);
+    for (unsigned r = 0; r < rows; ++r)
+    {
+        labels[r * numOutputs + generator() % numOutputs] = 1.0;
+    }
+}
+
+template <typename Step>
+double nanosecondsPerSample(Step step, unsigned samples)
+{
+    const chrono::duration<double> minTime(0.3);
+
+    step();
+    unsigned long long total = 0;
+    auto start = chrono::steady_clock::now();
+    chrono::duration<double> elapsed(0);
+    while (elapsed < minTime)
+    {
+        step();
+        total += samples;
+        elapsed = chrono::steady_clock::now() - start;
+    }
+    return elapsed.count() * 1e9 / total;
+}
+
+template <typename Step>
+vector<double> trialNanosecondsPerSample(Step step, unsigned samples, unsigned trials)
+{
+    const chrono::duration<double> minTime(0.1);
+
+    step();
+    vector<double> times;
+    for (unsigned trial = 0; trial < trials; ++trial)
+    {
+        unsigned long long total = 0;
+        auto start = chrono::steady_clock::now();
+        chrono::duration<double> elapsed(0);
+        while (elapsed < minTime)
+        {
+            step();
+            total += samples;
+            elapsed = chrono::steady_clock::now() - start;
+        }
+        times.push_back(elapsed.count() * 1e9 / total);
+    }
+    sort(times.begin(), times.end());
+    return times;
+}
+
+/**
+ * @brief Fill in a result from the sorted trial times and the work and traffic of one sample.
+ */
+static BenchResult makeResult(const string &phase, const string &topology, unsigned batch,
+                              const vector<double> &times, double flopsPerSample, double bytesPerSample)
+{
+    BenchResult result;
+    result.phase = phase;
+    result.topology = topology;
+    result.batch = batch;
+    result.nsPerSample = times[times.size() / 2];
+    result.minNsPerSample = times.front();
+    result.gflops = flopsPerSample / result.nsPerSample;
+    result.gbps = bytesPerSample / result.nsPerSample;
+    return result;
+}
+
+void benchmarkGemm(const vector<unsigned> &topology)
+{
+    const unsigned numInputs = topology.front(), numOutputs = topology.back();
+
+    // Multiply-adds of the forward pass, the backward pass does twice as many
+    double flopsPerSample = 0;
+    for (unsigned layerNum = 0; layerNum < topology.size() - 1; ++layerNum)
+    {
+        flopsPerSample += 6.0 * topology[layerNum] * topology[layerNum + 1];
+    }
+
+    cout << "Forward + backward pass, ns/sample" << endl;
+    cout << setw(8) << "batch" << setw(14) << "per-neuron" << setw(14) << "per-sample"
+         << setw(14) << "gemm" << setw(14) << "gemm GFLOP/s" << setw(10) << "speedup" << endl;
+
+    for (unsigned rows : {1u, 32u, 256u})
+    {
+        vector<double> inputs, labels;
+        makeBatch(rows, numInputs, numOutputs, inputs, labels);
+
+        // Rows of the batch as separate vectors for the per-sample interfaces
+        vector<vector<double>> inputRows(rows), labelRows(rows);
+        for (unsigned r = 0; r < rows; ++r)
+        {
+            inputRows[r].assign(inputs.begin() + r * numInputs, inputs.begin() + (r + 1) * numInputs);
+            labelRows[r].assign(labels.begin() + r * numOutputs, labels.begin() + (r + 1) * numOutputs);
+        }
+
+        ReferenceNet referenceNet(topology, 42);
+        double perNeuron = nanosecondsPerSample([&]() {
+            for (unsigned r = 0; r < rows; ++r)
+            {
+                referenceNet.feedForward(inputRows[r]);
+                referenceNet.backProp(labelRows[r]);
+            }
+        }, rows);
+
+        Net sampleNet(topology, 42);
+        double perSample = nanosecondsPerSample([&]() {
+            for (unsigned r = 0; r < rows; ++r)
+            {
+                sampleNet.feedForward(inputRows[r]);
+                sampleNet.backProp(labelRows[r]);
+            }
+        }, rows);
+
+        Net batchNet(topology, 42);
+        double batched = nanosecondsPerSample([&]() {
+            batchNet.feedForward(inputs.data(), rows);
+            batchNet.backProp(labels.data());
+        }, rows);
+
+        cout << fixed << setprecision(1)
+             << setw(8) << rows << setw(14) << perNeuron << setw(14) << perSample
+             << setw(14) << batched << setw(14) << flopsPerSample / batched
+             << setw(9) << perNeuron / batched << "x" << endl;
+    }
+}
+
+void benchmarkKernels(const vector<unsigned> &topology, unsigned rows, unsigned trials, vector<BenchResult> &results)
+{
+    const unsigned numInputs = topology.front(), numOutputs = topology.back();
+    string name;
+    for (unsigned size : topology)
+    {
+        name += (name.empty() ? "" : "-") + to_string(size);
+    }
+
+    // Weights and the activations entering and leaving the layers
+    double weights = 0, activations = 0;
+    for (unsigned layerNum = 0; layerNum < topology.size() - 1; ++layerNum)
+    {
+        weights += double(topology[layerNum]) * topology[layerNum + 1];
+        activations += topology[layerNum] + topology[layerNum + 1];
+    }
+    const double bytes = sizeof(double);
+
+    vector<double> inputs, labels;
+    makeBatch(rows, numInputs, numOutputs, inputs, labels);
+
+    // A tiny learning rate keeps the weights from drifting over the repeated updates
+    Net net(topology, 42);
+    net.setLearningRate(1e-9);
+    net.reserveRows(rows);
+
+    vector<double> times = trialNanosecondsPerSample([&]() { net.feedForward(inputs.data(), rows); }, rows, trials);
+    results.push_back(makeResult("forward", name, rows, times, 2 * weights,
+                                 bytes * (weights / rows + activations)));
+
+    // Repeated backward passes of the same forward pass
+    times = trialNanosecondsPerSample([&]() { net.backProp(labels.data()); }, rows, trials);
+    results.push_back(makeResult("backward", name, rows, times, 4 * weights,
+                                 bytes * (3 * weights / rows + 2 * activations)));
+
+    // Averaging reads and writes the gradients, RMSProp reads weights, caches and gradients and writes the first two
+    times = trialNanosecondsPerSample([&]() {
+        net.calcAvgGradient(rows);
+        net.updateWeights();
+    }, rows, trials);
+    results.push_back(makeResult("update", name, rows, times, 7 * weights / rows, bytes * 7 * weights / rows));
+
+    // The softmax is dominated by exp, its operations are not counted
+    SoftmaxOutputLayer softmax(numOutputs);
+    vector<double> potentials(inputs.begin(), inputs.begin() + rows * numOutputs);
+    vector<double> probabilities(rows * numOutputs), logSumExps(rows);
+    times = trialNanosecondsPerSample([&]() {
+        softmax.forward(potentials.data(), probabilities.data(), logSumExps.data(), rows, false);
+    }, rows, trials);
+    results.push_back(makeResult("softmax", name, rows, times, 0.0, bytes * (2 * numOutputs + 1)));
+}
+
+void benchmarkDataLoading(unsigned numInputs, unsigned samples, unsigned trials, vector<BenchResult> &results)
+{
+    char path[] = "/tmp/bench-data-XXXXXX";
+    const int fd = mkstemp(path);
+    if (fd < 0)
+    {
+        throw runtime_error("Unable to create a temporary file");
+    }
+    close(fd);
+
+    // Pixel values as in the dataset
+    mt19937 generator(42);
+    {
+        ofstream file(path);
+        for (unsigned sample = 0; sample < samples; ++sample)
+        {
+            for (unsigned i = 0; i < numInputs; ++i)
+            {
+                file << (i > 0 ? "," : "") << generator() % 256;
+            }
+            file << "\n";
+        }
+    }
+    ifstream file(path, ios::binary | ios::ate);
+    const double fileBytes = file.tellg();
+
+    vector<double> times = trialNanosecondsPerSample([&]() { InputData data(path, 255.0, 1); }, samples, trials);
+    results.push_back(makeResult("data", to_string(numInputs), 0, times, 0.0, fileBytes / samples));
+    unlink(path);
+}
+
+void printResults(const vector<BenchResult> &results)
+{
+    cout << "Kernels, median (fastest) of the trials" << endl;
+    cout << setw(10) << "kernel" << setw(22) << "topology" << setw(7) << "batch" << setw(12) << "ns/sample"
+         << setw(12) << "(fastest)" << setw(10) << "GFLOP/s" << setw(8) << "GB/s" << endl;
+    for (const BenchResult &result : results)
+    {
+        cout << fixed << setprecision(1) << setw(10) << result.phase << setw(22) << result.topology << setw(7);
+        if (result.batch > 0)
+        {
+            cout << result.batch;
+        }
+        else
+        {
+            cout << "-";
+        }
+        cout << setw(12) << result.nsPerSample << setw(12) << result.minNsPerSample << setw(10);
+        if (result.gflops > 0)
+        {
+            cout << result.gflops;
+        }
+        else
+        {
+            cout << "-";
+        }
+        cout << setw(8) << result.gbps << defaultfloat << setprecision(6) << endl;
+    }
+}
+
+void writeCsv(const string &path, const vector<BenchResult> &results)
+{
+    ofstream file(path);
+    if (!file.is_open())
+    {
+        throw runtime_error("Unable to open file: " + path);
+    }
+    file << "kernel,topology,batch,ns_per_sample,min_ns_per_sample,gflops,gbps" << endl;
+    for (const BenchResult &result : results)
+    {
+        file << result.phase << "," << result.topology << "," << result.batch << "," << result.nsPerSample << ","
+             << result.minNsPerSample << "," << result.gflops << "," << result.gbps << endl;
+    }
+}
+
+void writeJson(const string &path, const vector<BenchResult> &results)
+{
+    ofstream file(path);
+    if (!file.is_open())
+    {
+        throw runtime_error("Unable to open file: " + path);
+    }
+    file << "[" << endl;
+    for (unsigned i = 0; i < results.size(); ++i)
+    {
+        const BenchResult &result = results[i];
+        file << "  {\"kernel\": \"" << result.phase << "\", \"topology\": \"" << result.topology
+             << "\", \"batch\": " << result.batch << ", \"ns_per_sample\": " << result.nsPerSample
+             << ", \"min_ns_per_sample\": " << result.minNsPerSample << ", \"gflops\": " << result.gflops
+             << ", \"gbps\": " << result.gbps << "}" << (i + 1 < results.size() ? "," : "") << endl;
+    }
+    file << "]" << endl;
+}
+
+vector<BenchResult> readCsv(const string &path)
+{
+    ifstream file(path);
+    if (!file.is_open())
+    {
+        throw runtime_error("Unable to open file: " + path);
+    }
+
+    vector<BenchResult> results;
+    string line;
+    getline(file, line);
+    while (getline(file, line))
+    {
+        istringstream fields(line);
+        BenchResult result;
+        string batch, nsPerSample, minNsPerSample, gflops, gbps;
+        if (!getline(fields, result.phase, ',') || !getline(fields, result.topology, ',') || !getline(fields, batch, ',') ||
+            !getline(fields, nsPerSample, ',') || !getline(fields, minNsPerSample, ',') || !getline(fields, gflops, ',') ||
+            !getline(fields, gbps, ','))
+        {
+            throw runtime_error("Invalid line in " + path + ": " + line);
+        }
+        result.batch = stoul(batch);
+        result.nsPerSample = stod(nsPerSample);
+        result.minNsPerSample = stod(minNsPerSample);
+        result.gflops = stod(gflops);
+        result.gbps = stod(gbps);
+        results.push_back(result);
+    }
+    return results;
+}
+
+bool compareBaseline(const vector<BenchResult> &results, const vector<BenchResult> &baseline, double threshold)
+{
+    bool passed = true;
+    // The fastest trial is the least disturbed by other load
+    cout << "Comparison with the baseline, fastest ns/sample" << endl;
+    cout << setw(10) << "kernel" << setw(22) << "topology" << setw(7) << "batch" << setw(12) << "baseline"
+         << setw(12) << "now" << setw(9) << "change" << endl;
+    for (const BenchResult &result : results)
+    {
+        auto match = find_if(baseline.begin(), baseline.end(), [&](const BenchResult &old) {
+            return old.phase == result.phase && old.topology == result.topology && old.batch == result.batch;
+        });
+        if (match == baseline.end())
+        {
+            continue;
+        }
+
+        const double change = result.minNsPerSample / match->minNsPerSample - 1.0;
+        const bool slower = change > threshold;
+        passed = passed && !slower;
+        cout << fixed << setprecision(1) << setw(10) << result.phase << setw(22) << result.topology << setw(7)
+             << result.batch << setw(12) << match->minNsPerSample << setw(12) << result.minNsPerSample << setw(8)
+             << 100.0 * change << "%" << (slower ? "  SLOWER" : "") << defaultfloat << setprecision(6) << endl;
+    }
+    return passed;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned trials = 5;
+    bool kernelsOnly = false;
+    bool checksOnly = false;
+    double threshold = 0.1;
+    string csvPath, jsonPath, baselinePath;
+
+    int c;
+    while ((c = getopt(argc, argv, "t:kc:J:vB:x:")) != -1)
+    {
+        switch (c)
+        {
+            case 't':
+                trials = max(atoi(optarg), 1);
+                break;
+            case 'k':
+                kernelsOnly = true;
+                break;
+            case 'c':
+                csvPath = optarg;
+                break;
+            case 'J':
+                jsonPath = optarg;
+                break;
+            case 'v':
+                checksOnly = true;
+                break;
+            case 'B':
+                baselinePath = optarg;
+                break;
+            case 'x':
+                threshold = atof(optarg) / 100.0;
+                break;
+            default:
+                cerr << "Usage: ./bench [-t TRIALS] [-k] [-v] [-c CSV_FILE] [-J JSON_FILE] [-B BASELINE_CSV] [-x PERCENT]" << endl;
+                return 1;
+        }
+    }
+
+    // Timings of wrong kernels mean nothing
+    if (!printChecks(runChecks()))
+    {
+        return 1;
+    }
+    cout << endl;
+    if (checksOnly)
+    {
+        return 0;
+    }
+    vector<BenchResult> baseline;
+    if (!baselinePath.empty())
+    {
+        baseline = readCsv(baselinePath);
+    }
+
+    if (!kernelsOnly)
+    {
+        for (const vector<unsigned> &topology : {vector<unsigned>{784, 64, 32, 10}, vector<unsigned>{784, 256, 128, 10}})
+        {
+            cout << "Topology:";
+            for (unsigned size : topology)
+            {
+                cout << " " << size;
+            }
+            cout << endl;
+            benchmarkGemm(topology);
+            cout << endl;
+        }
+    }
+
+    vector<BenchResult> results;
+    for (const vector<unsigned> &topology : {vector<unsigned>{784, 64, 32, 10}, vector<unsigned>{784, 256, 128, 10},
+                                             vector<unsigned>{784, 512, 256, 128, 64, 10}})
+    {
+        for (unsigned rows : {1u, 32u, 256u})
+        {
+            benchmarkKernels(topology, rows, trials, results);
+        }
+    }
+    benchmarkDataLoading(784, 1000, trials, results);
+    printResults(results);
+
+    if (!csvPath.empty())
+    {
+        writeCsv(csvPath, results);
+    }
+    if (!jsonPath.empty())
+    {
+        writeJson(jsonPath, results);
+    }
+    if (!baselinePath.empty())
+    {
+        cout << endl;
+        return compareBaseline(results, baseline, threshold) ? 0 : 1;
+    }
+    return 0;
+}
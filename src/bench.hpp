@@ -0,0 +1,191 @@
+/**
+ * @file bench.hpp
+ * @brief Declaration of the microbenchmarks of the network kernels.
+ */
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <string>
+#include "net.hpp"
+#include "reference_net.hpp"
+#include "input_data.hpp"
+#include "check.hpp"
+
+using namespace std;
+
+/**
+ * @struct BenchResult
+ * @brief Timing of one kernel for one topology and batch size.
+ */
+struct BenchResult
+{
+    /**
+     * @brief Name of the kernel ("forward", "backward", "update", "softmax", "data").
+     */
+    string phase;
+
+    /**
+     * @brief Topology as dash-separated layer sizes.
+     */
+    string topology;
+
+    /**
+     * @brief Batch size, 0 if the kernel does not depend on it.
+     */
+    unsigned batch = 0;
+
+    /**
+     * @brief Median time per sample over the trials, in nanoseconds.
+     */
+    double nsPerSample = 0.0;
+
+    /**
+     * @brief Fastest time per sample over the trials, in nanoseconds.
+     */
+    double minNsPerSample = 0.0;
+
+    /**
+     * @brief Floating-point operations per second at the median time, in billions (0 if not meaningful).
+     */
+    double gflops = 0.0;
+
+    /**
+     * @brief Lower bound of the memory traffic per second at the median time, in gigabytes.
+     */
+    double gbps = 0.0;
+};
+
+/**
+ * @brief Generate a batch of random samples.
+ *
+ * @param rows Number of samples.
+ * @param numInputs Number of input values of a sample.
+ * @param numOutputs Number of output classes.
+ * @param inputs Output for `rows` rows of input values in [0, 1].
+ * @param labels Output for `rows` one-hot label rows.
+ */
+void makeBatch(unsigned rows, unsigned numInputs, unsigned numOutputs, vector<double> &inputs, vector<double> &labels);
+
+/**
+ * @brief Measure the time of a benchmark step.
+ *
+ * Runs the step repeatedly for at least a fixed amount of time after a warm-up run.
+ *
+ * @param step Function processing `samples` samples.
+ * @param samples Number of samples processed by one call of `step`.
+ * @return Average time per sample in nanoseconds.
+ */
+template <typename Step>
+double nanosecondsPerSample(Step step, unsigned samples);
+
+/**
+ * @brief Measure the time of a benchmark step in repeated trials.
+ *
+ * After a warm-up run, every trial runs the step repeatedly for at least 0.1 s.
+ *
+ * @param step Function processing `samples` samples.
+ * @param samples Number of samples processed by one call of `step`.
+ * @param trials Number of trials.
+ * @return Average time per sample of every trial in nanoseconds, sorted.
+ */
+template <typename Step>
+vector<double> trialNanosecondsPerSample(Step step, unsigned samples, unsigned trials);
+
+/**
+ * @brief Compare forward and backward passes of the per-neuron implementation, the layer
+ * implementation fed sample by sample and the layer implementation fed whole batches (GEMM).
+ *
+ * Prints the time per sample for batch sizes 1, 32 and 256.
+ *
+ * @param topology Number of neurons in each layer.
+ */
+void benchmarkGemm(const vector<unsigned> &topology);
+
+/**
+ * @brief Time the forward pass, the backward pass, the weight update (gradient averaging
+ * and RMSProp) and the softmax of the batched layer implementation.
+ *
+ * Work and traffic are counted from the layer sizes: a multiply-add is two operations,
+ * the backward pass does twice the multiply-adds of the forward pass, and the traffic
+ * is the weights, gradients and activations each kernel has to read or write at least once.
+ *
+ * @param topology Number of neurons in each layer.
+ * @param rows Batch size.
+ * @param trials Number of trials.
+ * @param results Output, the results are appended.
+ */
+void benchmarkKernels(const vector<unsigned> &topology, unsigned rows, unsigned trials, vector<BenchResult> &results);
+
+/**
+ * @brief Time reading and parsing a dataset file (InputData) of random samples.
+ *
+ * @param numInputs Number of values of a sample.
+ * @param samples Number of samples in the file.
+ * @param trials Number of trials.
+ * @param results Output, the result is appended.
+ */
+void benchmarkDataLoading(unsigned numInputs, unsigned samples, unsigned trials, vector<BenchResult> &results);
+
+/**
+ * @brief Print the results as a table.
+ * @param results The results.
+ */
+void printResults(const vector<BenchResult> &results);
+
+/**
+ * @brief Write the results as CSV, one line per result after a header.
+ * @param path Path of the file.
+ * @param results The results.
+ * @throws std::runtime_error if the file cannot be written.
+ */
+void writeCsv(const string &path, const vector<BenchResult> &results);
+
+/**
+ * @brief Write the results as a JSON array of objects.
+ * @param path Path of the file.
+ * @param results The results.
+ * @throws std::runtime_error if the file cannot be written.
+ */
+void writeJson(const string &path, const vector<BenchResult> &results);
+
+/**
+ * @brief Read results written by writeCsv().
+ * @param path Path of the file.
+ * @return The results.
+ * @throws std::runtime_error if the file cannot be read or a line is invalid.
+ */
+vector<BenchResult> readCsv(const string &path);
+
+/**
+ * @brief Print the change of the fastest time of every kernel against a baseline and
+ * flag the kernels that got slower by more than a threshold.
+ *
+ * Kernels missing from the baseline are skipped.
+ *
+ * @param results The new results.
+ * @param baseline Results of an earlier run (see readCsv()).
+ * @param threshold Largest accepted slowdown, as a fraction of the baseline time.
+ * @return Whether no kernel got slower by more than the threshold.
+ */
+bool compareBaseline(const vector<BenchResult> &results, const vector<BenchResult> &baseline, double threshold);
+
+/**
+ * @brief Run the correctness checks and then the benchmarks.
+ *
+ * Usage: `./bench [-t TRIALS] [-k] [-v] [-c CSV_FILE] [-J JSON_FILE] [-B BASELINE_CSV] [-x PERCENT]`,
+ * where `-k` skips the comparison of the implementations and runs the kernel suite only,
+ * `-v` runs the correctness checks only, and `-B` compares the kernel times with a CSV
+ * file of an earlier run, failing when a kernel is more than `PERCENT` (10 by default)
+ * slower. The exit status is 1 when a check fails or a kernel got slower.
+ *
+ * @param argc Number of command-line arguments.
+ * @param argv Array of command-line arguments.
+ * @return Exit status.
+ */
+int main(int argc, char *argv[]);
+
+#endif // BENCH_HPP
@@ -0,0 +1,411 @@
+/**
+ * @file bf16_net.cpp
+ * @brief Implementation of the Bf16Net mixed-precision network and its bfloat16 kernels.
+ */
+
+#include "bf16_net.hpp"
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#if defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+uint16_t toBf16(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    if ((bits & 0x7fffffff) > 0x7f800000)
+    {
+        // Keep NaN a (quiet) NaN, rounding could carry into the exponent
+        return static_cast<uint16_t>((bits >> 16) | 0x40);
+    }
+    bits += 0x7fff + ((bits >> 16) & 1);
+    return static_cast<uint16_t>(bits >> 16);
+}
+
+float fromBf16(uint16_t value)
+{
+    const uint32_t bits = static_cast<uint32_t>(value) << 16;
+    float result;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+#if defined(__AVX512F__)
+/**
+ * @brief Widen 16 bfloat16 values to floats.
+ */
+static inline __m512 loadBf16(const uint16_t *values)
+{
+    const __m256i packed = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(values));
+    // The zero-masking forms, the plain ones trip -Wmaybe-uninitialized in the GCC 12 headers
+    return _mm512_castsi512_ps(_mm512_maskz_slli_epi32(0xffff, _mm512_maskz_cvtepu16_epi32(0xffff, packed), 16));
+}
+
+/**
+ * @brief Sum of the lanes of a vector.
+ */
+static inline float sumLanes(__m512 values)
+{
+    alignas(64) float lanes[16];
+    _mm512_store_ps(lanes, values);
+    float sum = 0.0f;
+    for (unsigned i = 0; i < 16; ++i)
+    {
+        sum += lanes[i];
+    }
+    return sum;
+}
+#endif
+
+void toBf16(const float *values, uint16_t *out, unsigned n)
+{
+    unsigned i = 0;
+#if defined(__AVX512BF16__)
+    for (; i + 16 <= n; i += 16)
+    {
+        const __m256bh packed = _mm512_cvtneps_pbh(_mm512_loadu_ps(values + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), (__m256i)packed);
+    }
+#endif
+    for (; i < n; ++i)
+    {
+        out[i] = toBf16(values[i]);
+    }
+}
+
+void fromBf16(const uint16_t *values, float *out, unsigned n)
+{
+#if defined(__AVX512F__)
+    for (unsigned i = 0; i < n; i += 16)
+    {
+        _mm512_storeu_ps(out + i, loadBf16(values + i));
+    }
+#else
+    for (unsigned i = 0; i < n; ++i)
+    {
+        out[i] = fromBf16(values[i]);
+    }
+#endif
+}
+
+float dotBf16(const uint16_t *a, const uint16_t *b, unsigned n)
+{
+#if defined(__AVX512BF16__)
+    // Pairs of products added to float lanes, two chains to hide the latency
+    __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+    unsigned i = 0;
+    for (; i + 64 <= n; i += 64)
+    {
+        acc0 = _mm512_dpbf16_ps(acc0, (__m512bh)_mm512_loadu_si512(a + i), (__m512bh)_mm512_loadu_si512(b + i));
+        acc1 = _mm512_dpbf16_ps(acc1, (__m512bh)_mm512_loadu_si512(a + i + 32), (__m512bh)_mm512_loadu_si512(b + i + 32));
+    }
+    if (i < n)
+    {
+        acc0 = _mm512_dpbf16_ps(acc0, (__m512bh)_mm512_loadu_si512(a + i), (__m512bh)_mm512_loadu_si512(b + i));
+    }
+    return sumLanes(_mm512_add_ps(acc0, acc1));
+#elif defined(__AVX512F__)
+    __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+    for (unsigned i = 0; i < n; i += 32)
+    {
+        acc0 = _mm512_fmadd_ps(loadBf16(a + i), loadBf16(b + i), acc0);
+        acc1 = _mm512_fmadd_ps(loadBf16(a + i + 16), loadBf16(b + i + 16), acc1);
+    }
+    return sumLanes(_mm512_add_ps(acc0, acc1));
+#else
+    float acc = 0.0f;
+    for (unsigned i = 0; i < n; ++i)
+    {
+        acc += fromBf16(a[i]) * fromBf16(b[i]);
+    }
+    return acc;
+#endif
+}
+
+void axpyBf16(float alpha, const uint16_t *x, float *y, unsigned n)
+{
+#if defined(__AVX512F__)
+    const __m512 scale = _mm512_set1_ps(alpha);
+    for (unsigned i = 0; i < n; i += 16)
+    {
+        _mm512_storeu_ps(y + i, _mm512_fmadd_ps(scale, loadBf16(x + i), _mm512_loadu_ps(y + i)));
+    }
+#else
+    for (unsigned i = 0; i < n; ++i)
+    {
+        y[i] += alpha * fromBf16(x[i]);
+    }
+#endif
+}
+
+bool bf16Instructions()
+{
+#if defined(__AVX512BF16__)
+    return true;
+#else
+    return false;
+#endif
+}
+
+float Bf16Net::decay = 0.9f;
+float Bf16Net::epsilon = 1e-8f;
+
+Bf16Net::Bf16Net(const Net &net) :
+    m_optimizer(net.getOptimizer()),
+    m_learningRate(net.getLearningRate()),
+    m_rows(0)
+{
+    if (net.getActivation() != Activation::ReLU)
+    {
+        throw invalid_argument("Only networks with ReLU hidden layers can be trained in bfloat16");
+    }
+    if (net.getMembers() > 1)
+    {
+        throw invalid_argument("Ensembles cannot be trained in bfloat16");
+    }
+
+    const vector<unsigned> &topology = net.getTopology();
+    for (unsigned layerNum = 0; layerNum < topology.size() - 1; ++layerNum)
+    {
+        Bf16Layer layer;
+        layer.numInputs = topology[layerNum];
+        layer.numOutputs = topology[layerNum + 1];
+        layer.stride = (layer.numInputs + 31) / 32 * 32;
+        layer.weights.assign(layer.numOutputs * layer.stride, 0.0f);
+        layer.weights16.assign(layer.numOutputs * layer.stride, 0);
+        layer.biases.resize(layer.numOutputs);
+        layer.weightGradients.assign(layer.numOutputs * layer.stride, 0.0f);
+        layer.weightDeltas.assign(layer.numOutputs * layer.stride, 0.0f);
+
+        for (unsigned j = 0; j < layer.numOutputs; ++j)
+        {
+            for (unsigned i = 0; i < layer.numInputs; ++i)
+            {
+                layer.weights[j * layer.stride + i] = net.getWeight(layerNum, i, j);
+            }
+            layer.biases[j] = net.getWeight(layerNum, layer.numInputs, j);
+        }
+        toBf16(layer.weights.data(), layer.weights16.data(), layer.weights.size());
+        m_layers.push_back(layer);
+    }
+    m_activations.resize(m_layers.size());
+}
+
+void Bf16Net::reserveRows(unsigned rows)
+{
+    if (m_activations[0].size() >= rows * m_layers[0].stride)
+    {
+        return;
+    }
+    unsigned maxStride = 0;
+    for (unsigned layerNum = 0; layerNum < m_layers.size(); ++layerNum)
+    {
+        // Zero padding, which the passes never write
+        m_activations[layerNum].assign(rows * m_layers[layerNum].stride, 0);
+        maxStride = max(maxStride, max(m_layers[layerNum].stride, m_layers[layerNum].numOutputs));
+    }
+    const unsigned numOutputs = m_layers.back().numOutputs;
+    m_probabilities.resize(rows * numOutputs);
+    m_potentials.resize(rows * numOutputs);
+    m_logSumExp.resize(rows);
+    m_deltas.resize(rows * maxStride);
+    m_inputDeltas.resize(rows * maxStride);
+    m_row.resize(maxStride);
+}
+
+void Bf16Net::feedForward(const double *inputs, unsigned rows)
+{
+    reserveRows(rows);
+    m_rows = rows;
+
+    const unsigned numInputs = m_layers.front().numInputs;
+    for (unsigned r = 0; r < rows; ++r)
+    {
+        for (unsigned i = 0; i < numInputs; ++i)
+        {
+            m_row[i] = inputs[r * numInputs + i];
+        }
+        toBf16(m_row.data(), &m_activations[0][r * m_layers[0].stride], numInputs);
+    }
+
+    for (unsigned layerNum = 0; layerNum < m_layers.size(); ++layerNum)
+    {
+        const Bf16Layer &layer = m_layers[layerNum];
+        const bool isOutput = layerNum == m_layers.size() - 1;
+        const uint16_t *layerInputs = m_activations[layerNum].data();
+
+        for (unsigned r = 0; r < rows; ++r)
+        {
+            const uint16_t *input = layerInputs + r * layer.stride;
+            float *potentials = isOutput ? &m_potentials[r * layer.numOutputs] : m_row.data();
+            for (unsigned j = 0; j < layer.numOutputs; ++j)
+            {
+                potentials[j] = dotBf16(input, &layer.weights16[j * layer.stride], layer.stride) + layer.biases[j];
+            }
+            if (!isOutput)
+            {
+                for (unsigned j = 0; j < layer.numOutputs; ++j)
+                {
+                    m_row[j] = max(0.0f, m_row[j]);
+                }
+                toBf16(m_row.data(), &m_activations[layerNum + 1][r * m_layers[layerNum + 1].stride], layer.numOutputs);
+            }
+        }
+    }
+
+    // Softmax in float, keeping the log-sum-exp for the loss
+    const unsigned numOutputs = m_layers.back().numOutputs;
+    for (unsigned r = 0; r < rows; ++r)
+    {
+        const float *potentials = &m_potentials[r * numOutputs];
+        float *probabilities = &m_probabilities[r * numOutputs];
+        const float maxPotential = *max_element(potentials, potentials + numOutputs);
+        float expSum = 0.0f;
+        for (unsigned j = 0; j < numOutputs; ++j)
+        {
+            probabilities[j] = exp(potentials[j] - maxPotential);
+            expSum += probabilities[j];
+        }
+        for (unsigned j = 0; j < numOutputs; ++j)
+        {
+            probabilities[j] /= expSum;
+        }
+        m_logSumExp[r] = maxPotential + log(expSum);
+    }
+}
+
+double Bf16Net::backProp(const double *targets)
+{
+    const unsigned numOutputs = m_layers.back().numOutputs;
+
+    // Cross-entropy of the softmax, its gradient with respect to the potentials is p - t
+    double loss = 0.0;
+    for (unsigned r = 0; r < m_rows; ++r)
+    {
+        for (unsigned j = 0; j < numOutputs; ++j)
+        {
+            const float target = targets[r * numOutputs + j];
+            loss += target * (m_logSumExp[r] - m_potentials[r * numOutputs + j]);
+            m_deltas[r * numOutputs + j] = m_probabilities[r * numOutputs + j] - target;
+        }
+    }
+
+    for (unsigned layerNum = m_layers.size(); layerNum-- > 0;)
+    {
+        Bf16Layer &layer = m_layers[layerNum];
+        const uint16_t *layerInputs = m_activations[layerNum].data();
+
+        for (unsigned r = 0; r < m_rows; ++r)
+        {
+            // Float gradients of the row: the outer product of its errors and its inputs
+            fromBf16(layerInputs + r * layer.stride, m_row.data(), layer.stride);
+            for (unsigned j = 0; j < layer.numOutputs; ++j)
+            {
+                const float delta = m_deltas[r * layer.numOutputs + j];
+                float *gradients = &layer.weightGradients[j * layer.stride];
+                for (unsigned i = 0; i < layer.stride; ++i)
+                {
+                    gradients[i] += delta * m_row[i];
+                }
+            }
+        }
+        if (layerNum == 0)
+        {
+            break;
+        }
+
+        // Errors of the inputs through the bfloat16 weights and the ReLU of the previous layer
+        fill(m_inputDeltas.begin(), m_inputDeltas.begin() + m_rows * layer.stride, 0.0f);
+        for (unsigned r = 0; r < m_rows; ++r)
+        {
+            float *inputDeltas = &m_inputDeltas[r * layer.stride];
+            for (unsigned j = 0; j < layer.numOutputs; ++j)
+            {
+                axpyBf16(m_deltas[r * layer.numOutputs + j], &layer.weights16[j * layer.stride], inputDeltas, layer.stride);
+            }
+            const uint16_t *input = layerInputs + r * layer.stride;
+            for (unsigned i = 0; i < layer.numInputs; ++i)
+            {
+                inputDeltas[i] = input[i] != 0 ? inputDeltas[i] : 0.0f;
+            }
+        }
+
+        // Pack the rows to the width of the previous layer's outputs
+        for (unsigned r = 0; r < m_rows; ++r)
+        {
+            copy_n(&m_inputDeltas[r * layer.stride], layer.numInputs, &m_deltas[r * layer.numInputs]);
+        }
+    }
+    return loss;
+}
+
+void Bf16Net::updateWeights()
+{
+    const float scale = 1.0f / m_rows, eta = m_learningRate;
+    for (Bf16Layer &layer : m_layers)
+    {
+        float *weights = layer.weights.data(), *deltas = layer.weightDeltas.data(), *gradients = layer.weightGradients.data();
+        for (unsigned k = 0; k < layer.weights.size(); ++k)
+        {
+            const float gradient = gradients[k] * scale;
+            if (m_optimizer == Optimizer::SGD)
+            {
+                weights[k] -= eta * gradient;
+            }
+            else
+            {
+                deltas[k] = decay * deltas[k] + (1 - decay) * gradient * gradient;
+                weights[k] -= eta / (sqrt(deltas[k]) + epsilon) * gradient;
+            }
+            gradients[k] = 0.0f;
+        }
+        toBf16(layer.weights.data(), layer.weights16.data(), layer.weights.size());
+    }
+}
+
+double Bf16Net::train(const double *inputs, const double *targets, unsigned rows)
+{
+    feedForward(inputs, rows);
+    const double loss = backProp(targets);
+    updateWeights();
+    return loss;
+}
+
+void Bf16Net::getResults(vector<double> &resultVals, unsigned row) const
+{
+    const unsigned numOutputs = m_layers.back().numOutputs;
+    resultVals.assign(&m_probabilities[row * numOutputs], &m_probabilities[row * numOutputs] + numOutputs);
+}
+
+unsigned Bf16Net::countCorrect(const double *targets) const
+{
+    const unsigned numOutputs = m_layers.back().numOutputs;
+    unsigned correct = 0;
+    for (unsigned r = 0; r < m_rows; ++r)
+    {
+        const float *output = &m_probabilities[r * numOutputs];
+        const double *target = targets + r * numOutputs;
+        correct += max_element(output, output + numOutputs) - output == max_element(target, target + numOutputs) - target;
+    }
+    return correct;
+}
+
+double Bf16Net::getWeight(unsigned layerNum, unsigned from, unsigned to) const
+{
+    const Bf16Layer &layer = m_layers[layerNum];
+    return from < layer.numInputs ? layer.weights[to * layer.stride + from] : layer.biases[to];
+}
+
+size_t Bf16Net::weightBytes() const
+{
+    size_t bytes = 0;
+    for (const Bf16Layer &layer : m_layers)
+    {
+        bytes += layer.weights16.size() * sizeof(uint16_t) + layer.biases.size() * sizeof(float);
+    }
+    return bytes;
+}
@@ -0,0 +1,274 @@
+/**
+ * @file bf16_net.hpp
+ * @brief Declaration of the Bf16Net class, mixed-precision training with bfloat16 weights and activations.
+ */
+#ifndef BF16_NET_HPP
+#define BF16_NET_HPP
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "net.hpp"
+
+using namespace std;
+
+/**
+ * @brief Round a float to the nearest bfloat16 (ties to even), which keeps its upper 16 bits.
+ * @param value The value.
+ * @return Bits of the bfloat16.
+ */
+uint16_t toBf16(float value);
+
+/**
+ * @brief Widen a bfloat16 to a float, which is exact.
+ * @param value Bits of the bfloat16.
+ * @return The value.
+ */
+float fromBf16(uint16_t value);
+
+/**
+ * @brief Round an array of floats to bfloat16.
+ * @param values The values.
+ * @param out Output array for the bits of the bfloat16 values.
+ * @param n Number of values.
+ */
+void toBf16(const float *values, uint16_t *out, unsigned n);
+
+/**
+ * @brief Widen an array of bfloat16 values to floats.
+ * @param values Bits of the bfloat16 values.
+ * @param out Output array for the floats.
+ * @param n Number of values, a multiple of 16.
+ */
+void fromBf16(const uint16_t *values, float *out, unsigned n);
+
+/**
+ * @brief Dot product of two bfloat16 vectors, accumulated in float.
+ * @param a First vector.
+ * @param b Second vector.
+ * @param n Length of both vectors, a multiple of 32.
+ * @return The dot product.
+ */
+float dotBf16(const uint16_t *a, const uint16_t *b, unsigned n);
+
+/**
+ * @brief Add a multiple of a bfloat16 vector to a float vector, `y += alpha * x`.
+ * @param alpha The multiple.
+ * @param x The bfloat16 vector.
+ * @param y The float vector.
+ * @param n Length of both vectors, a multiple of 16.
+ */
+void axpyBf16(float alpha, const uint16_t *x, float *y, unsigned n);
+
+/**
+ * @brief Whether the conversions and dot products use the AVX-512 BF16 instructions
+ * (otherwise they convert in software).
+ */
+bool bf16Instructions();
+
+/**
+ * @struct Bf16Layer
+ * @brief Weights of the connections leading into one layer of the network, in both precisions.
+ *
+ * Rows of all weight arrays are padded with zeros to `stride` so the kernels never need
+ * a scalar tail; the padding has zero gradients and therefore stays zero.
+ */
+struct Bf16Layer
+{
+    /**
+     * @brief Number of neurons of the previous layer.
+     */
+    unsigned numInputs;
+
+    /**
+     * @brief Number of neurons of the layer.
+     */
+    unsigned numOutputs;
+
+    /**
+     * @brief Length of a weight row, numInputs rounded up to a multiple of 32.
+     */
+    unsigned stride;
+
+    /**
+     * @brief Float master weights [numOutputs][stride].
+     */
+    vector<float> weights;
+
+    /**
+     * @brief Bfloat16 copy of the weights read by the kernels [numOutputs][stride].
+     */
+    vector<uint16_t> weights16;
+
+    /**
+     * @brief Float biases, fixed like those of Net.
+     */
+    vector<float> biases;
+
+    /**
+     * @brief Gradients of the weights [numOutputs][stride].
+     */
+    vector<float> weightGradients;
+
+    /**
+     * @brief RMSProp moving averages of the squared gradients [numOutputs][stride].
+     */
+    vector<float> weightDeltas;
+};
+
+/**
+ * @class Bf16Net
+ * @brief Mixed-precision training of a ReLU network with weights and activations stored as bfloat16.
+ *
+ * The forward and backward passes read the bfloat16 copy of the weights and the saved
+ * bfloat16 activations, which halves their memory traffic compared to float (a quarter of
+ * Net's doubles); all products are accumulated in float. The optimizer updates float master
+ * weights with float gradients and moving averages, and rounds them to the bfloat16 copy
+ * after every update, so small updates are not lost to the 8-bit mantissa. The biases (which
+ * keep their initial values, as in Net), the output potentials and the backpropagated errors
+ * stay in float.
+ *
+ * The kernels use the AVX-512 BF16 instructions when compiled for them, AVX-512F or scalar
+ * software conversion otherwise (see bf16Instructions()).
+ */
+class Bf16Net
+{
+private:
+    /**
+     * @brief Decay factor for RMSprop optimization.
+     */
+    static float decay;
+
+    /**
+     * @brief Small constant used to prevent division by zero.
+     */
+    static float epsilon;
+
+    /**
+     * @brief Layers, `m_layers[i]` computes the outputs of layer `i + 1` of the topology.
+     */
+    vector<Bf16Layer> m_layers;
+
+    /**
+     * @brief Update rule of the weights.
+     */
+    Optimizer m_optimizer;
+
+    /**
+     * @brief Learning rate of the updates.
+     */
+    double m_learningRate;
+
+    /**
+     * @brief Number of rows of the last feedforward pass.
+     */
+    unsigned m_rows;
+
+    /**
+     * @brief Saved bfloat16 inputs of every layer, `m_activations[i]` is [rows][m_layers[i].stride].
+     */
+    vector<vector<uint16_t>> m_activations;
+
+    /**
+     * @brief Softmax probabilities of the output layer [rows][outputs].
+     */
+    vector<float> m_probabilities;
+
+    /**
+     * @brief Potentials of the output layer [rows][outputs].
+     */
+    vector<float> m_potentials;
+
+    /**
+     * @brief Log-sum-exp of the output potentials of every row.
+     */
+    vector<float> m_logSumExp;
+
+    /**
+     * @brief Backpropagated errors of the outputs of the current layer and of its inputs.
+     */
+    vector<float> m_deltas, m_inputDeltas;
+
+    /**
+     * @brief One float row, for conversions.
+     */
+    vector<float> m_row;
+
+    /**
+     * @brief Grow the buffers of the passes to a number of rows.
+     * @param rows Number of rows.
+     */
+    void reserveRows(unsigned rows);
+
+    /**
+     * @brief Backpropagate the loss of the last feedforward pass and accumulate the gradients.
+     * @param targets Target values, one row of the output layer size per sample.
+     * @return Loss summed over the rows.
+     */
+    double backProp(const double *targets);
+
+    /**
+     * @brief Average the gradients over the rows, update the weights and reset the gradients.
+     */
+    void updateWeights();
+
+public:
+    /**
+     * @brief Copy the weights, the optimizer and the learning rate of a network.
+     * @param net The network, usually freshly initialized so both train from the same weights.
+     * @throws std::invalid_argument if the hidden layers do not use ReLU or the network is an ensemble.
+     */
+    explicit Bf16Net(const Net &net);
+
+    /**
+     * @brief Set the learning rate.
+     * @param learningRate The learning rate.
+     */
+    void setLearningRate(double learningRate) { m_learningRate = learningRate; }
+
+    /**
+     * @brief Perform a feedforward pass of a batch.
+     * @param inputs Input values, one row of the input layer size per sample.
+     * @param rows Number of samples.
+     */
+    void feedForward(const double *inputs, unsigned rows);
+
+    /**
+     * @brief Train on a batch: feedforward pass, backpropagation and one update of the weights.
+     * @param inputs Input values, one row of the input layer size per sample.
+     * @param targets Target values, one row of the output layer size per sample.
+     * @param rows Number of samples.
+     * @return Loss summed over the samples, before the update.
+     */
+    double train(const double *inputs, const double *targets, unsigned rows);
+
+    /**
+     * @brief Get the softmax probabilities of a row of the last feedforward pass.
+     * @param resultVals Vector to store the output values.
+     * @param row The row.
+     */
+    void getResults(vector<double> &resultVals, unsigned row = 0) const;
+
+    /**
+     * @brief Count the rows of the last feedforward pass whose prediction is correct.
+     * @param targets Target values, one row of the output layer size per sample.
+     * @return Number of correct rows.
+     */
+    unsigned countCorrect(const double *targets) const;
+
+    /**
+     * @brief Get a float master weight, like Net::getWeight().
+     * @param layerNum Layer the connection starts in.
+     * @param from Neuron the connection starts at, the layer size for the bias.
+     * @param to Neuron of the next layer the connection leads to.
+     */
+    double getWeight(unsigned layerNum, unsigned from, unsigned to) const;
+
+    /**
+     * @brief Memory read by the kernels for the weights: the bfloat16 weights and the float biases.
+     * @return Size in bytes.
+     */
+    size_t weightBytes() const;
+};
+
+#endif // BF16_NET_HPP
@@ -0,0 +1,892 @@
+/**
+ * @file check.cpp
+ * @brief Implementation of the correctness checks of the optimized network.
+ */
+
+#include "check.hpp"
+#include "reference_net.hpp"
+#include "pipeline.hpp"
+#include "fast_math.hpp"
+#include "bf16_net.hpp"
+#include "sparse_net.hpp"
+#include "static_net.hpp"
+#include "quantized_net.hpp"
+#include "hogwild.hpp"
+#include "process_group.hpp"
+#include "random.hpp"
+#include <unistd.h>
+#include <cmath>
+#include <algorithm>
+#include <random>
+#include <memory>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+/**
+ * @brief Learning rate of the training checks, large enough for the weights to move.
+ */
+static const double checkLearningRate = 0.01;
+
+/**
+ * @brief Topology as dash-separated layer sizes.
+ */
+static string topologyName(const vector<unsigned> &topology)
+{
+    string name;
+    for (unsigned size : topology)
+    {
+        name += (name.empty() ? "" : "-") + to_string(size);
+    }
+    return name;
+}
+
+/**
+ * @brief Generate a batch of inputs in [0, 1] and one-hot labels.
+ */
+static void randomBatch(const vector<unsigned> &topology, unsigned rows, mt19937 &generator,
+                        vector<double> &inputs, vector<double> &labels)
+{
+    uniform_real_distribution<> distribution(0.0, 1.0);
+    inputs.resize(rows * topology.front());
+    for (double &value : inputs)
+    {
+        value = distribution(generator);
+    }
+    labels.assign(rows * topology.back(), 0.0);
+    for (unsigned r = 0; r < rows; ++r)
+    {
+        labels[r * topology.back() + generator() % topology.back()] = 1.0;
+    }
+}
+
+/**
+ * @class CheckDataset
+ * @brief Random samples written to temporary files in the format of the dataset, for the
+ * checks of the parts reading InputData and LabelData; the files are removed again.
+ */
+class CheckDataset
+{
+private:
+    /**
+     * @brief Paths of the input and the label file.
+     */
+    string m_inputPath, m_labelPath;
+
+    /**
+     * @brief Create an empty temporary file.
+     */
+    static string temporaryFile()
+    {
+        char path[] = "/tmp/check-data-XXXXXX";
+        const int fd = mkstemp(path);
+        if (fd < 0)
+        {
+            throw runtime_error("Unable to create a temporary file");
+        }
+        close(fd);
+        return path;
+    }
+
+public:
+    /**
+     * @brief Write the samples: pixel values in [0, 255] and the class chosen by `label`.
+     * @param numInputs Number of values of a sample.
+     * @param samples Number of samples.
+     * @param generator Generator of the pixel values.
+     * @param label Function giving the class of the inputs of a sample, scaled to [0, 1].
+     */
+    template <typename Label>
+    CheckDataset(unsigned numInputs, unsigned samples, mt19937 &generator, Label label) :
+        m_inputPath(temporaryFile()), m_labelPath(temporaryFile())
+    {
+        ofstream inputFile(m_inputPath), labelFile(m_labelPath);
+        vector<double> input(numInputs);
+        for (unsigned sample = 0; sample < samples; ++sample)
+        {
+            for (unsigned i = 0; i < numInputs; ++i)
+            {
+                const unsigned pixel = generator() % 256;
+                input[i] = pixel / 255.0;
+                inputFile << (i > 0 ? "," : "") << pixel;
+            }
+            inputFile << "\n";
+            labelFile << label(input) << "\n";
+        }
+    }
+
+    CheckDataset(const CheckDataset &) = delete;
+    CheckDataset &operator=(const CheckDataset &) = delete;
+
+    ~CheckDataset()
+    {
+        unlink(m_inputPath.c_str());
+        unlink(m_labelPath.c_str());
+    }
+
+    /**
+     * @brief Get the path of the input file.
+     */
+    const string &inputPath() const { return m_inputPath; }
+
+    /**
+     * @brief Get the path of the label file.
+     */
+    const string &labelPath() const { return m_labelPath; }
+};
+
+/**
+ * @brief The larger of two differences, NaN if either is NaN (std::max would drop it).
+ */
+static double worse(double a, double b)
+{
+    return isNanBits(a) || isNanBits(b) ? NAN : max(a, b);
+}
+
+/**
+ * @brief Largest difference of the trained weights (not the biases) of two networks.
+ */
+template <typename A, typename B>
+static double weightDifference(const A &a, const B &b, const vector<unsigned> &topology)
+{
+    double difference = 0.0;
+    for (unsigned layerNum = 0; layerNum + 1 < topology.size(); ++layerNum)
+    {
+        for (unsigned from = 0; from < topology[layerNum]; ++from)
+        {
+            for (unsigned to = 0; to < topology[layerNum + 1]; ++to)
+            {
+                difference = worse(difference, relativeDifference(a.getWeight(layerNum, from, to),
+                                                                  b.getWeight(layerNum, from, to)));
+            }
+        }
+    }
+    return difference;
+}
+
+/**
+ * @brief Feed a batch forward and backpropagate it through a layer-by-layer Net.
+ * @return Loss summed over the samples.
+ */
+static double trainRows(Net &net, const vector<double> &inputs, const vector<double> &labels, unsigned rows)
+{
+    net.resetGradientSum();
+    net.feedForward(inputs.data(), rows);
+    net.backProp(labels.data());
+    return net.getError();
+}
+
+/**
+ * @brief Average the gradients of a batch and update the weights.
+ */
+template <typename NetType>
+static void update(NetType &net, unsigned rows)
+{
+    net.calcAvgGradient(rows);
+    net.updateWeights();
+}
+
+double relativeDifference(double a, double b)
+{
+    return fabs(a - b) / max(1.0, max(fabs(a), fabs(b)));
+}
+
+CheckResult checkGradients(const vector<unsigned> &topology, Activation activation, unsigned rows, unsigned seed)
+{
+    // Step of the central differences, small against the weights and large against the rounding
+    const double step = 1e-5;
+
+    CheckResult result;
+    result.name = "gradient " + topologyName(topology) + " " + activationName(activation);
+    // Steps across the kink of a (leaky) ReLU cost some accuracy, a wrong gradient is off by far more
+    result.tolerance = 1e-4;
+
+    mt19937 generator(seed);
+    vector<double> inputs, labels;
+    randomBatch(topology, rows, generator, inputs, labels);
+
+    Net net(topology, seed, activation);
+    trainRows(net, inputs, labels, rows);
+    net.calcAvgGradient(rows);
+
+    // The loss passes overwrite the gradients, read all analytic ones first
+    vector<double> gradients;
+    for (unsigned layerNum = 0; layerNum + 1 < topology.size(); ++layerNum)
+    {
+        for (unsigned from = 0; from < topology[layerNum]; ++from)
+        {
+            for (unsigned to = 0; to < topology[layerNum + 1]; ++to)
+            {
+                gradients.push_back(net.getGradient(layerNum, from, to));
+            }
+        }
+    }
+
+    auto loss = [&]() { return trainRows(net, inputs, labels, rows) / rows; };
+
+    unsigned index = 0;
+    for (unsigned layerNum = 0; layerNum + 1 < topology.size(); ++layerNum)
+    {
+        for (unsigned from = 0; from < topology[layerNum]; ++from)
+        {
+            for (unsigned to = 0; to < topology[layerNum + 1]; ++to)
+            {
+                const double analytic = gradients[index++];
+                const double weight = net.getWeight(layerNum, from, to);
+                net.setWeight(layerNum, from, to, weight + step);
+                const double plus = loss();
+                net.setWeight(layerNum, from, to, weight - step);
+                const double minus = loss();
+                net.setWeight(layerNum, from, to, weight);
+
+                // Gradients of inactive units are both (close to) zero
+                const double numeric = (plus - minus) / (2 * step);
+                const double scale = fabs(analytic) + fabs(numeric);
+                if (scale > 1e-7 || isNanBits(scale))
+                {
+                    result.error = worse(result.error, fabs(analytic - numeric) / scale);
+                }
+            }
+        }
+    }
+    return result;
+}
+
+vector<CheckResult> checkReference(const vector<unsigned> &topology, unsigned rows, unsigned batches)
+{
+    const string name = topologyName(topology);
+    CheckResult forward{"reference forward " + name, 0.0, 1e-12};
+    CheckResult loss{"reference loss " + name, 0.0, 1e-12};
+    CheckResult weights{"reference update " + name, 0.0, 1e-9};
+
+    const unsigned numInputs = topology.front(), numOutputs = topology.back();
+    ReferenceNet reference(topology, 1);
+    ReferenceNet::setLearningRate(checkLearningRate);
+    Net net(topology, 1);
+    net.setLearningRate(checkLearningRate);
+
+    mt19937 generator(2);
+    vector<double> inputs, labels, input, label, output;
+    for (unsigned batch = 0; batch < batches; ++batch)
+    {
+        randomBatch(topology, rows, generator, inputs, labels);
+        const double netLoss = trainRows(net, inputs, labels, rows);
+
+        // The network outputs of the last feedforward pass are those of the batch
+        reference.resetGradientSum();
+        double referenceLoss = 0.0;
+        for (unsigned r = 0; r < rows; ++r)
+        {
+            input.assign(inputs.begin() + r * numInputs, inputs.begin() + (r + 1) * numInputs);
+            label.assign(labels.begin() + r * numOutputs, labels.begin() + (r + 1) * numOutputs);
+            reference.feedForward(input);
+            reference.getResults(output);
+            for (unsigned j = 0; j < numOutputs; ++j)
+            {
+                const double difference = relativeDifference(output[j], net.getOutputs()[r * numOutputs + j]);
+                forward.error = worse(forward.error, difference);
+            }
+            reference.backProp(label);
+            referenceLoss += reference.getError();
+        }
+        loss.error = worse(loss.error, relativeDifference(referenceLoss / rows, netLoss / rows));
+
+        update(reference, rows);
+        update(net, rows);
+        weights.error = worse(weights.error, weightDifference(reference, net, topology));
+    }
+    return {forward, loss, weights};
+}
+
+CheckResult checkPerSample(const vector<unsigned> &topology, unsigned rows, unsigned batches, Optimizer optimizer)
+{
+    CheckResult result{"per-sample " + topologyName(topology) + " " + optimizerName(optimizer), 0.0, 1e-9};
+
+    const unsigned numInputs = topology.front(), numOutputs = topology.back();
+    Net sampleNet(topology, 3), batchNet(topology, 3);
+    for (Net *net : {&sampleNet, &batchNet})
+    {
+        net->setLearningRate(checkLearningRate);
+        net->setOptimizer(optimizer);
+    }
+
+    mt19937 generator(4);
+    vector<double> inputs, labels, input, label;
+    for (unsigned batch = 0; batch < batches; ++batch)
+    {
+        randomBatch(topology, rows, generator, inputs, labels);
+        trainRows(batchNet, inputs, labels, rows);
+
+        sampleNet.resetGradientSum();
+        for (unsigned r = 0; r < rows; ++r)
+        {
+            input.assign(inputs.begin() + r * numInputs, inputs.begin() + (r + 1) * numInputs);
+            label.assign(labels.begin() + r * numOutputs, labels.begin() + (r + 1) * numOutputs);
+            sampleNet.feedForward(input);
+            sampleNet.backProp(label);
+        }
+
+        update(sampleNet, rows);
+        update(batchNet, rows);
+        result.error = worse(result.error, weightDifference(sampleNet, batchNet, topology));
+    }
+    return result;
+}
+
+CheckResult checkPipeline(const vector<unsigned> &topology, unsigned stages, unsigned rows, unsigned batches)
+{
+    CheckResult result{"pipeline " + topologyName(topology) + " " + to_string(stages) + " stages", 0.0, 1e-9};
+
+    Net pipelinedNet(topology, 5), net(topology, 5);
+    pipelinedNet.setLearningRate(checkLearningRate);
+    net.setLearningRate(checkLearningRate);
+    pipelinedNet.reserveRows(rows);
+    Pipeline pipeline(pipelinedNet, stages, 4, 5);
+
+    mt19937 generator(6);
+    vector<double> inputs, labels;
+    for (unsigned batch = 0; batch < batches; ++batch)
+    {
+        randomBatch(topology, rows, generator, inputs, labels);
+        const double loss = trainRows(net, inputs, labels, rows);
+
+        pipelinedNet.resetGradientSum();
+        const double pipelinedLoss = pipeline.forwardBackward(inputs.data(), labels.data(), rows);
+        result.error = worse(result.error, relativeDifference(pipelinedLoss / rows, loss / rows));
+
+        update(pipelinedNet, rows);
+        update(net, rows);
+        result.error = worse(result.error, weightDifference(pipelinedNet, net, topology));
+    }
+    return result;
+}
+
+CheckResult checkEnsemble(const vector<unsigned> &topology, unsigned rows, unsigned batches)
+{
+    CheckResult result{"ensemble " + topologyName(topology) + " member 0", 0.0, 1e-9};
+
+    Net ensemble(topology, 7, Activation::ReLU, false, 2), net(topology, 7);
+    ensemble.setLearningRate(checkLearningRate);
+    net.setLearningRate(checkLearningRate);
+
+    mt19937 generator(8);
+    vector<double> inputs, labels;
+    for (unsigned batch = 0; batch < batches; ++batch)
+    {
+        randomBatch(topology, rows, generator, inputs, labels);
+        trainRows(ensemble, inputs, labels, rows);
+        trainRows(net, inputs, labels, rows);
+
+        update(ensemble, rows);
+        update(net, rows);
+        result.error = worse(result.error, weightDifference(ensemble, net, topology));
+    }
+    return result;
+}
+
+CheckResult checkFastMath(const vector<unsigned> &topology, unsigned rows, unsigned batches, Optimizer optimizer)
+{
+    // The RMSProp step divides by fastSqrt() of the moving averages, whose relative error
+    // of about 1e-11 must stay bounded over the updates
+    CheckResult result{"fast math " + topologyName(topology) + " " + optimizerName(optimizer), 0.0, 1e-9};
+
+    const bool fastMath = fastMathEnabled();
+    Net fastNet(topology, 9), exactNet(topology, 9);
+    for (Net *net : {&fastNet, &exactNet})
+    {
+        net->setLearningRate(checkLearningRate);
+        net->setOptimizer(optimizer);
+    }
+
+    mt19937 generator(10);
+    vector<double> inputs, labels;
+    for (unsigned batch = 0; batch < batches; ++batch)
+    {
+        randomBatch(topology, rows, generator, inputs, labels);
+        setFastMath(true);
+        trainRows(fastNet, inputs, labels, rows);
+        update(fastNet, rows);
+        setFastMath(false);
+        trainRows(exactNet, inputs, labels, rows);
+        update(exactNet, rows);
+        result.error = worse(result.error, weightDifference(fastNet, exactNet, topology));
+    }
+    setFastMath(fastMath);
+    return result;
+}
+
+vector<CheckResult> checkMixedPrecision(const vector<unsigned> &topology, unsigned rows, unsigned batches)
+{
+    const string name = topologyName(topology);
+    vector<CheckResult> results = {{"bf16 forward " + name, 0.0, 2e-2},
+                                   {"bf16 loss " + name, 0.0, 2e-2},
+                                   {"bf16 update " + name, 0.0, 5e-2}};
+
+    // Weights (not the biases) of a network in one array
+    auto weights = [&topology](const auto &net) {
+        vector<double> values;
+        for (unsigned layerNum = 0; layerNum + 1 < topology.size(); ++layerNum)
+        {
+            for (unsigned from = 0; from < topology[layerNum]; ++from)
+            {
+                for (unsigned to = 0; to < topology[layerNum + 1]; ++to)
+                {
+                    values.push_back(net.getWeight(layerNum, from, to));
+                }
+            }
+        }
+        return values;
+    };
+
+    mt19937 generator(13);
+    vector<double> inputs, labels, output, mixedOutput, updateErrors;
+    for (unsigned batch = 0; batch < batches; ++batch)
+    {
+        // SGD keeps the update proportional to the gradient, RMSProp would magnify rounding of tiny ones
+        Net net(topology, 12 + batch);
+        net.setLearningRate(checkLearningRate);
+        net.setOptimizer(Optimizer::SGD);
+        Bf16Net mixedNet(net);
+        const vector<double> initial = weights(net);
+
+        randomBatch(topology, rows, generator, inputs, labels);
+        const double loss = trainRows(net, inputs, labels, rows);
+        update(net, rows);
+        const double mixedLoss = mixedNet.train(inputs.data(), labels.data(), rows);
+
+        // The outputs of the pass before the update are still in both networks
+        for (unsigned r = 0; r < rows; ++r)
+        {
+            net.getResults(output, r);
+            mixedNet.getResults(mixedOutput, r);
+            for (unsigned j = 0; j < output.size(); ++j)
+            {
+                results[0].error = worse(results[0].error, fabs(output[j] - mixedOutput[j]));
+            }
+        }
+        results[1].error = worse(results[1].error, fabs(loss - mixedLoss) / loss);
+
+        // Relative error of the whole update from the same weights
+        const vector<double> updated = weights(net), mixedUpdated = weights(mixedNet);
+        double difference = 0.0, norm = 0.0;
+        for (unsigned k = 0; k < initial.size(); ++k)
+        {
+            difference += (updated[k] - mixedUpdated[k]) * (updated[k] - mixedUpdated[k]);
+            norm += (updated[k] - initial[k]) * (updated[k] - initial[k]);
+        }
+        updateErrors.push_back(sqrt(difference / norm));
+    }
+
+    // A hidden potential rounded across zero changes the gradient of its unit completely, which
+    // happens in some batches; a wrong kernel is off in all of them, so the median still fails
+    nth_element(updateErrors.begin(), updateErrors.begin() + batches / 2, updateErrors.end());
+    results[2].error = updateErrors[batches / 2];
+    return results;
+}
+
+vector<CheckResult> checkSparse(const vector<unsigned> &topology, unsigned rows, unsigned batches)
+{
+    const string name = topologyName(topology);
+    vector<CheckResult> results = {{"pruned weights " + name, 0.0, 0.0},
+                                   {"sparse forward " + name, 0.0, 1e-5}};
+
+    Net net(topology, 14);
+    net.setLearningRate(checkLearningRate);
+    mt19937 generator(15);
+    vector<double> inputs, labels, output, sparseOutput;
+
+    // Prune half of the weights after the first batch, then fine-tune the rest
+    vector<bool> pruned;
+    for (unsigned batch = 0; batch < batches; ++batch)
+    {
+        randomBatch(topology, rows, generator, inputs, labels);
+        trainRows(net, inputs, labels, rows);
+        update(net, rows);
+        if (batch == 0)
+        {
+            net.prune(0.5);
+            for (unsigned layerNum = 0; layerNum + 1 < topology.size(); ++layerNum)
+            {
+                for (unsigned from = 0; from < topology[layerNum]; ++from)
+                {
+                    for (unsigned to = 0; to < topology[layerNum + 1]; ++to)
+                    {
+                        pruned.push_back(net.getWeight(layerNum, from, to) == 0.0);
+                    }
+                }
+            }
+        }
+    }
+
+    // Pruned weights must have stayed at zero
+    unsigned k = 0;
+    for (unsigned layerNum = 0; layerNum + 1 < topology.size(); ++layerNum)
+    {
+        for (unsigned from = 0; from < topology[layerNum]; ++from)
+        {
+            for (unsigned to = 0; to < topology[layerNum + 1]; ++to)
+            {
+                if (pruned[k++])
+                {
+                    results[0].error = worse(results[0].error, fabs(net.getWeight(layerNum, from, to)));
+                }
+            }
+        }
+    }
+
+    // Both passes of the CSR model against the pruned network
+    SparseNet sparseNet(net);
+    randomBatch(topology, rows, generator, inputs, labels);
+    net.feedForward(inputs.data(), rows);
+    sparseNet.feedForward(inputs.data(), rows);
+    for (unsigned r = 0; r < rows; ++r)
+    {
+        net.getResults(output, r);
+        sparseNet.getResults(sparseOutput, r);
+        for (unsigned j = 0; j < output.size(); ++j)
+        {
+            results[1].error = worse(results[1].error, fabs(output[j] - sparseOutput[j]));
+        }
+    }
+    for (unsigned r = 0; r < rows; ++r)
+    {
+        const vector<double> input(inputs.begin() + r * topology.front(), inputs.begin() + (r + 1) * topology.front());
+        net.feedForward(input);
+        net.getResults(output);
+        sparseNet.feedForward(input);
+        sparseNet.getResults(sparseOutput);
+        for (unsigned j = 0; j < output.size(); ++j)
+        {
+            results[1].error = worse(results[1].error, fabs(output[j] - sparseOutput[j]));
+        }
+    }
+    return results;
+}
+
+template <unsigned... Sizes>
+CheckResult checkStatic(unsigned rows, unsigned batches)
+{
+    using Static = StaticNet<Sizes...>;
+    const vector<unsigned> topology = Static::topology();
+    CheckResult result{"static " + topologyName(topology), 0.0, 1e-9};
+
+    const unsigned numInputs = topology.front(), numOutputs = topology.back();
+    // The layers of the dataset topology are too large for the stack
+    unique_ptr<Static> staticNet = make_unique<Static>(20);
+    Static::setLearningRate(checkLearningRate);
+    Net net(topology, 20);
+    net.setLearningRate(checkLearningRate);
+
+    // StaticNet has no weight accessors, its outputs and losses show the updates of the batches before
+    mt19937 generator(21);
+    vector<double> inputs, labels, input, label, output;
+    for (unsigned batch = 0; batch < batches; ++batch)
+    {
+        randomBatch(topology, rows, generator, inputs, labels);
+        const double loss = trainRows(net, inputs, labels, rows);
+
+        staticNet->resetGradientSum();
+        double staticLoss = 0.0;
+        for (unsigned r = 0; r < rows; ++r)
+        {
+            input.assign(inputs.begin() + r * numInputs, inputs.begin() + (r + 1) * numInputs);
+            label.assign(labels.begin() + r * numOutputs, labels.begin() + (r + 1) * numOutputs);
+            staticNet->feedForward(input);
+            staticNet->getResults(output);
+            for (unsigned j = 0; j < numOutputs; ++j)
+            {
+                result.error = worse(result.error, relativeDifference(output[j], net.getOutputs()[r * numOutputs + j]));
+            }
+            staticNet->backProp(label);
+            staticLoss += staticNet->getError();
+        }
+        result.error = worse(result.error, relativeDifference(staticLoss / rows, loss / rows));
+
+        update(*staticNet, rows);
+        update(net, rows);
+    }
+    return result;
+}
+
+vector<CheckResult> checkQuantized(const vector<unsigned> &topology, unsigned samples)
+{
+    const string name = topologyName(topology);
+    vector<CheckResult> results = {{"int8 forward " + name, 0.0, 1e-1},
+                                   {"int8 accuracy " + name, 0.0, 5e-2}};
+
+    // Labelled with the predictions of the float network, so the accuracy of the quantized one
+    // is the fraction of predictions quantization leaves unchanged
+    Net net(topology, 22);
+    vector<double> output;
+    mt19937 generator(23);
+    CheckDataset dataset(topology.front(), 2 * samples, generator, [&](const vector<double> &input) {
+        net.feedForward(input);
+        net.getResults(output);
+        return distance(output.begin(), max_element(output.begin(), output.end()));
+    });
+    InputData inputs(dataset.inputPath(), 255.0, 1);
+    LabelData labels(dataset.labelPath(), topology.back(), false);
+    inputs.splitData(0.5);
+    labels.splitData(0.5);
+
+    // Calibrated on the validation half, compared on the training half
+    QuantizedNet quantizedNet(net, inputs);
+    vector<double> quantizedOutput;
+    unsigned changed = 0;
+    for (unsigned sample = 0; sample < inputs.trainLength(); ++sample)
+    {
+        net.feedForward(inputs.getTrain(sample));
+        net.getResults(output);
+        quantizedNet.feedForward(inputs.getTrain(sample));
+        quantizedNet.getResults(quantizedOutput);
+        for (unsigned j = 0; j < output.size(); ++j)
+        {
+            results[0].error = worse(results[0].error, fabs(output[j] - quantizedOutput[j]));
+        }
+        const vector<double> &label = labels.getTrain(sample);
+        changed += distance(quantizedOutput.begin(), max_element(quantizedOutput.begin(), quantizedOutput.end())) !=
+                   distance(label.begin(), max_element(label.begin(), label.end()));
+    }
+    results[1].error = double(changed) / inputs.trainLength();
+    return results;
+}
+
+vector<CheckResult> checkDropout(const vector<unsigned> &topology, unsigned rows, double probability)
+{
+    const string name = topologyName(topology);
+    vector<CheckResult> results = {{"dropout forward " + name, 0.0, 1e-12},
+                                   {"dropout backward " + name, 0.0, 1e-12}};
+
+    Net net(topology, 24);
+    for (unsigned layerNum = 1; layerNum + 1 < topology.size(); ++layerNum)
+    {
+        net.setDropout(layerNum, probability);
+    }
+
+    // The same graph unfused, with the weights of the net: dense, activation and dropout
+    // layers, dense and softmax for the output
+    vector<unique_ptr<Layer>> layers;
+    vector<DenseLayer *> denseLayers;
+    for (unsigned layerNum = 0; layerNum + 1 < topology.size(); ++layerNum)
+    {
+        auto dense = make_unique<DenseLayer>(topology[layerNum], topology[layerNum + 1]);
+        for (unsigned to = 0; to < topology[layerNum + 1]; ++to)
+        {
+            for (unsigned from = 0; from < topology[layerNum]; ++from)
+            {
+                dense->setWeight(to, from, net.getWeight(layerNum, from, to));
+            }
+            dense->setBias(to, net.getWeight(layerNum, topology[layerNum], to));
+        }
+        denseLayers.push_back(dense.get());
+        layers.push_back(move(dense));
+        if (layerNum + 2 < topology.size())
+        {
+            layers.push_back(make_unique<ActivationLayer>(topology[layerNum + 1], Activation::ReLU));
+            layers.push_back(make_unique<DropoutLayer>(topology[layerNum + 1], probability));
+        }
+        else
+        {
+            layers.push_back(make_unique<SoftmaxOutputLayer>(topology.back()));
+        }
+    }
+
+    mt19937 generator(25);
+    vector<double> inputs, labels;
+    randomBatch(topology, rows, generator, inputs, labels);
+
+    // Both draw their masks from the generator of the thread, layer after layer
+    seedThreadGenerator(26);
+    trainRows(net, inputs, labels, rows);
+
+    seedThreadGenerator(26);
+    vector<vector<double>> values(layers.size() + 1), aux(layers.size()), gradients(layers.size() + 1);
+    values[0] = inputs;
+    for (unsigned k = 0; k < layers.size(); ++k)
+    {
+        values[k + 1].resize(rows * layers[k]->numOutputs());
+        aux[k].resize(rows * layers[k]->auxSize());
+        layers[k]->forward(values[k].data(), values[k + 1].data(), aux[k].data(), rows, true);
+        gradients[k].resize(rows * layers[k]->numInputs());
+    }
+    for (unsigned k = 0; k < values.back().size(); ++k)
+    {
+        results[0].error = worse(results[0].error, relativeDifference(values.back()[k], net.getOutputs()[k]));
+    }
+
+    const unsigned last = layers.size() - 1;
+    static_cast<SoftmaxOutputLayer &>(*layers[last])
+        .loss(values[last].data(), values[last + 1].data(), aux[last].data(), labels.data(), gradients[last].data(), rows);
+    for (unsigned k = last; k-- > 0;)
+    {
+        layers[k]->backward(values[k].data(), values[k + 1].data(), aux[k].data(), gradients[k + 1].data(),
+                            k > 0 ? gradients[k].data() : nullptr, rows);
+    }
+    for (unsigned layerNum = 0; layerNum + 1 < topology.size(); ++layerNum)
+    {
+        for (unsigned from = 0; from < topology[layerNum]; ++from)
+        {
+            for (unsigned to = 0; to < topology[layerNum + 1]; ++to)
+            {
+                const double difference = relativeDifference(denseLayers[layerNum]->getWeightGradient(to, from),
+                                                             net.getGradient(layerNum, from, to));
+                results[1].error = worse(results[1].error, difference);
+            }
+        }
+    }
+    return results;
+}
+
+CheckResult checkHogwild(const vector<unsigned> &topology, unsigned rows, unsigned batches)
+{
+    CheckResult result{"hogwild " + topologyName(topology) + " 1 worker", 0.0, 0.0};
+
+    mt19937 generator(27);
+    CheckDataset dataset(topology.front(), rows * batches, generator, [&](const vector<double> &) {
+        return generator() % topology.back();
+    });
+    InputData inputs(dataset.inputPath(), 255.0, rows);
+    LabelData labels(dataset.labelPath(), topology.back(), false);
+    inputs.splitData(1.0);
+    labels.splitData(1.0);
+
+    Net hogwildNet(topology, 28), net(topology, 28);
+    hogwildNet.setLearningRate(checkLearningRate);
+    net.setLearningRate(checkLearningRate);
+
+    // A single worker trains the network itself on the batches in order, so it must be bitwise the same
+    HogwildTrainer trainer(hogwildNet, inputs, labels, rows, 1, 29);
+    trainer.trainEpoch(0);
+
+    const unsigned numInputs = topology.front(), numOutputs = topology.back();
+    vector<double> batchInputs(rows * numInputs), batchLabels(rows * numOutputs);
+    for (unsigned batch = 0; batch < batches; ++batch)
+    {
+        for (unsigned r = 0; r < rows; ++r)
+        {
+            const vector<double> &input = inputs.getTrain(batch * rows + r), &label = labels.getTrain(batch * rows + r);
+            copy(input.begin(), input.end(), batchInputs.begin() + r * numInputs);
+            copy(label.begin(), label.end(), batchLabels.begin() + r * numOutputs);
+        }
+        trainRows(net, batchInputs, batchLabels, rows);
+        update(net, rows);
+    }
+    result.error = weightDifference(hogwildNet, net, topology);
+    return result;
+}
+
+CheckResult checkAllreduce(unsigned processes, size_t count)
+{
+    CheckResult result{"allreduce " + to_string(processes) + " processes", 0.0, 1e-12};
+
+    // Values of every rank, which every rank can generate
+    auto values = [count](unsigned rank) {
+        mt19937 generator(30 + rank);
+        uniform_real_distribution<> distribution(-1.0, 1.0);
+        vector<double> array(count);
+        for (double &value : array)
+        {
+            value = distribution(generator);
+        }
+        return array;
+    };
+
+    unique_ptr<ProcessGroup> group(ProcessGroup::launch(processes, max(count, size_t(processes))));
+    const unsigned rank = group->rank();
+    vector<double> reduced = values(rank), sum(count, 0.0);
+    group->allreduce(reduced.data(), count);
+    for (unsigned other = 0; other < processes; ++other)
+    {
+        const vector<double> array = values(other);
+        for (size_t k = 0; k < count; ++k)
+        {
+            sum[k] += array[k];
+        }
+    }
+    double error = 0.0;
+    for (size_t k = 0; k < count; ++k)
+    {
+        error = worse(error, relativeDifference(reduced[k], sum[k]));
+    }
+
+    // Rank 0 collects the errors of all ranks, the others are done
+    vector<double> errors(processes, 0.0);
+    errors[rank] = error;
+    group->allreduce(errors.data(), processes);
+    if (rank > 0)
+    {
+        _exit(0);
+    }
+    for (double rankError : errors)
+    {
+        result.error = worse(result.error, rankError);
+    }
+    return result;
+}
+
+vector<CheckResult> runChecks()
+{
+    const vector<vector<unsigned>> small = {{4, 5, 3}, {6, 8, 7, 4}, {3, 16, 2}, {10, 9, 8, 7, 6}};
+    const vector<unsigned> dataset = {784, 64, 32, 10};
+
+    vector<CheckResult> results;
+    unsigned seed = 11;
+    for (const vector<unsigned> &topology : small)
+    {
+        for (Activation activation : {Activation::Identity, Activation::ReLU, Activation::LeakyReLU, Activation::GELU})
+        {
+            results.push_back(checkGradients(topology, activation, 8, seed++));
+        }
+    }
+    for (const vector<unsigned> &topology : {small[1], small[3], dataset})
+    {
+        for (const CheckResult &result : checkReference(topology, 16, 5))
+        {
+            results.push_back(result);
+        }
+        results.push_back(checkPerSample(topology, 16, 5, Optimizer::RMSProp));
+        results.push_back(checkPerSample(topology, 16, 5, Optimizer::SGD));
+        results.push_back(checkPipeline(topology, 2, 16, 5));
+        results.push_back(checkEnsemble(topology, 16, 5));
+        results.push_back(checkFastMath(topology, 16, 5, Optimizer::SGD));
+        results.push_back(checkFastMath(topology, 16, 5, Optimizer::RMSProp));
+        for (const CheckResult &result : checkMixedPrecision(topology, 16, 9))
+        {
+            results.push_back(result);
+        }
+        for (const CheckResult &result : checkSparse(topology, 16, 5))
+        {
+            results.push_back(result);
+        }
+        for (const CheckResult &result : checkQuantized(topology, 200))
+        {
+            results.push_back(result);
+        }
+        for (const CheckResult &result : checkDropout(topology, 16, 0.3))
+        {
+            results.push_back(result);
+        }
+        results.push_back(checkHogwild(topology, 16, 5));
+    }
+    results.push_back(checkStatic<6, 8, 7, 4>(16, 5));
+    results.push_back(checkStatic<10, 9, 8, 7, 6>(16, 5));
+    results.push_back(checkStatic<784, 64, 32, 10>(16, 5));
+    results.push_back(checkPipeline(small[3], 4, 16, 5));
+    results.push_back(checkAllreduce(3, 1000));
+    return results;
+}
+
+bool printChecks(const vector<CheckResult> &results)
+{
+    bool passed = true;
+    cout << "Correctness checks, largest difference (tolerance)" << endl;
+    for (const CheckResult &result : results)
+    {
+        cout << setw(40) << left << result.name << right << scientific << setprecision(2) << setw(12) << result.error
+             << " (" << result.tolerance << ")  " << (result.passed() ? "ok" : "FAILED")
+             << defaultfloat << setprecision(6) << endl;
+        passed = passed && result.passed();
+    }
+    return passed;
+}
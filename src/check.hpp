@@ -0,0 +1,229 @@
+/**
+ * @file check.hpp
+ * @brief Declaration of the correctness checks of the optimized network against numeric
+ * gradients and the per-neuron reference implementation.
+ */
+#ifndef CHECK_HPP
+#define CHECK_HPP
+
+#include <vector>
+#include <string>
+#include "net.hpp"
+#include "fast_math.hpp"
+
+using namespace std;
+
+/**
+ * @struct CheckResult
+ * @brief Outcome of one correctness check.
+ */
+struct CheckResult
+{
+    /**
+     * @brief What was compared, e.g. "gradient 4-5-3 gelu".
+     */
+    string name;
+
+    /**
+     * @brief Largest difference found (see relativeDifference()).
+     */
+    double error = 0.0;
+
+    /**
+     * @brief Largest difference accepted.
+     */
+    double tolerance = 0.0;
+
+    /**
+     * @brief Whether the check passed (NaN fails).
+     */
+    bool passed() const { return !isNanBits(error) && error <= tolerance; }
+};
+
+/**
+ * @brief Difference of two values, relative for values larger than 1 and absolute otherwise.
+ * @param a First value.
+ * @param b Second value.
+ */
+double relativeDifference(double a, double b);
+
+/**
+ * @brief Compare the weight gradients of a batch computed by backpropagation with central
+ * differences of the average loss.
+ *
+ * The largest error is the relative error `|a - n| / (|a| + |n|)` of the analytic gradient
+ * `a` and the numeric gradient `n`, over the weights whose gradients are not both tiny.
+ *
+ * @param topology Number of neurons in each layer.
+ * @param activation Activation function of the hidden layers.
+ * @param rows Batch size.
+ * @param seed Seed of the weights and of the batch.
+ * @return The result.
+ */
+CheckResult checkGradients(const vector<unsigned> &topology, Activation activation, unsigned rows, unsigned seed);
+
+/**
+ * @brief Train a batched Net and the per-neuron ReferenceNet from the same weights on the
+ * same batches and compare the outputs, the losses and the weights after every update.
+ *
+ * @param topology Number of neurons in each layer.
+ * @param rows Batch size.
+ * @param batches Number of batches.
+ * @return The results of the forward pass, the loss and the update.
+ */
+vector<CheckResult> checkReference(const vector<unsigned> &topology, unsigned rows, unsigned batches);
+
+/**
+ * @brief Train a Net fed sample by sample and one fed whole batches from the same weights
+ * and compare the weights after every update.
+ *
+ * @param topology Number of neurons in each layer.
+ * @param rows Batch size.
+ * @param batches Number of batches.
+ * @param optimizer Update rule of the weights.
+ * @return The result.
+ */
+CheckResult checkPerSample(const vector<unsigned> &topology, unsigned rows, unsigned batches, Optimizer optimizer);
+
+/**
+ * @brief Train a Net with a pipeline of layer stages and one layer after layer from the
+ * same weights and compare the losses and the weights after every update.
+ *
+ * @param topology Number of neurons in each layer.
+ * @param stages Number of pipeline stages.
+ * @param rows Batch size.
+ * @param batches Number of batches.
+ * @return The result.
+ */
+CheckResult checkPipeline(const vector<unsigned> &topology, unsigned stages, unsigned rows, unsigned batches);
+
+/**
+ * @brief Train an ensemble of two members and a single net with the seed of the first
+ * member and compare the weights of the first member after every update.
+ *
+ * @param topology Number of neurons in each layer.
+ * @param rows Batch size.
+ * @param batches Number of batches.
+ * @return The result.
+ */
+CheckResult checkEnsemble(const vector<unsigned> &topology, unsigned rows, unsigned batches);
+
+/**
+ * @brief Train a Net with the polynomial approximations of fast_math.hpp and one with the
+ * exact functions from the same weights and compare the weights after every update.
+ *
+ * With RMSProp the tolerance also bounds the relative error of the steps divided by the
+ * fastSqrt() of the moving averages.
+ *
+ * @param topology Number of neurons in each layer.
+ * @param rows Batch size.
+ * @param batches Number of batches.
+ * @param optimizer Update rule of the weights.
+ * @return The result.
+ */
+CheckResult checkFastMath(const vector<unsigned> &topology, unsigned rows, unsigned batches, Optimizer optimizer);
+
+/**
+ * @brief Update a Net and a Bf16Net from the same weights with SGD, one batch each from new
+ * weights, and compare the output probabilities, the losses and the updates of the weights
+ * (median over the batches of the relative error of the whole update).
+ *
+ * The tolerances allow for bfloat16 (8 significant bits), to catch wrong kernels rather
+ * than rounding.
+ *
+ * @param topology Number of neurons in each layer.
+ * @param rows Batch size.
+ * @param batches Number of batches.
+ * @return The results of the forward pass, the loss and the update.
+ */
+vector<CheckResult> checkMixedPrecision(const vector<unsigned> &topology, unsigned rows, unsigned batches);
+
+/**
+ * @brief Prune half of the weights of a Net after one batch, train it on further batches, and
+ * check that the pruned weights stayed at zero and that a SparseNet of it computes the same
+ * output probabilities, fed whole batches and one sample at a time.
+ *
+ * @param topology Number of neurons in each layer.
+ * @param rows Batch size.
+ * @param batches Number of batches.
+ * @return The results of the pruned weights and of the forward pass.
+ */
+vector<CheckResult> checkSparse(const vector<unsigned> &topology, unsigned rows, unsigned batches);
+
+/**
+ * @brief Train a StaticNet and a Net from the same weights on the same batches, the StaticNet
+ * sample by sample, and compare the outputs and the losses of every batch.
+ *
+ * Defined in check.cpp, where it is instantiated for the checked topologies.
+ *
+ * @tparam Sizes Number of neurons in each layer.
+ * @param rows Batch size.
+ * @param batches Number of batches.
+ * @return The result.
+ */
+template <unsigned... Sizes>
+CheckResult checkStatic(unsigned rows, unsigned batches);
+
+/**
+ * @brief Quantize a Net calibrated on random samples labelled with its own predictions, and
+ * compare the output probabilities of the QuantizedNet on other samples and the fraction of
+ * them it classifies differently.
+ *
+ * The tolerances allow for int8 weights and activations, to catch wrong kernels rather than
+ * rounding.
+ *
+ * @param topology Number of neurons in each layer.
+ * @param samples Number of samples to calibrate on and of samples to compare.
+ * @return The results of the forward pass and the accuracy.
+ */
+vector<CheckResult> checkQuantized(const vector<unsigned> &topology, unsigned samples);
+
+/**
+ * @brief Feed a batch forward and backward through a Net with dropout fused into its dense
+ * layers and through the same layers unfused, with the masks drawn from the same seed, and
+ * compare the outputs and the weight gradients.
+ *
+ * @param topology Number of neurons in each layer.
+ * @param rows Batch size.
+ * @param probability Dropout probability of the hidden layers.
+ * @return The results of the forward and the backward pass.
+ */
+vector<CheckResult> checkDropout(const vector<unsigned> &topology, unsigned rows, double probability);
+
+/**
+ * @brief Train a Net for one epoch with a single Hogwild worker and one batch after batch
+ * from the same weights and compare the weights, which must be equal.
+ *
+ * @param topology Number of neurons in each layer.
+ * @param rows Batch size.
+ * @param batches Number of batches of the epoch.
+ * @return The result.
+ */
+CheckResult checkHogwild(const vector<unsigned> &topology, unsigned rows, unsigned batches);
+
+/**
+ * @brief Launch a ProcessGroup, sum random arrays of all ranks with allreduce() and compare
+ * the result of every rank with the sum computed directly.
+ *
+ * The other ranks exit inside the call, only rank 0 returns.
+ *
+ * @param processes Number of processes.
+ * @param count Number of values of the arrays.
+ * @return The result.
+ */
+CheckResult checkAllreduce(unsigned processes, size_t count);
+
+/**
+ * @brief Run all checks on a set of small random topologies and the dataset topology.
+ * @return The results.
+ */
+vector<CheckResult> runChecks();
+
+/**
+ * @brief Print the results as a table.
+ * @param results The results.
+ * @return Whether all checks passed.
+ */
+bool printChecks(const vector<CheckResult> &results);
+
+#endif // CHECK_HPP
@@ -0,0 +1,129 @@
+/**
+ * @file evaluator.cpp
+ * @brief Implementation of the evaluation of epochs on a background thread.
+ */
+
+#include "evaluator.hpp"
+#include "tracer.hpp"
+#include <cassert>
+#include <algorithm>
+
+AsyncEvaluator::AsyncEvaluator(const Net &net, const InputData &inputs, const LabelData &labels,
+                               const vector<unsigned> &trainSamples) :
+    m_inputs(inputs),
+    m_labels(labels),
+    m_trainSamples(trainSamples),
+    m_net(net.getTopology(), 0, net.getActivation(), false, net.getMembers()),
+    m_state(net.stateSize()),
+    m_busy(false),
+    m_pending(false),
+    m_done(false),
+    m_stop(false),
+    m_epoch(0)
+{
+    m_net.reserveRows(batchRows);
+    m_thread = thread(&AsyncEvaluator::loop, this);
+}
+
+AsyncEvaluator::~AsyncEvaluator()
+{
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_requested.notify_one();
+    m_thread.join();
+}
+
+void AsyncEvaluator::start(const Net &net, unsigned epoch)
+{
+    assert(!m_busy);
+    {
+        lock_guard<mutex> lock(m_mutex);
+        net.saveState(m_state.data());
+        m_epoch = epoch;
+        m_pending = true;
+        m_done = false;
+    }
+    m_busy = true;
+    m_requested.notify_one();
+}
+
+unsigned AsyncEvaluator::wait(EpochMetrics &metrics, chrono::steady_clock::time_point &finishTime)
+{
+    assert(m_busy);
+    unique_lock<mutex> lock(m_mutex);
+    m_finished.wait(lock, [this]() { return m_done; });
+    m_busy = false;
+    metrics = m_metrics;
+    finishTime = m_finishTime;
+    return m_epoch;
+}
+
+void AsyncEvaluator::loop()
+{
+    Tracer::setThreadName("evaluator");
+    unique_lock<mutex> lock(m_mutex);
+    while (true)
+    {
+        m_requested.wait(lock, [this]() { return m_pending || m_stop; });
+        if (m_stop)
+        {
+            return;
+        }
+        m_net.loadState(m_state.data());
+        m_pending = false;
+        const unsigned epoch = m_epoch;
+
+        // Training goes on meanwhile
+        lock.unlock();
+        EpochMetrics metrics;
+        {
+            TraceScope trace("evaluate", epoch + 1, true);
+            metrics = evaluate();
+        }
+        lock.lock();
+
+        m_metrics = metrics;
+        m_finishTime = chrono::steady_clock::now();
+        m_done = true;
+        m_finished.notify_one();
+    }
+}
+
+EpochMetrics AsyncEvaluator::evaluate()
+{
+    const unsigned numInputs = m_net.getTopology().front(), numOutputs = m_net.getTopology().back();
+    vector<double> inputs(batchRows * numInputs), labels(batchRows * numOutputs);
+
+    // Accuracy of a split, fed forward in batches, and its summed loss if asked for
+    auto pass = [&](unsigned length, bool training, double *loss) {
+        unsigned correct = 0;
+        for (unsigned first = 0; first < length; first += batchRows)
+        {
+            const unsigned rows = min(batchRows, length - first);
+            for (unsigned r = 0; r < rows; ++r)
+            {
+                const unsigned index = training ? m_trainSamples[first + r] : first + r;
+                const vector<double> &input = training ? m_inputs.getStoredTrain(index) : m_inputs.getValid(index);
+                const vector<double> &label = training ? m_labels.getStoredTrain(index) : m_labels.getValid(index);
+                copy(input.begin(), input.end(), inputs.begin() + r * numInputs);
+                copy(label.begin(), label.end(), labels.begin() + r * numOutputs);
+            }
+            m_net.feedForward(inputs.data(), rows);
+            correct += m_net.countCorrect(labels.data());
+            if (loss)
+            {
+                *loss += m_net.getLoss(labels.data());
+            }
+        }
+        return length > 0 ? double(correct) / length : 0.0;
+    };
+
+    EpochMetrics metrics;
+    double loss = 0.0;
+    metrics.trainAccuracy = pass(m_trainSamples.size(), true, &loss);
+    metrics.trainLoss = m_trainSamples.empty() ? 0.0 : loss / m_trainSamples.size();
+    metrics.validationAccuracy = pass(m_inputs.validLength(), false, nullptr);
+    return metrics;
+}
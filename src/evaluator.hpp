@@ -0,0 +1,176 @@
+/**
+ * @file evaluator.hpp
+ * @brief Declaration of the evaluation of epochs on a background thread.
+ */
+#ifndef EVALUATOR_HPP
+#define EVALUATOR_HPP
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+#include "net.hpp"
+#include "input_data.hpp"
+#include "label_data.hpp"
+#include "metrics_log.hpp"
+
+using namespace std;
+
+/**
+ * @class AsyncEvaluator
+ * @brief Measures the loss and accuracies of a snapshot of the weights on its own thread
+ * while training goes on.
+ *
+ * start() copies the state of the network into a buffer (one memcpy, see Net::saveState())
+ * and wakes the thread, which loads it into its own network and evaluates it; training
+ * can change the weights right away. One evaluation runs at a time, its results are
+ * collected with wait() before the next one is started.
+ *
+ * The thread reads the training set in the order it was read (InputData::getStoredTrain()),
+ * so the next epoch may shuffle it meanwhile, and feeds whole batches forward. Only the
+ * given training samples are evaluated, e.g. a fixed subsample or none at all when the
+ * training metrics are taken from the training passes.
+ */
+class AsyncEvaluator
+{
+public:
+    /**
+     * @brief Number of samples fed forward at once.
+     */
+    static const unsigned batchRows = 256;
+
+private:
+    /**
+     * @brief The input data, split into training and validation sets.
+     */
+    const InputData &m_inputs;
+
+    /**
+     * @brief The labels, split into training and validation sets.
+     */
+    const LabelData &m_labels;
+
+    /**
+     * @brief Stored indices of the training samples to evaluate.
+     */
+    vector<unsigned> m_trainSamples;
+
+    /**
+     * @brief Network evaluated by the thread.
+     */
+    Net m_net;
+
+    /**
+     * @brief State of the network to evaluate next, written by start().
+     */
+    vector<double> m_state;
+
+    /**
+     * @brief Whether an evaluation was started and not yet collected (used by the training thread only).
+     */
+    bool m_busy;
+
+    /**
+     * @brief Guards the fields below.
+     */
+    mutex m_mutex;
+
+    /**
+     * @brief Signals a new state or the stop to the thread.
+     */
+    condition_variable m_requested;
+
+    /**
+     * @brief Signals a finished evaluation to wait().
+     */
+    condition_variable m_finished;
+
+    /**
+     * @brief Whether the thread has a state to load.
+     */
+    bool m_pending;
+
+    /**
+     * @brief Whether the running evaluation has finished.
+     */
+    bool m_done;
+
+    /**
+     * @brief Whether the thread should exit.
+     */
+    bool m_stop;
+
+    /**
+     * @brief Epoch of the evaluated weights (from 0).
+     */
+    unsigned m_epoch;
+
+    /**
+     * @brief Results of the finished evaluation.
+     */
+    EpochMetrics m_metrics;
+
+    /**
+     * @brief Time the evaluation finished.
+     */
+    chrono::steady_clock::time_point m_finishTime;
+
+    /**
+     * @brief The thread.
+     */
+    thread m_thread;
+
+    /**
+     * @brief Body of the thread: wait for a state, evaluate it, repeat.
+     */
+    void loop();
+
+    /**
+     * @brief Evaluate the network of the thread on the training samples and the validation set.
+     */
+    EpochMetrics evaluate();
+
+public:
+    /**
+     * @brief Constructor for the AsyncEvaluator class, starting the thread.
+     *
+     * @param net The trained network, giving the topology, activation and ensemble size.
+     * @param inputs The input data, split into training and validation sets.
+     * @param labels The labels, split into training and validation sets.
+     * @param trainSamples Stored indices of the training samples to evaluate (see InputData::getStoredTrain()),
+     * empty to leave the training loss and accuracy at 0.
+     */
+    AsyncEvaluator(const Net &net, const InputData &inputs, const LabelData &labels, const vector<unsigned> &trainSamples);
+
+    AsyncEvaluator(const AsyncEvaluator &) = delete;
+    AsyncEvaluator &operator=(const AsyncEvaluator &) = delete;
+
+    /**
+     * @brief Destructor, stopping the thread (after the running evaluation).
+     */
+    ~AsyncEvaluator();
+
+    /**
+     * @brief Start evaluating the current weights of a network (none may be running, see busy()).
+     * @param net The trained network, not a replica, without dropout.
+     * @param epoch The epoch that produced the weights.
+     */
+    void start(const Net &net, unsigned epoch);
+
+    /**
+     * @brief Whether an evaluation was started and not yet collected.
+     */
+    bool busy() const { return m_busy; }
+
+    /**
+     * @brief Wait for the running evaluation and collect its results.
+     * @param metrics Output for the loss and accuracies.
+     * @param finishTime Output for the time the evaluation finished.
+     * @return The epoch that produced the evaluated weights.
+     */
+    unsigned wait(EpochMetrics &metrics, chrono::steady_clock::time_point &finishTime);
+};
+
+#endif // EVALUATOR_HPP
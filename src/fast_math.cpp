@@ -0,0 +1,21 @@
+/**
+ * @file fast_math.cpp
+ * @brief Runtime selection between the polynomial approximations and libm.
+ */
+
+#include "fast_math.hpp"
+
+/**
+ * @brief Whether the kernels use the polynomial approximations.
+ */
+static bool useFastMath = false;
+
+void setFastMath(bool enabled)
+{
+    useFastMath = enabled;
+}
+
+bool fastMathEnabled()
+{
+    return useFastMath;
+}
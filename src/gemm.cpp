@@ -0,0 +1,288 @@
+/**
+ * @file gemm.cpp
+ * @brief Implementation of the cache-blocked matrix multiplication.
+ */
+
+#include "gemm.hpp"
+#include <vector>
+#include <algorithm>
+
+#if defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+/**
+ * @brief Element of op(X) of a row-major matrix.
+ */
+static inline double element(const double *x, unsigned ld, bool trans, unsigned row, unsigned col)
+{
+    return trans ? x[col * ld + row] : x[row * ld + col];
+}
+
+/**
+ * @brief Pack an `mc x kc` block of op(A) into strips of GEMM_MR rows, zero-padded.
+ *
+ * Strip `s` holds, for each `p`, the GEMM_MR values `op(A)(s * GEMM_MR + r, p)`.
+ */
+static void packA(const double *a, unsigned lda, bool trans, unsigned mc, unsigned kc, double *packed)
+{
+    for (unsigned i0 = 0; i0 < mc; i0 += GEMM_MR)
+    {
+        const unsigned rows = min(GEMM_MR, mc - i0);
+        for (unsigned p = 0; p < kc; ++p)
+        {
+            for (unsigned r = 0; r < rows; ++r)
+            {
+                packed[p * GEMM_MR + r] = element(a, lda, trans, i0 + r, p);
+            }
+            for (unsigned r = rows; r < GEMM_MR; ++r)
+            {
+                packed[p * GEMM_MR + r] = 0.0;
+            }
+        }
+        packed += kc * GEMM_MR;
+    }
+}
+
+/**
+ * @brief Pack a `kc x nc` panel of op(B) into strips of GEMM_NR columns, zero-padded.
+ *
+ * Strip `s` holds, for each `p`, the GEMM_NR values `op(B)(p, s * GEMM_NR + c)`.
+ */
+static void packB(const double *b, unsigned ldb, bool trans, unsigned kc, unsigned nc, double *packed)
+{
+    for (unsigned j0 = 0; j0 < nc; j0 += GEMM_NR)
+    {
+        const unsigned cols = min(GEMM_NR, nc - j0);
+        for (unsigned p = 0; p < kc; ++p)
+        {
+            double *dst = packed + p * GEMM_NR;
+            if (!trans && cols == GEMM_NR)
+            {
+                copy(b + p * ldb + j0, b + p * ldb + j0 + GEMM_NR, dst);
+                continue;
+            }
+            for (unsigned c = 0; c < cols; ++c)
+            {
+                dst[c] = element(b, ldb, trans, p, j0 + c);
+            }
+            for (unsigned c = cols; c < GEMM_NR; ++c)
+            {
+                dst[c] = 0.0;
+            }
+        }
+        packed += kc * GEMM_NR;
+    }
+}
+
+/**
+ * @brief Compute a GEMM_MR x GEMM_NR block of C from packed strips of A and B.
+ *
+ * With AVX-512 the accumulators live in 12 registers, each step of the inner loop loads
+ * one vector pair of B and broadcasts GEMM_MR values of A.
+ *
+ * @param kc Depth of the strips.
+ * @param a Packed strip of A.
+ * @param b Packed strip of B.
+ * @param beta Scale of the original C.
+ * @param c Top left element of the block of C.
+ * @param ldc Distance between rows of C.
+ * @param rows Rows of the block inside C (at most GEMM_MR).
+ * @param cols Columns of the block inside C (at most GEMM_NR).
+ */
+static inline void microKernel(unsigned kc, const double *__restrict a, const double *__restrict b,
+                               double beta, double *__restrict c, unsigned ldc, unsigned rows, unsigned cols)
+{
+    alignas(64) double acc[GEMM_MR][GEMM_NR];
+
+#if defined(__AVX512F__)
+    __m512d c00 = _mm512_setzero_pd(), c01 = _mm512_setzero_pd();
+    __m512d c10 = _mm512_setzero_pd(), c11 = _mm512_setzero_pd();
+    __m512d c20 = _mm512_setzero_pd(), c21 = _mm512_setzero_pd();
+    __m512d c30 = _mm512_setzero_pd(), c31 = _mm512_setzero_pd();
+    __m512d c40 = _mm512_setzero_pd(), c41 = _mm512_setzero_pd();
+    __m512d c50 = _mm512_setzero_pd(), c51 = _mm512_setzero_pd();
+
+    for (unsigned p = 0; p < kc; ++p)
+    {
+        const __m512d b0 = _mm512_loadu_pd(b + p * GEMM_NR);
+        const __m512d b1 = _mm512_loadu_pd(b + p * GEMM_NR + 8);
+        const double *ap = a + p * GEMM_MR;
+        __m512d ar = _mm512_set1_pd(ap[0]);
+        c00 = _mm512_fmadd_pd(ar, b0, c00);
+        c01 = _mm512_fmadd_pd(ar, b1, c01);
+        ar = _mm512_set1_pd(ap[1]);
+        c10 = _mm512_fmadd_pd(ar, b0, c10);
+        c11 = _mm512_fmadd_pd(ar, b1, c11);
+        ar = _mm512_set1_pd(ap[2]);
+        c20 = _mm512_fmadd_pd(ar, b0, c20);
+        c21 = _mm512_fmadd_pd(ar, b1, c21);
+        ar = _mm512_set1_pd(ap[3]);
+        c30 = _mm512_fmadd_pd(ar, b0, c30);
+        c31 = _mm512_fmadd_pd(ar, b1, c31);
+        ar = _mm512_set1_pd(ap[4]);
+        c40 = _mm512_fmadd_pd(ar, b0, c40);
+        c41 = _mm512_fmadd_pd(ar, b1, c41);
+        ar = _mm512_set1_pd(ap[5]);
+        c50 = _mm512_fmadd_pd(ar, b0, c50);
+        c51 = _mm512_fmadd_pd(ar, b1, c51);
+    }
+
+    _mm512_store_pd(acc[0], c00);
+    _mm512_store_pd(acc[0] + 8, c01);
+    _mm512_store_pd(acc[1], c10);
+    _mm512_store_pd(acc[1] + 8, c11);
+    _mm512_store_pd(acc[2], c20);
+    _mm512_store_pd(acc[2] + 8, c21);
+    _mm512_store_pd(acc[3], c30);
+    _mm512_store_pd(acc[3] + 8, c31);
+    _mm512_store_pd(acc[4], c40);
+    _mm512_store_pd(acc[4] + 8, c41);
+    _mm512_store_pd(acc[5], c50);
+    _mm512_store_pd(acc[5] + 8, c51);
+#else
+    fill(&acc[0][0], &acc[0][0] + GEMM_MR * GEMM_NR, 0.0);
+    for (unsigned p = 0; p < kc; ++p)
+    {
+        const double *bp = b + p * GEMM_NR;
+        const double *ap = a + p * GEMM_MR;
+        for (unsigned r = 0; r < GEMM_MR; ++r)
+        {
+            for (unsigned j = 0; j < GEMM_NR; ++j)
+            {
+                acc[r][j] += ap[r] * bp[j];
+            }
+        }
+    }
+#endif
+
+    for (unsigned r = 0; r < rows; ++r)
+    {
+        double *cr = c + r * ldc;
+        if (beta == 0.0)
+        {
+            for (unsigned j = 0; j < cols; ++j)
+            {
+                cr[j] = acc[r][j];
+            }
+        }
+        else
+        {
+            for (unsigned j = 0; j < cols; ++j)
+            {
+                cr[j] = beta * cr[j] + acc[r][j];
+            }
+        }
+    }
+}
+
+/**
+ * @brief Direct multiplication for products too small to amortize packing.
+ */
+static void smallGemm(bool transA, bool transB, unsigned m, unsigned n, unsigned k,
+                      const double *a, unsigned lda, const double *b, unsigned ldb,
+                      double beta, double *c, unsigned ldc)
+{
+    for (unsigned i = 0; i < m; ++i)
+    {
+        double *ci = c + i * ldc;
+        if (beta == 0.0)
+        {
+            fill(ci, ci + n, 0.0);
+        }
+        else if (beta != 1.0)
+        {
+            for (unsigned j = 0; j < n; ++j)
+            {
+                ci[j] *= beta;
+            }
+        }
+
+        if (transB)
+        {
+            // Rows of B are contiguous: one dot product per element of C
+            for (unsigned j = 0; j < n; ++j)
+            {
+                const double *bj = b + j * ldb;
+                double sum = 0.0;
+                if (!transA)
+                {
+                    const double *ai = a + i * lda;
+                    for (unsigned p = 0; p < k; ++p)
+                    {
+                        sum += ai[p] * bj[p];
+                    }
+                }
+                else
+                {
+                    for (unsigned p = 0; p < k; ++p)
+                    {
+                        sum += a[p * lda + i] * bj[p];
+                    }
+                }
+                ci[j] += sum;
+            }
+        }
+        else
+        {
+            // Rows of B are contiguous: accumulate scaled rows of B into the row of C
+            for (unsigned p = 0; p < k; ++p)
+            {
+                const double aip = element(a, lda, transA, i, p);
+                const double *bp = b + p * ldb;
+                for (unsigned j = 0; j < n; ++j)
+                {
+                    ci[j] += aip * bp[j];
+                }
+            }
+        }
+    }
+}
+
+void gemm(bool transA, bool transB, unsigned m, unsigned n, unsigned k,
+          const double *a, unsigned lda, const double *b, unsigned ldb,
+          double beta, double *c, unsigned ldc)
+{
+    if (m < GEMM_MR || k < 4)
+    {
+        smallGemm(transA, transB, m, n, k, a, lda, b, ldb, beta, c, ldc);
+        return;
+    }
+
+    static thread_local vector<double> packedA, packedB;
+    packedA.resize(GEMM_MC * GEMM_KC);
+    packedB.resize(GEMM_KC * ((min(n, GEMM_NC) + GEMM_NR - 1) / GEMM_NR) * GEMM_NR);
+
+    for (unsigned j0 = 0; j0 < n; j0 += GEMM_NC)
+    {
+        const unsigned nc = min(GEMM_NC, n - j0);
+
+        for (unsigned p0 = 0; p0 < k; p0 += GEMM_KC)
+        {
+            const unsigned kc = min(GEMM_KC, k - p0);
+            // Only the first block of the inner dimension scales the original C
+            const double blockBeta = p0 == 0 ? beta : 1.0;
+
+            const double *bBlock = transB ? b + j0 * ldb + p0 : b + p0 * ldb + j0;
+            packB(bBlock, ldb, transB, kc, nc, packedB.data());
+
+            for (unsigned i0 = 0; i0 < m; i0 += GEMM_MC)
+            {
+                const unsigned mc = min(GEMM_MC, m - i0);
+                const double *aBlock = transA ? a + p0 * lda + i0 : a + i0 * lda + p0;
+                packA(aBlock, lda, transA, mc, kc, packedA.data());
+
+                for (unsigned jr = 0; jr < nc; jr += GEMM_NR)
+                {
+                    const double *bStrip = packedB.data() + (jr / GEMM_NR) * kc * GEMM_NR;
+                    for (unsigned ir = 0; ir < mc; ir += GEMM_MR)
+                    {
+                        const double *aStrip = packedA.data() + (ir / GEMM_MR) * kc * GEMM_MR;
+                        microKernel(kc, aStrip, bStrip, blockBeta, c + (i0 + ir) * ldc + j0 + jr, ldc,
+                                    min(GEMM_MR, mc - ir), min(GEMM_NR, nc - jr));
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,62 @@
+/**
+ * @file gemm.hpp
+ * @brief Declaration of the cache-blocked matrix multiplication used by the dense layers.
+ */
+#ifndef GEMM_HPP
+#define GEMM_HPP
+
+using namespace std;
+
+/**
+ * @brief Rows of C computed by one call of the microkernel.
+ */
+const unsigned GEMM_MR = 6;
+
+/**
+ * @brief Columns of C computed by one call of the microkernel (two AVX-512 vectors of doubles).
+ */
+const unsigned GEMM_NR = 16;
+
+/**
+ * @brief Depth of the packed panels, chosen so a packed strip of B stays in L1.
+ */
+const unsigned GEMM_KC = 256;
+
+/**
+ * @brief Rows of the packed block of A, chosen so it stays in L2.
+ */
+const unsigned GEMM_MC = 96;
+
+/**
+ * @brief Columns of the packed panel of B.
+ */
+const unsigned GEMM_NC = 2048;
+
+/**
+ * @brief Matrix multiplication `C = op(A) * op(B) + beta * C` on row-major matrices.
+ *
+ * `op(X)` is `X` or its transpose. Panels of op(B) and blocks of op(A) are packed into
+ * contiguous strips of GEMM_NR columns and GEMM_MR rows, blocked for L1 and L2, and a
+ * register-tiled microkernel computes GEMM_MR x GEMM_NR blocks of C from them.
+ * Products too small to amortize the packing (fewer than GEMM_MR rows or a depth of a
+ * few values, e.g. a single sample) are computed directly. Packing buffers are
+ * thread-local, so calls from different threads are independent.
+ *
+ * @param transA Whether A is transposed, op(A) is `m x k` in both cases.
+ * @param transB Whether B is transposed, op(B) is `k x n` in both cases.
+ * @param m Number of rows of C.
+ * @param n Number of columns of C.
+ * @param k Inner dimension.
+ * @param a Matrix A.
+ * @param lda Distance between rows of A.
+ * @param b Matrix B.
+ * @param ldb Distance between rows of B.
+ * @param beta Scale of the original C, 0 overwrites C (which may then be uninitialized).
+ * @param c Matrix C.
+ * @param ldc Distance between rows of C.
+ */
+void gemm(bool transA, bool transB, unsigned m, unsigned n, unsigned k,
+          const double *a, unsigned lda, const double *b, unsigned ldb,
+          double beta, double *c, unsigned ldc);
+
+#endif // GEMM_HPP
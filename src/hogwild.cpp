@@ -0,0 +1,249 @@
+/**
+ * @file hogwild.cpp
+ * @brief Implementation of lock-free asynchronous (Hogwild) training.
+ */
+
+#include "hogwild.hpp"
+#include "random.hpp"
+#include "tracer.hpp"
+#include <thread>
+#include <numeric>
+#include <random>
+
+HogwildTrainer::HogwildTrainer(Net &net, const InputData &inputs, const LabelData &labels, unsigned batchSize,
+                               unsigned threads, unsigned seed, NumaPlacement placement) :
+    m_net(net),
+    m_inputs(inputs),
+    m_labels(labels),
+    m_batchSize(batchSize),
+    m_threads(threads),
+    m_seed(seed),
+    m_placement(placement),
+    m_replicas(threads)
+{
+    // Replicas need the master's buffers to be final before they share its arena
+    m_net.reserveRows(batchSize);
+
+    if (m_placement == NumaPlacement::None)
+    {
+        for (unsigned worker = 0; worker + 1 < threads; ++worker)
+        {
+            m_replicas[worker] = make_unique<Net>(m_net);
+        }
+        return;
+    }
+
+    // Memory is placed on the node of the thread touching it first, so every worker
+    // allocates its own state on its own CPU
+    const unsigned nodes = min(m_topology.nodes(), threads);
+    if (m_placement == NumaPlacement::Replicated)
+    {
+        vector<double> state(m_net.stateSize());
+        m_net.saveState(state.data());
+        m_nodeNets.resize(nodes);
+
+        vector<thread> creators;
+        for (unsigned node = 0; node < nodes; ++node)
+        {
+            // Worker `node` is the first worker of the node
+            creators.emplace_back([this, &state, node]() {
+                placeWorker(node);
+                m_nodeNets[node] = make_unique<Net>(m_net.getTopology(), m_seed, m_net.getActivation(),
+                                                    m_net.arena().hugePages(), m_net.getMembers());
+                m_nodeNets[node]->setLearningRate(m_net.getLearningRate());
+                m_nodeNets[node]->setOptimizer(m_net.getOptimizer());
+                m_nodeNets[node]->reserveRows(m_batchSize);
+                m_nodeNets[node]->loadState(state.data());
+            });
+        }
+        for (thread &creator : creators)
+        {
+            creator.join();
+        }
+    }
+
+    const unsigned numInputs = m_net.getTopology().front(), numOutputs = m_net.getTopology().back();
+    m_shardInputs.resize(threads);
+    m_shardLabels.resize(threads);
+
+    vector<thread> creators;
+    for (unsigned worker = 0; worker < threads; ++worker)
+    {
+        creators.emplace_back([this, worker, numInputs, numOutputs]() {
+            placeWorker(worker);
+            Net &master = m_nodeNets.empty() ? m_net : *m_nodeNets[m_topology.workerNode(worker)];
+            m_replicas[worker] = make_unique<Net>(master);
+
+            const unsigned first = worker * m_inputs.trainLength() / m_threads;
+            const unsigned last = (worker + 1) * m_inputs.trainLength() / m_threads;
+            vector<double> &shardInputs = m_shardInputs[worker], &shardLabels = m_shardLabels[worker];
+            shardInputs.resize((last - first) * numInputs);
+            shardLabels.resize((last - first) * numOutputs);
+            for (unsigned i = first; i < last; ++i)
+            {
+                const vector<double> &input = m_inputs.getTrain(i);
+                const vector<double> &label = m_labels.getTrain(i);
+                copy(input.begin(), input.end(), shardInputs.begin() + (i - first) * numInputs);
+                copy(label.begin(), label.end(), shardLabels.begin() + (i - first) * numOutputs);
+            }
+        });
+    }
+    for (thread &creator : creators)
+    {
+        creator.join();
+    }
+}
+
+void HogwildTrainer::placeWorker(unsigned worker) const
+{
+    if (m_placement != NumaPlacement::None)
+    {
+        pinThread(m_topology.workerCpu(worker));
+    }
+}
+
+void HogwildTrainer::trainShared(Net &workerNet, atomic<unsigned> &nextBatch) const
+{
+    const unsigned numInputs = m_net.getTopology().front(), numOutputs = m_net.getTopology().back();
+    const unsigned numBatches = m_inputs.trainLength() / m_batchSize;
+    vector<double> batchInputs(m_batchSize * numInputs), batchLabels(m_batchSize * numOutputs);
+
+    for (unsigned batch = nextBatch++; batch < numBatches; batch = nextBatch++)
+    {
+        for (unsigned i = 0; i < m_batchSize; ++i)
+        {
+            const vector<double> &input = m_inputs.getTrain(batch * m_batchSize + i);
+            const vector<double> &label = m_labels.getTrain(batch * m_batchSize + i);
+            copy(input.begin(), input.end(), batchInputs.begin() + i * numInputs);
+            copy(label.begin(), label.end(), batchLabels.begin() + i * numOutputs);
+        }
+
+        workerNet.resetGradientSum();
+        workerNet.feedForward(batchInputs.data(), m_batchSize);
+        workerNet.backProp(batchLabels.data());
+        workerNet.calcAvgGradient(m_batchSize);
+        workerNet.updateWeights();
+    }
+}
+
+void HogwildTrainer::trainShard(unsigned worker, unsigned epoch)
+{
+    const unsigned numInputs = m_net.getTopology().front(), numOutputs = m_net.getTopology().back();
+    const vector<double> &shardInputs = m_shardInputs[worker], &shardLabels = m_shardLabels[worker];
+    const unsigned samples = shardInputs.size() / numInputs;
+    Net &workerNet = *m_replicas[worker];
+
+    // Every worker shuffles its own shard
+    vector<unsigned> order(samples);
+    iota(order.begin(), order.end(), 0);
+    mt19937 generator(m_seed + epoch * m_threads + worker);
+    shuffle(order.begin(), order.end(), generator);
+
+    vector<double> batchInputs(m_batchSize * numInputs), batchLabels(m_batchSize * numOutputs);
+    for (unsigned batch = 0; batch < samples / m_batchSize; ++batch)
+    {
+        for (unsigned i = 0; i < m_batchSize; ++i)
+        {
+            const unsigned sample = order[batch * m_batchSize + i];
+            copy(shardInputs.begin() + sample * numInputs, shardInputs.begin() + (sample + 1) * numInputs,
+                 batchInputs.begin() + i * numInputs);
+            copy(shardLabels.begin() + sample * numOutputs, shardLabels.begin() + (sample + 1) * numOutputs,
+                 batchLabels.begin() + i * numOutputs);
+        }
+
+        workerNet.resetGradientSum();
+        workerNet.feedForward(batchInputs.data(), m_batchSize);
+        workerNet.backProp(batchLabels.data());
+        workerNet.calcAvgGradient(m_batchSize);
+        workerNet.updateWeights();
+    }
+}
+
+void HogwildTrainer::trainEpoch(unsigned epoch)
+{
+    // The replicas train with the dropout and learning rate currently set on the network
+    const unsigned numLayers = m_net.getTopology().size();
+    for (unique_ptr<Net> &replica : m_replicas)
+    {
+        if (replica)
+        {
+            for (unsigned layerNum = 0; layerNum < numLayers; ++layerNum)
+            {
+                replica->setDropout(layerNum, m_net.getDropout(layerNum));
+            }
+            replica->setLearningRate(m_net.getLearningRate());
+        }
+    }
+    for (unique_ptr<Net> &nodeNet : m_nodeNets)
+    {
+        nodeNet->setLearningRate(m_net.getLearningRate());
+    }
+
+    // Every epoch gets different dropout streams, stream 0 is the main thread's own
+    const unsigned firstStream = 1 + epoch * m_threads;
+
+    if (m_placement == NumaPlacement::None)
+    {
+        atomic<unsigned> nextBatch(0);
+        auto work = [&](Net &workerNet, unsigned worker) {
+            seedThreadGenerator(m_seed, firstStream + worker);
+            if (worker + 1 < m_threads)
+            {
+                Tracer::setThreadName("hogwild worker " + to_string(worker));
+            }
+            trainShared(workerNet, nextBatch);
+        };
+
+        vector<thread> workers;
+        for (unsigned worker = 0; worker + 1 < m_threads; ++worker)
+        {
+            workers.emplace_back(work, ref(*m_replicas[worker]), worker);
+        }
+        work(m_net, m_threads - 1);
+
+        for (thread &worker : workers)
+        {
+            worker.join();
+        }
+        return;
+    }
+
+    vector<thread> workers;
+    for (unsigned worker = 0; worker < m_threads; ++worker)
+    {
+        workers.emplace_back([this, worker, epoch, firstStream]() {
+            placeWorker(worker);
+            seedThreadGenerator(m_seed, firstStream + worker);
+            Tracer::setThreadName("hogwild worker " + to_string(worker));
+            trainShard(worker, epoch);
+        });
+    }
+    for (thread &worker : workers)
+    {
+        worker.join();
+    }
+
+    // Average the node copies into the network, and start the next epoch from the average
+    if (!m_nodeNets.empty())
+    {
+        const size_t stateSize = m_net.stateSize();
+        vector<double> sum(stateSize, 0.0), state(stateSize);
+        for (unique_ptr<Net> &nodeNet : m_nodeNets)
+        {
+            nodeNet->saveState(state.data());
+            for (size_t i = 0; i < stateSize; ++i)
+            {
+                sum[i] += state[i];
+            }
+        }
+        for (size_t i = 0; i < stateSize; ++i)
+        {
+            sum[i] /= m_nodeNets.size();
+        }
+        m_net.loadState(sum.data());
+        for (unique_ptr<Net> &nodeNet : m_nodeNets)
+        {
+            nodeNet->loadState(sum.data());
+        }
+    }
+}
@@ -0,0 +1,149 @@
+/**
+ * @file hogwild.hpp
+ * @brief Declaration of lock-free asynchronous (Hogwild) training.
+ */
+#ifndef HOGWILD_HPP
+#define HOGWILD_HPP
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include "net.hpp"
+#include "numa.hpp"
+#include "input_data.hpp"
+#include "label_data.hpp"
+
+using namespace std;
+
+/**
+ * @class HogwildTrainer
+ * @brief Trains a network with Hogwild asynchronous SGD, one epoch at a time.
+ *
+ * Each worker thread trains a replica of the network sharing its weights and RMSprop
+ * state (see Net::Net(Net &)). Workers compute their gradients independently and apply
+ * the updates to the shared weights without any locking or barrier, so updates of
+ * different workers may interleave or overwrite each other. On x86-64 aligned doubles are
+ * read and written as a whole, so no torn values can be observed; the races only make the
+ * updates approximate, which SGD tolerates for sparse-ish inputs.
+ *
+ * Without NUMA placement, workers take mini-batches of the shuffled training set from a
+ * shared counter and the last worker runs on the calling thread. With NumaPlacement::Local
+ * every worker is pinned to a CPU (spread over the nodes round robin) and allocates its
+ * replica's buffers and a copy of its fixed shard of the training set itself, so the
+ * kernel places them on the worker's node; a worker shuffles only its own shard. With
+ * NumaPlacement::Replicated, the workers of each node also share a node-local copy of the
+ * weights instead of the network's, and the copies are averaged into the network after
+ * every epoch.
+ */
+class HogwildTrainer
+{
+private:
+    /**
+     * @brief The network, owning the shared parameters.
+     */
+    Net &m_net;
+
+    /**
+     * @brief The input data, split into training and validation sets.
+     */
+    const InputData &m_inputs;
+
+    /**
+     * @brief The labels, split into training and validation sets.
+     */
+    const LabelData &m_labels;
+
+    /**
+     * @brief Size of the mini-batches.
+     */
+    unsigned m_batchSize;
+
+    /**
+     * @brief Number of worker threads.
+     */
+    unsigned m_threads;
+
+    /**
+     * @brief Seed of the dropout generators and shard shuffles of the workers.
+     */
+    unsigned m_seed;
+
+    /**
+     * @brief Placement of the workers and their memory.
+     */
+    NumaPlacement m_placement;
+
+    /**
+     * @brief CPUs of the NUMA nodes.
+     */
+    NumaTopology m_topology;
+
+    /**
+     * @brief Copy of the weights of each node (NumaPlacement::Replicated only).
+     */
+    vector<unique_ptr<Net>> m_nodeNets;
+
+    /**
+     * @brief Network of each worker; without placement the last worker trains the network itself.
+     */
+    vector<unique_ptr<Net>> m_replicas;
+
+    /**
+     * @brief Inputs of the training shard of each worker, one row per sample (with placement only).
+     */
+    vector<vector<double>> m_shardInputs;
+
+    /**
+     * @brief Labels of the training shard of each worker, one row per sample (with placement only).
+     */
+    vector<vector<double>> m_shardLabels;
+
+    /**
+     * @brief Pin the calling thread to the CPU of a worker (with placement only).
+     * @param worker Index of the worker.
+     */
+    void placeWorker(unsigned worker) const;
+
+    /**
+     * @brief Train a worker on the batches of the shared counter (without placement).
+     * @param workerNet Network of the worker.
+     * @param nextBatch Index of the next batch of the shuffled training set to train on.
+     */
+    void trainShared(Net &workerNet, atomic<unsigned> &nextBatch) const;
+
+    /**
+     * @brief Train a worker on its own shard for one epoch (with placement).
+     * @param worker Index of the worker.
+     * @param epoch Index of the epoch.
+     */
+    void trainShard(unsigned worker, unsigned epoch);
+
+public:
+    /**
+     * @brief Constructor for the HogwildTrainer class, creating the worker replicas.
+     *
+     * With placement, the shards are taken from the training set in its current order.
+     * The network must not reserve more rows while the trainer exists.
+     *
+     * @param net The network, owning the shared parameters.
+     * @param inputs The input data, split into training and validation sets.
+     * @param labels The labels, split into training and validation sets.
+     * @param batchSize Size of the mini-batches.
+     * @param threads Number of worker threads.
+     * @param seed Seed of the dropout generators and shard shuffles of the workers.
+     * @param placement Placement of the workers and their memory.
+     */
+    HogwildTrainer(Net &net, const InputData &inputs, const LabelData &labels, unsigned batchSize,
+                   unsigned threads, unsigned seed, NumaPlacement placement = NumaPlacement::None);
+
+    /**
+     * @brief Train the network for one epoch.
+     *
+     * The workers use the dropout probabilities currently set on the network.
+     *
+     * @param epoch Index of the epoch, so every epoch uses different dropout streams and shuffles.
+     */
+    void trainEpoch(unsigned epoch);
+};
+
+#endif // HOGWILD_HPP
@@ -4,6 +4,9 @@
  */
 
 #include "input_data.hpp"
+#include "profiler.hpp"
+#include "tracer.hpp"
+#include <numeric>
 
 InputData::InputData(const string filepath, const double divisor, const unsigned batchSize) :
         m_filepath{filepath},
@@ -19,6 +22,8 @@ InputData::InputData(const string filepath, const double divisor, const unsigned
 
 void InputData::readData()
 {
+    PROFILE_SCOPE(Load);
+    TraceScope trace("load data");
     ifstream file(m_filepath.c_str());
     if(!file.is_open())
     {
@@ -52,11 +57,14 @@ void InputData::splitData(double percentage)
     // Split the data into training and validation sets
     m_trainingData.assign(m_data.begin(), m_data.begin() + splitIndex);
     m_validationData.assign(m_data.begin() + splitIndex, m_data.end());
+    m_order.resize(m_trainingData.size());
+    iota(m_order.begin(), m_order.end(), 0u);
 }
 
 void InputData::shuffleData(unsigned seed)
 {
-    shuffle(m_trainingData.begin(), m_trainingData.end(), default_random_engine(seed));
+    // Same permutation as shuffling the data itself
+    shuffle(m_order.begin(), m_order.end(), default_random_engine(seed));
 }
 
 vector<double> &InputData::getNext()
@@ -80,7 +88,7 @@ vector<double> &InputData::getNextTrain()
         m_actIndexTrain = 0;
     }
 
-    return m_trainingData[idx_to_ret];
+    return m_trainingData[m_order[idx_to_ret]];
 }
 
 vector<double> &InputData::getNextValid()
@@ -2,6 +2,9 @@
  * @file input_data.hpp
  * @brief Declaration of the InputData class and its methods.
  */
+#ifndef INPUT_DATA_HPP
+#define INPUT_DATA_HPP
+
 #include <vector>
 #include <cstdlib>
 #include <iostream>
@@ -69,6 +72,36 @@ public:
      */
     vector<double> &getNextValid();
 
+    /**
+     * @brief Get a data input of the training set by its index, without moving the internal indices.
+     *
+     * Safe to call from several threads at once.
+     *
+     * @param index Index of the data input in the (shuffled) training set.
+     * @return A reference to the data input.
+     */
+    const vector<double> &getTrain(unsigned index) const { return m_trainingData[m_order[index]]; }
+
+    /**
+     * @brief Get a data input of the training set in the order it was read, unaffected by shuffleData().
+     *
+     * Safe to call while another thread shuffles or reads the training set.
+     *
+     * @param index Index of the data input in the training set as read.
+     * @return A reference to the data input.
+     */
+    const vector<double> &getStoredTrain(unsigned index) const { return m_trainingData[index]; }
+
+    /**
+     * @brief Get a data input of the validation set by its index, without moving the internal indices.
+     *
+     * Safe to call from several threads at once.
+     *
+     * @param index Index of the data input in the validation set.
+     * @return A reference to the data input.
+     */
+    const vector<double> &getValid(unsigned index) const { return m_validationData[index]; }
+
     /**
      * @brief Retrieves the batch size for the next training batch.
      *
@@ -86,21 +119,21 @@ public:
      * 
      * @return The total number of data inputs in the dataset.
      */
-    inline unsigned length() { return m_data.size(); }
+    inline unsigned length() const { return m_data.size(); }
 
     /**
      * @brief Gets the number of data inputs in the training set.
      * 
      * @return The number of data inputs in the training set.
      */
-    inline unsigned validLength() { return m_validationData.size(); };
+    inline unsigned validLength() const { return m_validationData.size(); };
 
     /**
      * @brief Gets the number of data inputs in the validation set.
      * 
      * @return The number of data inputs in the validation set.
      */
-    inline unsigned trainLength() { return m_trainingData.size(); }
+    inline unsigned trainLength() const { return m_trainingData.size(); }
 
 private:
     /**
@@ -153,6 +186,12 @@ private:
      */
     vector<vector<double>> m_trainingData;
 
+    /**
+     * @brief Order of the training set: shuffleData() permutes it instead of the data, so the
+     * stored inputs never move (see getStoredTrain()).
+     */
+    vector<unsigned> m_order;
+
     /**
      * @brief Matrix containing input data for validation.
      */
@@ -163,3 +202,5 @@ private:
      */
     vector<vector<double>> m_batch;
 };
+
+#endif // INPUT_DATA_HPP
@@ -0,0 +1,99 @@
+/**
+ * @file kernels.cpp
+ * @brief Implementation of the numeric kernels shared by the network implementations.
+ */
+
+#include "kernels.hpp"
+#include "fast_math.hpp"
+
+double softmax(const double *potentials, double *probabilities, unsigned n)
+{
+    double maxPotential = potentials[0];
+    for (unsigned i = 1; i < n; ++i)
+    {
+        maxPotential = max(maxPotential, potentials[i]);
+    }
+
+    // Separate loops so the exponentials and the reductions vectorize
+    const bool fast = fastMathEnabled();
+    if (fast)
+    {
+        for (unsigned i = 0; i < n; ++i)
+        {
+            probabilities[i] = fastExp(potentials[i] - maxPotential);
+        }
+    }
+    else
+    {
+        for (unsigned i = 0; i < n; ++i)
+        {
+            probabilities[i] = exp(potentials[i] - maxPotential);
+        }
+    }
+
+    double expSum = 0.0;
+    for (unsigned i = 0; i < n; ++i)
+    {
+        expSum += probabilities[i];
+    }
+
+    const double invSum = 1.0 / expSum;
+    for (unsigned i = 0; i < n; ++i)
+    {
+        probabilities[i] *= invSum;
+    }
+
+    return maxPotential + (fast ? fastLog(expSum) : log(expSum));
+}
+
+double crossEntropy(const double *potentials, const double *probabilities, double logSumExp,
+                    const double *targets, double *gradients, unsigned n)
+{
+    double loss = 0.0;
+    if (gradients)
+    {
+        for (unsigned i = 0; i < n; ++i)
+        {
+            loss += targets[i] * (logSumExp - potentials[i]);
+            gradients[i] = probabilities[i] - targets[i];
+        }
+    }
+    else
+    {
+        for (unsigned i = 0; i < n; ++i)
+        {
+            loss += targets[i] * (logSumExp - potentials[i]);
+        }
+    }
+    return loss;
+}
+
+void rmsprop(double *values, double *deltas, const double *gradients, unsigned n,
+             double eta, double decay, double epsilon)
+{
+    if (fastMathEnabled())
+    {
+        for (unsigned i = 0; i < n; ++i)
+        {
+            double gradient = gradients[i];
+            deltas[i] = decay * deltas[i] + (1 - decay) * gradient * gradient;
+            values[i] += -(eta / (fastSqrt(deltas[i]) + epsilon)) * gradient;
+        }
+        return;
+    }
+
+    for (unsigned i = 0; i < n; ++i)
+    {
+        double gradient = gradients[i];
+        deltas[i] = decay * deltas[i] + (1 - decay) * gradient * gradient;
+        values[i] += -(eta / (sqrt(deltas[i]) + epsilon)) * gradient;
+    }
+}
+
+void sgd(double *values, const double *gradients, unsigned n, double eta)
+{
+    for (unsigned i = 0; i < n; ++i)
+    {
+        values[i] -= eta * gradients[i];
+    }
+}
@@ -0,0 +1,72 @@
+/**
+ * @file kernels.hpp
+ * @brief Declaration of the numeric kernels shared by the network implementations.
+ */
+#ifndef KERNELS_HPP
+#define KERNELS_HPP
+
+#include <cmath>
+#include <algorithm>
+
+using namespace std;
+
+/**
+ * @brief Numerically stable softmax.
+ *
+ * Subtracts the maximum potential before exponentiating, so large potentials cannot
+ * overflow. Computes exactly one exponential per element, using fastExp() and fastLog()
+ * when selected by setFastMath().
+ *
+ * @param potentials Inner potentials of the output neurons.
+ * @param probabilities Output array for the softmax probabilities.
+ * @param n Number of output neurons.
+ * @return The log-sum-exp of the potentials, used by crossEntropy() to avoid any further log/exp.
+ */
+double softmax(const double *potentials, double *probabilities, unsigned n);
+
+/**
+ * @brief Categorical cross-entropy of a softmax output and its gradient in one pass.
+ *
+ * Uses `-log(p_i) = logSumExp - z_i`, so no transcendental function is evaluated and
+ * the loss stays finite even for probabilities that underflow to zero.
+ *
+ * @param potentials Inner potentials of the output neurons.
+ * @param probabilities Softmax probabilities computed by softmax().
+ * @param logSumExp Value returned by softmax() for the same potentials.
+ * @param targets Target values for the output neurons.
+ * @param gradients Output array for the gradients with respect to the potentials
+ * (`probabilities - targets`), or nullptr if only the loss is needed.
+ * @param n Number of output neurons.
+ * @return The loss value.
+ */
+double crossEntropy(const double *potentials, const double *probabilities, double logSumExp,
+                    const double *targets, double *gradients, unsigned n);
+
+/**
+ * @brief RMSprop update of a parameter array.
+ *
+ * With setFastMath() enabled, the square root of `eta / (sqrt(delta) + epsilon)` is
+ * computed by fastSqrt() (same rule, relative error of the step below 3.2e-11).
+ *
+ * @param values Parameters to update.
+ * @param deltas Moving averages of the squared gradients.
+ * @param gradients Averaged gradients of the parameters.
+ * @param n Number of parameters.
+ * @param eta Learning rate.
+ * @param decay Decay factor of the moving averages.
+ * @param epsilon Small constant used to prevent division by zero.
+ */
+void rmsprop(double *values, double *deltas, const double *gradients, unsigned n,
+             double eta, double decay, double epsilon);
+
+/**
+ * @brief Plain gradient descent update of a parameter array.
+ *
+ * @param values Parameters to update.
+ * @param gradients Averaged gradients of the parameters.
+ * @param n Number of parameters.
+ * @param eta Learning rate.
+ */
+void sgd(double *values, const double *gradients, unsigned n, double eta);
+
+#endif // KERNELS_HPP
@@ -4,6 +4,9 @@
  */
 
 #include "label_data.hpp"
+#include "profiler.hpp"
+#include "tracer.hpp"
+#include <numeric>
 
 LabelData::LabelData(const string filepath, unsigned categories, bool onehot_encoded) :
     m_filepath{filepath},
@@ -18,6 +21,8 @@ LabelData::LabelData(const string filepath, unsigned categories, bool onehot_enc
 
 void LabelData::readData()
 {
+    PROFILE_SCOPE(Load);
+    TraceScope trace("load data");
     ifstream file(m_filepath.c_str());
     if(!file.is_open())
     {
@@ -63,6 +68,8 @@ void LabelData::splitData(double percentage)
     // Split the data into training and validation sets
     m_trainingData.assign(m_data.begin(), m_data.begin() + splitIndex);
     m_validationData.assign(m_data.begin() + splitIndex, m_data.end());
+    m_order.resize(m_trainingData.size());
+    iota(m_order.begin(), m_order.end(), 0u);
 }
 
 vector<double> LabelData::onehotEncode(unsigned label)
@@ -95,7 +102,8 @@ unsigned LabelData::onehotDecode(const std::vector<double>& encoded) {
 
 void LabelData::shuffleData(unsigned seed)
 {
-    shuffle(m_trainingData.begin(), m_trainingData.end(), default_random_engine(seed));
+    // Same permutation as shuffling the data itself
+    shuffle(m_order.begin(), m_order.end(), default_random_engine(seed));
 }
 
 vector<double> &LabelData::getNext()
@@ -117,7 +125,7 @@ vector<double> &LabelData::getNextTrain()
     {
         m_actIndexTrain = 0;
     }
-    return m_trainingData[idx_to_ret];
+    return m_trainingData[m_order[idx_to_ret]];
 }
 
 vector<double> &LabelData::getNextValid()
@@ -2,6 +2,8 @@
  * @file label_data.hpp
  * @brief Declaration of the labelData class and its methods.
  */
+#ifndef LABEL_DATA_HPP
+#define LABEL_DATA_HPP
 
 #include <vector>
 #include <cassert>
@@ -79,6 +81,36 @@ public:
      * @return A reference to the next data input in the training set.
      */
     vector<double> &getNextValid();
+
+    /**
+     * @brief Get a label of the training set by its index, without moving the internal indices.
+     *
+     * Safe to call from several threads at once.
+     *
+     * @param index Index of the label in the (shuffled) training set.
+     * @return A reference to the one-hot encoded label.
+     */
+    const vector<double> &getTrain(unsigned index) const { return m_trainingData[m_order[index]]; }
+
+    /**
+     * @brief Get a label of the training set in the order it was read, unaffected by shuffleData().
+     *
+     * Safe to call while another thread shuffles or reads the training set.
+     *
+     * @param index Index of the label in the training set as read.
+     * @return A reference to the one-hot encoded label.
+     */
+    const vector<double> &getStoredTrain(unsigned index) const { return m_trainingData[index]; }
+
+    /**
+     * @brief Get a label of the validation set by its index, without moving the internal indices.
+     *
+     * Safe to call from several threads at once.
+     *
+     * @param index Index of the label in the validation set.
+     * @return A reference to the one-hot encoded label.
+     */
+    const vector<double> &getValid(unsigned index) const { return m_validationData[index]; }
     
     /**
      * @brief Get the next data input from the validation set.
@@ -97,21 +129,21 @@ public:
      * 
      * @return The total number of data inputs in the dataset.
      */
-    inline unsigned length() { return m_data.size(); };
+    inline unsigned length() const { return m_data.size(); };
 
     /**
      * @brief Gets the number of data inputs in the training set.
      * 
      * @return The number of data inputs in the training set.
      */
-    inline unsigned validLength() { return m_validationData.size(); };
+    inline unsigned validLength() const { return m_validationData.size(); };
 
     /**
      * @brief Gets the number of data inputs in the validation set.
      * 
      * @return The number of data inputs in the validation set.
      */
-    inline unsigned trainLength() { return m_trainingData.size(); }
+    inline unsigned trainLength() const { return m_trainingData.size(); }
 
 private:
     /**
@@ -154,8 +186,16 @@ private:
      */
     vector<vector<double>> m_trainingData;
 
+    /**
+     * @brief Order of the training set: shuffleData() permutes it instead of the data, so the
+     * stored labels never move (see getStoredTrain()).
+     */
+    vector<unsigned> m_order;
+
     /**
      * @brief Container for storing validation set data.
      */
     vector<vector<double>> m_validationData;
 };
+
+#endif // LABEL_DATA_HPP
@@ -0,0 +1,674 @@
+/**
+ * @file layer.cpp
+ * @brief Implementation of the layer types and the fusion pass.
+ */
+
+#include "layer.hpp"
+#include "kernels.hpp"
+#include "random.hpp"
+#include "gemm.hpp"
+#include <cmath>
+#include <cassert>
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+double DenseLayer::decay = 0.9;
+double DenseLayer::epsilon = 1e-8;
+
+/**
+ * @brief Slope of LeakyReLU for negative potentials.
+ */
+static const double leakySlope = 0.01;
+
+/**
+ * @brief GELU (tanh approximation).
+ */
+static inline double gelu(double x)
+{
+    const double k = 0.7978845608028654; // sqrt(2 / pi)
+    return 0.5 * x * (1.0 + tanh(k * (x + 0.044715 * x * x * x)));
+}
+
+/**
+ * @brief Derivative of the tanh approximation of GELU.
+ */
+static inline double geluDerivative(double x)
+{
+    const double k = 0.7978845608028654; // sqrt(2 / pi)
+    const double t = tanh(k * (x + 0.044715 * x * x * x));
+    return 0.5 * (1.0 + t) + 0.5 * x * (1.0 - t * t) * k * (1.0 + 3.0 * 0.044715 * x * x);
+}
+
+/**
+ * @brief Apply an activation function known at compile time.
+ */
+template <Activation A>
+static inline double activate(double x)
+{
+    if constexpr (A == Activation::ReLU)
+    {
+        return max(0.0, x);
+    }
+    else if constexpr (A == Activation::LeakyReLU)
+    {
+        return x > 0.0 ? x : leakySlope * x;
+    }
+    else if constexpr (A == Activation::GELU)
+    {
+        return gelu(x);
+    }
+    else
+    {
+        return x;
+    }
+}
+
+/**
+ * @brief Derivative of an activation function known at compile time, evaluated at the input.
+ */
+template <Activation A>
+static inline double activateDerivative(double x)
+{
+    if constexpr (A == Activation::ReLU)
+    {
+        return x < 0.0 ? 0.0 : 1.0;
+    }
+    else if constexpr (A == Activation::LeakyReLU)
+    {
+        return x < 0.0 ? leakySlope : 1.0;
+    }
+    else if constexpr (A == Activation::GELU)
+    {
+        return geluDerivative(x);
+    }
+    else
+    {
+        return 1.0;
+    }
+}
+
+string activationName(Activation activation)
+{
+    switch (activation)
+    {
+        case Activation::ReLU: return "ReLU";
+        case Activation::LeakyReLU: return "LeakyReLU";
+        case Activation::GELU: return "GELU";
+        default: return "Identity";
+    }
+}
+
+Activation parseActivation(const string &name)
+{
+    if (name == "identity") return Activation::Identity;
+    if (name == "relu") return Activation::ReLU;
+    if (name == "leaky_relu") return Activation::LeakyReLU;
+    if (name == "gelu") return Activation::GELU;
+    throw invalid_argument("Unknown activation function: " + name);
+}
+
+Optimizer parseOptimizer(const string &name)
+{
+    if (name == "rmsprop") return Optimizer::RMSProp;
+    if (name == "sgd") return Optimizer::SGD;
+    throw invalid_argument("Unknown optimizer: " + name);
+}
+
+string optimizerName(Optimizer optimizer)
+{
+    return optimizer == Optimizer::SGD ? "SGD" : "RMSprop";
+}
+
+// ---------------------------------------------------------------------------
+// DenseLayer
+// ---------------------------------------------------------------------------
+
+DenseLayer::DenseLayer(unsigned numInputs, unsigned numOutputs, mt19937 &generator) :
+    DenseLayer(numInputs, numOutputs, 1, true, &generator)
+{
+}
+
+DenseLayer::DenseLayer(unsigned numInputs, unsigned numOutputs) :
+    DenseLayer(numInputs, numOutputs, 1, true, nullptr)
+{
+}
+
+DenseLayer::DenseLayer(unsigned numInputs, unsigned numOutputs, unsigned groups, bool sharedInputs, mt19937 *generators) :
+    Layer(sharedInputs ? numInputs : groups * numInputs, groups * numOutputs),
+    m_groups(groups),
+    m_groupInputs(numInputs),
+    m_groupOutputs(numOutputs),
+    m_deltas(nullptr),
+    m_mask(nullptr),
+    m_workspaceRows(0),
+    m_ownedState(3 * parameterSize(), 0.0),
+    m_bound(false),
+    m_activation(Activation::Identity),
+    m_dropout(0.0),
+    m_learningRate(defaultLearningRate),
+    m_optimizer(Optimizer::RMSProp)
+{
+    // Parameters (weights, then biases), optimizer state and gradients, one after another
+    m_weights = m_ownedState.data();
+    m_biases = m_weights + weightCount();
+    m_weightDeltas = m_weights + parameterSize();
+    m_weightGradients = m_weightDeltas + parameterSize();
+
+    if (!generators)
+    {
+        return;
+    }
+
+    // Same seed sequence as ReferenceNet: one seed per source neuron (the bias last),
+    // one seed per outgoing weight
+    for (unsigned g = 0; g < groups; ++g)
+    {
+        double *weights = m_weights + g * numOutputs * numInputs, *biases = m_biases + g * numOutputs;
+        for (unsigned i = 0; i <= numInputs; ++i)
+        {
+            mt19937 neuronGenerator(generators[g]());
+            for (unsigned j = 0; j < numOutputs; ++j)
+            {
+                mt19937 weightGenerator(neuronGenerator());
+                normal_distribution<> distribution(0, sqrt(2.0 / numInputs));
+                double weight = distribution(weightGenerator);
+                (i < numInputs ? weights[j * numInputs + i] : biases[j]) = weight;
+            }
+        }
+    }
+}
+
+void DenseLayer::bindStorage(const LayerStorage &storage)
+{
+    const unsigned n = parameterSize();
+    if (!storage.sharedParameters)
+    {
+        copy(m_weights, m_weights + n, storage.parameters);
+        copy(m_weightDeltas, m_weightDeltas + n, storage.optimizerState);
+    }
+    copy(m_weightGradients, m_weightGradients + n, storage.gradients);
+
+    m_weights = storage.parameters;
+    m_biases = m_weights + weightCount();
+    m_weightDeltas = storage.optimizerState;
+    m_weightGradients = storage.gradients;
+    m_deltas = storage.workspace;
+    m_mask = m_deltas + storage.rows * m_numOutputs;
+    m_workspaceRows = storage.rows;
+    m_bound = true;
+
+    m_ownedState = vector<double>();
+    m_ownedWorkspace = vector<double>();
+}
+
+void DenseLayer::reserveWorkspace(unsigned rows)
+{
+    if (rows <= m_workspaceRows)
+    {
+        return;
+    }
+    assert(!m_bound);
+    m_ownedWorkspace.resize(workspaceSize(rows));
+    m_deltas = m_ownedWorkspace.data();
+    m_mask = m_deltas + rows * m_numOutputs;
+    m_workspaceRows = rows;
+}
+
+string DenseLayer::name() const
+{
+    string result = "Dense(" + to_string(m_groupInputs) + "->" + to_string(m_groupOutputs) + ")";
+    if (m_groups > 1)
+    {
+        result = to_string(m_groups) + "x" + result + (m_numInputs == m_groupInputs ? "[shared inputs]" : "");
+    }
+    if (m_activation != Activation::Identity)
+    {
+        result += "+" + activationName(m_activation);
+    }
+    if (m_dropout > 0.0)
+    {
+        result += "+Dropout(" + to_string(m_dropout) + ")";
+    }
+    return result;
+}
+
+unsigned DenseLayer::auxSize() const
+{
+    // Only GELU needs the potentials, the other derivatives are recovered from the outputs
+    return m_activation == Activation::GELU ? m_numOutputs : 0;
+}
+
+template <Activation A, bool Dropout>
+void DenseLayer::forwardKernel(const double *inputs, double *outputs, double *potentials, unsigned rows)
+{
+    const unsigned numInputs = m_numInputs, numOutputs = m_numOutputs;
+    const double *biases = m_biases;
+    const double *mask = m_mask;
+
+    // Products of the inputs and weights of all rows at once (of all members at once if they
+    // share the inputs), the rest is applied to each row while it is still in cache
+    if (numInputs == m_groupInputs)
+    {
+        gemm(false, true, rows, numOutputs, numInputs, inputs, numInputs, m_weights, numInputs,
+             0.0, outputs, numOutputs);
+    }
+    else
+    {
+        const unsigned groupInputs = m_groupInputs, groupOutputs = m_groupOutputs;
+        for (unsigned g = 0; g < m_groups; ++g)
+        {
+            gemm(false, true, rows, groupOutputs, groupInputs, inputs + g * groupInputs, numInputs,
+                 m_weights + g * groupOutputs * groupInputs, groupInputs, 0.0, outputs + g * groupOutputs, numOutputs);
+        }
+    }
+
+    for (unsigned r = 0; r < rows; ++r)
+    {
+        double *out = outputs + r * numOutputs;
+
+        for (unsigned j = 0; j < numOutputs; ++j)
+        {
+            const double potential = out[j] + biases[j];
+
+            if constexpr (A == Activation::GELU)
+            {
+                potentials[r * numOutputs + j] = potential;
+            }
+
+            if constexpr (Dropout)
+            {
+                out[j] = activate<A>(potential) * mask[r * numOutputs + j];
+            }
+            else
+            {
+                out[j] = activate<A>(potential);
+            }
+        }
+    }
+}
+
+void DenseLayer::forward(const double *inputs, double *outputs, double *aux, unsigned rows, bool training)
+{
+    const bool dropout = training && m_dropout > 0.0;
+    if (dropout)
+    {
+        reserveWorkspace(rows);
+        threadGenerator().dropoutMask(m_dropout, m_mask, rows * m_numOutputs);
+    }
+
+#define DENSE_FORWARD(A) \
+    (dropout ? forwardKernel<A, true>(inputs, outputs, aux, rows) : forwardKernel<A, false>(inputs, outputs, aux, rows))
+
+    switch (m_activation)
+    {
+        case Activation::ReLU: DENSE_FORWARD(Activation::ReLU); break;
+        case Activation::LeakyReLU: DENSE_FORWARD(Activation::LeakyReLU); break;
+        case Activation::GELU: DENSE_FORWARD(Activation::GELU); break;
+        default: DENSE_FORWARD(Activation::Identity); break;
+    }
+
+#undef DENSE_FORWARD
+}
+
+template <Activation A>
+void DenseLayer::deltaKernel(const double *outputs, const double *potentials, const double *outputGradients, unsigned rows)
+{
+    const unsigned n = rows * m_numOutputs;
+    const double keepScale = 1.0 / (1.0 - m_dropout);
+    const bool dropout = m_dropout > 0.0;
+    double *deltas = m_deltas;
+
+    // Dropped outputs are recognised by being exactly zero
+    for (unsigned k = 0; k < n; ++k)
+    {
+        double derivative;
+        if constexpr (A == Activation::ReLU)
+        {
+            derivative = outputs[k] > 0.0 ? 1.0 : 0.0;
+        }
+        else if constexpr (A == Activation::LeakyReLU)
+        {
+            derivative = outputs[k] > 0.0 ? 1.0 : (outputs[k] < 0.0 || !dropout ? leakySlope : 0.0);
+        }
+        else if constexpr (A == Activation::GELU)
+        {
+            derivative = (dropout && outputs[k] == 0.0) ? 0.0 : geluDerivative(potentials[k]);
+        }
+        else
+        {
+            derivative = (dropout && outputs[k] == 0.0) ? 0.0 : 1.0;
+        }
+        deltas[k] = outputGradients[k] * derivative * (dropout ? keepScale : 1.0);
+    }
+}
+
+void DenseLayer::backward(const double *inputs, const double *outputs, const double *aux,
+                          const double *outputGradients, double *inputGradients, unsigned rows)
+{
+    const unsigned numInputs = m_numInputs, numOutputs = m_numOutputs;
+    reserveWorkspace(rows);
+
+    switch (m_activation)
+    {
+        case Activation::ReLU: deltaKernel<Activation::ReLU>(outputs, aux, outputGradients, rows); break;
+        case Activation::LeakyReLU: deltaKernel<Activation::LeakyReLU>(outputs, aux, outputGradients, rows); break;
+        case Activation::GELU: deltaKernel<Activation::GELU>(outputs, aux, outputGradients, rows); break;
+        default: deltaKernel<Activation::Identity>(outputs, aux, outputGradients, rows); break;
+    }
+
+    if (numInputs == m_groupInputs)
+    {
+        // Gradients with respect to the weights: deltas^T * inputs, summed over the rows
+        gemm(true, false, numOutputs, numInputs, rows, m_deltas, numOutputs, inputs, numInputs,
+             1.0, m_weightGradients, numInputs);
+
+        // Gradients with respect to the inputs: deltas * weights (summed over the members)
+        if (inputGradients)
+        {
+            gemm(false, false, rows, numInputs, numOutputs, m_deltas, numOutputs, m_weights, numInputs,
+                 0.0, inputGradients, numInputs);
+        }
+        return;
+    }
+
+    // The same products for each member on its own columns
+    const unsigned groupInputs = m_groupInputs, groupOutputs = m_groupOutputs;
+    for (unsigned g = 0; g < m_groups; ++g)
+    {
+        const unsigned weightOffset = g * groupOutputs * groupInputs;
+        gemm(true, false, groupOutputs, groupInputs, rows, m_deltas + g * groupOutputs, numOutputs,
+             inputs + g * groupInputs, numInputs, 1.0, m_weightGradients + weightOffset, groupInputs);
+        if (inputGradients)
+        {
+            gemm(false, false, rows, groupInputs, groupOutputs, m_deltas + g * groupOutputs, numOutputs,
+                 m_weights + weightOffset, groupInputs, 0.0, inputGradients + g * groupInputs, numInputs);
+        }
+    }
+}
+
+void DenseLayer::resetGradientSum()
+{
+    fill(m_weightGradients, m_weightGradients + weightCount(), 0.0);
+}
+
+void DenseLayer::calcAvgGradient(unsigned batchSize)
+{
+    const double scale = 1.0 / batchSize;
+    const unsigned n = weightCount();
+    for (unsigned k = 0; k < n; ++k)
+    {
+        m_weightGradients[k] *= scale;
+    }
+}
+
+void DenseLayer::updateWeights()
+{
+    if (m_optimizer == Optimizer::SGD)
+    {
+        sgd(m_weights, m_weightGradients, weightCount(), m_learningRate);
+    }
+    else
+    {
+        rmsprop(m_weights, m_weightDeltas, m_weightGradients, weightCount(),
+                m_learningRate, decay, epsilon);
+    }
+
+    // Pruned weights stay at zero while the others are fine-tuned
+    if (!m_keep.empty())
+    {
+        const unsigned n = weightCount();
+        for (unsigned k = 0; k < n; ++k)
+        {
+            m_weights[k] = m_keep[k] ? m_weights[k] : 0.0;
+        }
+    }
+}
+
+void DenseLayer::prune(double fraction)
+{
+    const unsigned n = weightCount();
+    const unsigned count = min(n, static_cast<unsigned>(fraction * n));
+    if (m_keep.empty())
+    {
+        m_keep.assign(n, 1);
+    }
+
+    // The weights pruned before have magnitude zero and come first
+    vector<unsigned> order(n);
+    iota(order.begin(), order.end(), 0);
+    nth_element(order.begin(), order.begin() + count, order.end(), [this](unsigned a, unsigned b) {
+        return fabs(m_weights[a]) < fabs(m_weights[b]);
+    });
+    for (unsigned i = 0; i < count; ++i)
+    {
+        m_keep[order[i]] = 0;
+        m_weights[order[i]] = 0.0;
+    }
+}
+
+double DenseLayer::sparsity() const
+{
+    const unsigned n = weightCount();
+    return n > 0 ? double(count(m_weights, m_weights + n, 0.0)) / n : 0.0;
+}
+
+bool DenseLayer::setDropout(double probability)
+{
+    m_dropout = probability;
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// ActivationLayer
+// ---------------------------------------------------------------------------
+
+string ActivationLayer::name() const
+{
+    return activationName(m_activation);
+}
+
+template <Activation A>
+static void activationForward(const double *inputs, double *outputs, unsigned n)
+{
+    for (unsigned k = 0; k < n; ++k)
+    {
+        outputs[k] = activate<A>(inputs[k]);
+    }
+}
+
+template <Activation A>
+static void activationBackward(const double *inputs, const double *outputGradients, double *inputGradients, unsigned n)
+{
+    for (unsigned k = 0; k < n; ++k)
+    {
+        inputGradients[k] = outputGradients[k] * activateDerivative<A>(inputs[k]);
+    }
+}
+
+void ActivationLayer::forward(const double *inputs, double *outputs, double *aux, unsigned rows, bool training)
+{
+    (void)aux;
+    (void)training;
+    const unsigned n = rows * m_numOutputs;
+    switch (m_activation)
+    {
+        case Activation::ReLU: activationForward<Activation::ReLU>(inputs, outputs, n); break;
+        case Activation::LeakyReLU: activationForward<Activation::LeakyReLU>(inputs, outputs, n); break;
+        case Activation::GELU: activationForward<Activation::GELU>(inputs, outputs, n); break;
+        default: activationForward<Activation::Identity>(inputs, outputs, n); break;
+    }
+}
+
+void ActivationLayer::backward(const double *inputs, const double *outputs, const double *aux,
+                               const double *outputGradients, double *inputGradients, unsigned rows)
+{
+    (void)outputs;
+    (void)aux;
+    if (!inputGradients)
+    {
+        return;
+    }
+    const unsigned n = rows * m_numOutputs;
+    switch (m_activation)
+    {
+        case Activation::ReLU: activationBackward<Activation::ReLU>(inputs, outputGradients, inputGradients, n); break;
+        case Activation::LeakyReLU: activationBackward<Activation::LeakyReLU>(inputs, outputGradients, inputGradients, n); break;
+        case Activation::GELU: activationBackward<Activation::GELU>(inputs, outputGradients, inputGradients, n); break;
+        default: activationBackward<Activation::Identity>(inputs, outputGradients, inputGradients, n); break;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// DropoutLayer
+// ---------------------------------------------------------------------------
+
+string DropoutLayer::name() const
+{
+    return "Dropout(" + to_string(m_probability) + ")";
+}
+
+void DropoutLayer::forward(const double *inputs, double *outputs, double *aux, unsigned rows, bool training)
+{
+    const unsigned n = rows * m_numOutputs;
+    if (!training || m_probability == 0.0)
+    {
+        copy(inputs, inputs + n, outputs);
+        fill(aux, aux + n, 1.0);
+        return;
+    }
+
+    threadGenerator().dropoutMask(m_probability, aux, n);
+    for (unsigned k = 0; k < n; ++k)
+    {
+        outputs[k] = inputs[k] * aux[k];
+    }
+}
+
+void DropoutLayer::backward(const double *inputs, const double *outputs, const double *aux,
+                            const double *outputGradients, double *inputGradients, unsigned rows)
+{
+    (void)inputs;
+    (void)outputs;
+    if (!inputGradients)
+    {
+        return;
+    }
+    const unsigned n = rows * m_numOutputs;
+    for (unsigned k = 0; k < n; ++k)
+    {
+        inputGradients[k] = outputGradients[k] * aux[k];
+    }
+}
+
+bool DropoutLayer::setDropout(double probability)
+{
+    m_probability = probability;
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// SoftmaxOutputLayer
+// ---------------------------------------------------------------------------
+
+string SoftmaxOutputLayer::name() const
+{
+    return m_groups > 1 ? to_string(m_groups) + "xSoftmax" : "Softmax";
+}
+
+void SoftmaxOutputLayer::forward(const double *inputs, double *outputs, double *aux, unsigned rows, bool training)
+{
+    (void)training;
+    const unsigned size = m_groupSize;
+    for (unsigned r = 0; r < rows; ++r)
+    {
+        for (unsigned g = 0; g < m_groups; ++g)
+        {
+            aux[r * m_groups + g] = softmax(inputs + r * m_numInputs + g * size, outputs + r * m_numOutputs + g * size, size);
+        }
+    }
+}
+
+void SoftmaxOutputLayer::backward(const double *inputs, const double *outputs, const double *aux,
+                                  const double *outputGradients, double *inputGradients, unsigned rows)
+{
+    (void)inputs;
+    (void)aux;
+    if (!inputGradients)
+    {
+        return;
+    }
+    // Softmax Jacobian-vector product: p * (g - <g, p>), for each member
+    const unsigned size = m_groupSize;
+    for (unsigned r = 0; r < rows; ++r)
+    {
+        for (unsigned k = 0; k < m_numOutputs; k += size)
+        {
+            const double *p = outputs + r * m_numOutputs + k;
+            const double *g = outputGradients + r * m_numOutputs + k;
+            double dot = 0.0;
+            for (unsigned j = 0; j < size; ++j)
+            {
+                dot += g[j] * p[j];
+            }
+            for (unsigned j = 0; j < size; ++j)
+            {
+                inputGradients[r * m_numInputs + k + j] = p[j] * (g[j] - dot);
+            }
+        }
+    }
+}
+
+double SoftmaxOutputLayer::loss(const double *inputs, const double *outputs, const double *aux,
+                                const double *targets, double *inputGradients, unsigned rows) const
+{
+    const unsigned size = m_groupSize;
+    double sum = 0.0;
+    for (unsigned r = 0; r < rows; ++r)
+    {
+        for (unsigned g = 0; g < m_groups; ++g)
+        {
+            const unsigned offset = r * m_numOutputs + g * size;
+            sum += crossEntropy(inputs + offset, outputs + offset, aux[r * m_groups + g], targets + r * size,
+                                inputGradients ? inputGradients + offset : nullptr, size);
+        }
+    }
+    return m_groups > 1 ? sum / m_groups : sum;
+}
+
+// ---------------------------------------------------------------------------
+// Fusion pass
+// ---------------------------------------------------------------------------
+
+vector<unique_ptr<Layer>> fuseLayers(vector<unique_ptr<Layer>> layers)
+{
+    vector<unique_ptr<Layer>> fused;
+
+    for (unsigned k = 0; k < layers.size(); ++k)
+    {
+        DenseLayer *dense = dynamic_cast<DenseLayer *>(layers[k].get());
+        fused.push_back(move(layers[k]));
+        if (!dense || dense->getActivation() != Activation::Identity)
+        {
+            continue;
+        }
+
+        // Dense + activation
+        ActivationLayer *activation = k + 1 < layers.size() ? dynamic_cast<ActivationLayer *>(layers[k + 1].get()) : nullptr;
+        if (activation)
+        {
+            dense->setActivation(activation->getActivation());
+            ++k;
+        }
+
+        // (Dense + activation) + dropout
+        DropoutLayer *dropout = k + 1 < layers.size() ? dynamic_cast<DropoutLayer *>(layers[k + 1].get()) : nullptr;
+        if (dropout)
+        {
+            dense->setDropout(dropout->getProbability());
+            ++k;
+        }
+    }
+
+    return fused;
+}
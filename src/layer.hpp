@@ -0,0 +1,599 @@
+/**
+ * @file layer.hpp
+ * @brief Declaration of the Layer interface, the layer types and the fusion pass.
+ */
+#ifndef LAYER_HPP
+#define LAYER_HPP
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <random>
+#include <cstdlib>
+#include <iostream>
+
+using namespace std;
+
+/**
+ * @enum Activation
+ * @brief Activation functions supported by ActivationLayer and fused into DenseLayer.
+ */
+enum class Activation
+{
+    Identity,
+    ReLU,
+    LeakyReLU,
+    GELU
+};
+
+/**
+ * @brief Parse the name of an activation function.
+ * @param name One of "identity", "relu", "leaky_relu", "gelu".
+ * @return The activation function.
+ * @throws std::invalid_argument if the name is unknown.
+ */
+Activation parseActivation(const string &name);
+
+/**
+ * @brief Get the human-readable name of an activation function.
+ */
+string activationName(Activation activation);
+
+/**
+ * @enum Optimizer
+ * @brief Update rules of the dense layer weights.
+ */
+enum class Optimizer
+{
+    RMSProp,
+    SGD
+};
+
+/**
+ * @brief Parse the name of an optimizer.
+ * @param name One of "rmsprop", "sgd".
+ * @return The optimizer.
+ * @throws std::invalid_argument if the name is unknown.
+ */
+Optimizer parseOptimizer(const string &name);
+
+/**
+ * @brief Get the human-readable name of an optimizer.
+ */
+string optimizerName(Optimizer optimizer);
+
+/**
+ * @struct LayerStorage
+ * @brief Memory a layer is bound to by LayerStorage-aware owners such as Net.
+ *
+ * Parameters, optimizer state and gradients are parameterSize() doubles each, the
+ * workspace holds workspaceSize(rows) doubles. With `sharedParameters`, the parameters
+ * and optimizer state belong to another layer of the same shape and are used as they
+ * are instead of being overwritten.
+ */
+struct LayerStorage
+{
+    double *parameters;
+    double *optimizerState;
+    double *gradients;
+    double *workspace;
+    unsigned rows;
+    bool sharedParameters;
+};
+
+/**
+ * @class Layer
+ * @brief Interface of one operation in the network graph.
+ *
+ * Layers work on batches stored row-major, one sample per row. Layers hold their
+ * parameters, but not the activations: the caller owns the input, output and gradient
+ * buffers, and an auxiliary buffer of auxSize() values per row in which a layer keeps
+ * whatever its backward pass needs besides its input and output.
+ *
+ * Layers with parameters allocate them on construction, but can be bound to external
+ * memory by bindStorage(), so that a network can keep the state of all its layers in
+ * one block.
+ */
+class Layer
+{
+protected:
+    /**
+     * @brief Number of values in one input row.
+     */
+    const unsigned m_numInputs;
+
+    /**
+     * @brief Number of values in one output row.
+     */
+    const unsigned m_numOutputs;
+
+public:
+    /**
+     * @brief Constructor for the Layer class.
+     * @param numInputs Number of values in one input row.
+     * @param numOutputs Number of values in one output row.
+     */
+    Layer(unsigned numInputs, unsigned numOutputs) : m_numInputs(numInputs), m_numOutputs(numOutputs) {}
+
+    virtual ~Layer() = default;
+
+    /**
+     * @brief Get the name of the layer, including fused operations.
+     * @return Human-readable name of the layer.
+     */
+    virtual string name() const = 0;
+
+    /**
+     * @brief Get the number of values in one input row.
+     */
+    unsigned numInputs() const { return m_numInputs; }
+
+    /**
+     * @brief Get the number of values in one output row.
+     */
+    unsigned numOutputs() const { return m_numOutputs; }
+
+    /**
+     * @brief Number of auxiliary values per row the layer saves for its backward pass.
+     */
+    virtual unsigned auxSize() const { return 0; }
+
+    /**
+     * @brief Number of parameters; optimizer state and gradients have the same size.
+     */
+    virtual unsigned parameterSize() const { return 0; }
+
+    /**
+     * @brief Number of scratch values the layer needs to process a batch.
+     * @param rows Number of rows (samples).
+     */
+    virtual unsigned workspaceSize(unsigned rows) const { (void)rows; return 0; }
+
+    /**
+     * @brief Move the state of the layer into external memory and use it from now on.
+     *
+     * The current parameters, optimizer state and gradients are copied over, so the
+     * layer can be rebound to a larger block at any time. The memory must outlive the
+     * layer or the next bindStorage() call.
+     *
+     * @param storage Memory for the layer, see LayerStorage.
+     */
+    virtual void bindStorage(const LayerStorage &storage) { (void)storage; }
+
+    /**
+     * @brief Compute the outputs of the layer.
+     * @param inputs Input rows.
+     * @param outputs Output rows.
+     * @param aux Auxiliary buffer with auxSize() values per row.
+     * @param rows Number of rows (samples).
+     * @param training Whether the pass is part of training (enables dropout).
+     */
+    virtual void forward(const double *inputs, double *outputs, double *aux, unsigned rows, bool training) = 0;
+
+    /**
+     * @brief Propagate gradients back through the layer and accumulate parameter gradients.
+     * @param inputs Input rows of the forward pass.
+     * @param outputs Output rows of the forward pass.
+     * @param aux Auxiliary buffer filled by the forward pass.
+     * @param outputGradients Gradients of the loss with respect to the outputs.
+     * @param inputGradients Output for gradients with respect to the inputs, nullptr if not needed.
+     * @param rows Number of rows (samples).
+     */
+    virtual void backward(const double *inputs, const double *outputs, const double *aux,
+                          const double *outputGradients, double *inputGradients, unsigned rows) = 0;
+
+    /**
+     * @brief Reset the accumulated parameter gradients to zero.
+     */
+    virtual void resetGradientSum() {}
+
+    /**
+     * @brief Average the accumulated parameter gradients over a mini-batch.
+     * @param batchSize Number of training examples in the mini-batch.
+     */
+    virtual void calcAvgGradient(unsigned batchSize) { (void)batchSize; }
+
+    /**
+     * @brief Update the parameters based on the averaged gradients.
+     */
+    virtual void updateWeights() {}
+
+    /**
+     * @brief Set the dropout probability of the layer outputs, if the layer supports dropout.
+     * @param probability Dropout probability.
+     * @return True if the layer applies dropout to its outputs.
+     */
+    virtual bool setDropout(double probability) { (void)probability; return false; }
+};
+
+/**
+ * @class DenseLayer
+ * @brief Fully connected layer, optionally with a fused activation and dropout.
+ *
+ * Weights are stored row-major per output neuron (`weights[j * numInputs + i]` connects
+ * input `i` to output `j`). The potentials of a batch are computed by one gemm() call,
+ * bias, activation and dropout are then applied in a single pass over the result, so
+ * the potentials are only kept when the activation derivative needs them (GELU). The
+ * backward pass is two more gemm() calls, for the weight and the input gradients.
+ * Biases keep their initial values during training, as in the original per-neuron
+ * implementation (ReferenceNet). Weights are updated by RMSprop (or plain SGD) with the
+ * learning rate of the layer.
+ *
+ * A layer can pack several independent members of an ensemble side by side: the outputs
+ * of member `g` are columns `[g * out, (g + 1) * out)` and its weights the corresponding
+ * rows of the weight matrix. With shared inputs (the first layer of an ensemble) all
+ * members read the same input row, so the forward pass and the weight gradients of all
+ * members are one gemm() call each, as wide as all members together. Otherwise member `g`
+ * reads its own input columns and every product is done per member.
+ */
+class DenseLayer : public Layer
+{
+private:
+    /**
+     * @brief Decay factor for RMSprop optimization.
+     */
+    static double decay;
+
+    /**
+     * @brief Small constant used to prevent division by zero.
+     */
+    static double epsilon;
+
+    /**
+     * @brief Number of members packed into the layer.
+     */
+    unsigned m_groups;
+
+    /**
+     * @brief Number of inputs of one member.
+     */
+    unsigned m_groupInputs;
+
+    /**
+     * @brief Number of outputs of one member.
+     */
+    unsigned m_groupOutputs;
+
+    /**
+     * @brief Weight matrix, `m_numOutputs` rows of `m_groupInputs` values, followed by the biases.
+     */
+    double *m_weights;
+
+    /**
+     * @brief Bias of each output neuron.
+     */
+    double *m_biases;
+
+    /**
+     * @brief RMSprop moving average of squared gradients of each weight.
+     */
+    double *m_weightDeltas;
+
+    /**
+     * @brief Accumulated gradients of each weight.
+     */
+    double *m_weightGradients;
+
+    /**
+     * @brief Gradients with respect to the potentials of the rows being backpropagated.
+     */
+    double *m_deltas;
+
+    /**
+     * @brief Dropout mask of the rows being fed forward.
+     */
+    double *m_mask;
+
+    /**
+     * @brief Number of rows the workspace (`m_deltas`, `m_mask`) can hold.
+     */
+    unsigned m_workspaceRows;
+
+    /**
+     * @brief Own storage of parameters, optimizer state and gradients, empty once bound.
+     */
+    vector<double> m_ownedState;
+
+    /**
+     * @brief Own workspace, empty once bound.
+     */
+    vector<double> m_ownedWorkspace;
+
+    /**
+     * @brief Whether the layer is bound to external memory.
+     */
+    bool m_bound;
+
+    /**
+     * @brief Fused activation function.
+     */
+    Activation m_activation;
+
+    /**
+     * @brief Fused dropout probability.
+     */
+    double m_dropout;
+
+    /**
+     * @brief Learning rate.
+     */
+    double m_learningRate;
+
+    /**
+     * @brief Update rule of the weights.
+     */
+    Optimizer m_optimizer;
+
+    /**
+     * @brief Weights kept by pruning (1) or held at zero (0), empty if the layer was never pruned.
+     */
+    vector<unsigned char> m_keep;
+
+    /**
+     * @brief Make sure the workspace can hold a given number of rows (grows own storage only).
+     * @param rows Number of rows (samples).
+     */
+    void reserveWorkspace(unsigned rows);
+
+    template <Activation A, bool Dropout>
+    void forwardKernel(const double *inputs, double *outputs, double *potentials, unsigned rows);
+
+    template <Activation A>
+    void deltaKernel(const double *outputs, const double *potentials, const double *outputGradients, unsigned rows);
+
+public:
+    /**
+     * @brief Constructor for the DenseLayer class.
+     *
+     * Weights are He-initialized; seeds are derived from `generator` exactly like the
+     * per-neuron implementation does, so both start from the same weights.
+     *
+     * @param numInputs Number of inputs.
+     * @param numOutputs Number of output neurons.
+     * @param generator Generator of the per-neuron seeds.
+     */
+    DenseLayer(unsigned numInputs, unsigned numOutputs, mt19937 &generator);
+
+    /**
+     * @brief Constructor for a DenseLayer with zero weights, to be bound to shared parameters.
+     * @param numInputs Number of inputs.
+     * @param numOutputs Number of output neurons.
+     */
+    DenseLayer(unsigned numInputs, unsigned numOutputs);
+
+    /**
+     * @brief Constructor for a layer packing several members of an ensemble.
+     *
+     * The weights of every member are initialized like those of a single layer from its
+     * own generator.
+     *
+     * @param numInputs Number of inputs of one member.
+     * @param numOutputs Number of output neurons of one member.
+     * @param groups Number of members.
+     * @param sharedInputs Whether all members read the same inputs, or each its own `numInputs` columns.
+     * @param generators Generator of the per-neuron seeds of each member, nullptr for zero weights.
+     */
+    DenseLayer(unsigned numInputs, unsigned numOutputs, unsigned groups, bool sharedInputs, mt19937 *generators);
+
+    /**
+     * @brief Learning rate of new layers.
+     */
+    static constexpr double defaultLearningRate = 0.15;
+
+    /**
+     * @brief Set the learning rate of the layer.
+     * @param learningRate Learning rate value.
+     */
+    void setLearningRate(double learningRate) { m_learningRate = learningRate; }
+
+    /**
+     * @brief Set the update rule of the weights.
+     * @param optimizer The optimizer; RMSprop state is kept while SGD is used.
+     */
+    void setOptimizer(Optimizer optimizer) { m_optimizer = optimizer; }
+
+    string name() const override;
+    unsigned auxSize() const override;
+    unsigned parameterSize() const override { return weightCount() + m_numOutputs; }
+    unsigned workspaceSize(unsigned rows) const override { return 2 * rows * m_numOutputs; }
+    void bindStorage(const LayerStorage &storage) override;
+    void forward(const double *inputs, double *outputs, double *aux, unsigned rows, bool training) override;
+    void backward(const double *inputs, const double *outputs, const double *aux,
+                  const double *outputGradients, double *inputGradients, unsigned rows) override;
+    void resetGradientSum() override;
+    void calcAvgGradient(unsigned batchSize) override;
+    void updateWeights() override;
+    bool setDropout(double probability) override;
+
+    /**
+     * @brief Fuse an activation function into the layer.
+     * @param activation Activation applied to the potentials.
+     */
+    void setActivation(Activation activation) { m_activation = activation; }
+
+    /**
+     * @brief Get the fused activation function.
+     */
+    Activation getActivation() const { return m_activation; }
+
+    /**
+     * @brief Number of weights of all members (the biases not included).
+     */
+    unsigned weightCount() const { return m_numOutputs * m_groupInputs; }
+
+    /**
+     * @brief Get a weight.
+     * @param output Index of the output neuron (of all members).
+     * @param input Index of the input within the member of the output neuron.
+     */
+    double getWeight(unsigned output, unsigned input) const { return m_weights[output * m_groupInputs + input]; }
+
+    /**
+     * @brief Get the bias of an output neuron.
+     * @param output Index of the output neuron.
+     */
+    double getBias(unsigned output) const { return m_biases[output]; }
+
+    /**
+     * @brief Set a weight.
+     * @param output Index of the output neuron (of all members).
+     * @param input Index of the input within the member of the output neuron.
+     * @param value The weight.
+     */
+    void setWeight(unsigned output, unsigned input, double value) { m_weights[output * m_groupInputs + input] = value; }
+
+    /**
+     * @brief Set the bias of an output neuron.
+     * @param output Index of the output neuron.
+     * @param value The bias.
+     */
+    void setBias(unsigned output, double value) { m_biases[output] = value; }
+
+    /**
+     * @brief Get the accumulated (or, after calcAvgGradient(), averaged) gradient of a weight.
+     * @param output Index of the output neuron (of all members).
+     * @param input Index of the input within the member of the output neuron.
+     */
+    double getWeightGradient(unsigned output, unsigned input) const
+    {
+        return m_weightGradients[output * m_groupInputs + input];
+    }
+
+    /**
+     * @brief Prune the weights (not the biases) with the smallest magnitudes: set them to zero
+     * and keep them there in all later updates.
+     * @param fraction Fraction of the weights to prune, including those pruned before.
+     */
+    void prune(double fraction);
+
+    /**
+     * @brief Fraction of the weights (not the biases) that are zero.
+     */
+    double sparsity() const;
+};
+
+/**
+ * @class ActivationLayer
+ * @brief Element-wise activation function.
+ */
+class ActivationLayer : public Layer
+{
+private:
+    /**
+     * @brief Activation function applied to the inputs.
+     */
+    const Activation m_activation;
+
+public:
+    /**
+     * @brief Constructor for the ActivationLayer class.
+     * @param size Number of values in one row.
+     * @param activation Activation function.
+     */
+    ActivationLayer(unsigned size, Activation activation) : Layer(size, size), m_activation(activation) {}
+
+    /**
+     * @brief Get the activation function.
+     */
+    Activation getActivation() const { return m_activation; }
+
+    string name() const override;
+    void forward(const double *inputs, double *outputs, double *aux, unsigned rows, bool training) override;
+    void backward(const double *inputs, const double *outputs, const double *aux,
+                  const double *outputGradients, double *inputGradients, unsigned rows) override;
+};
+
+/**
+ * @class DropoutLayer
+ * @brief Inverted dropout: zeroes inputs with a given probability and rescales the rest.
+ */
+class DropoutLayer : public Layer
+{
+private:
+    /**
+     * @brief Probability of a value being dropped out.
+     */
+    double m_probability;
+
+public:
+    /**
+     * @brief Constructor for the DropoutLayer class.
+     * @param size Number of values in one row.
+     * @param probability Dropout probability.
+     */
+    DropoutLayer(unsigned size, double probability) : Layer(size, size), m_probability(probability) {}
+
+    /**
+     * @brief Get the dropout probability.
+     */
+    double getProbability() const { return m_probability; }
+
+    string name() const override;
+    unsigned auxSize() const override { return m_numOutputs; }
+    void forward(const double *inputs, double *outputs, double *aux, unsigned rows, bool training) override;
+    void backward(const double *inputs, const double *outputs, const double *aux,
+                  const double *outputGradients, double *inputGradients, unsigned rows) override;
+    bool setDropout(double probability) override;
+};
+
+/**
+ * @class SoftmaxOutputLayer
+ * @brief Softmax output layer with a fused categorical cross-entropy loss.
+ *
+ * For an ensemble, each member's outputs get their own softmax and are trained against
+ * the same targets.
+ */
+class SoftmaxOutputLayer : public Layer
+{
+private:
+    /**
+     * @brief Number of members packed into the layer.
+     */
+    const unsigned m_groups;
+
+    /**
+     * @brief Number of outputs of one member.
+     */
+    const unsigned m_groupSize;
+
+public:
+    /**
+     * @brief Constructor for the SoftmaxOutputLayer class.
+     * @param size Number of output neurons (of one member).
+     * @param groups Number of members.
+     */
+    SoftmaxOutputLayer(unsigned size, unsigned groups = 1) :
+        Layer(groups * size, groups * size), m_groups(groups), m_groupSize(size) {}
+
+    string name() const override;
+    unsigned auxSize() const override { return m_groups; } // log-sum-exp of the row of each member
+    void forward(const double *inputs, double *outputs, double *aux, unsigned rows, bool training) override;
+    void backward(const double *inputs, const double *outputs, const double *aux,
+                  const double *outputGradients, double *inputGradients, unsigned rows) override;
+
+    /**
+     * @brief Compute the loss and its gradients with respect to the layer inputs.
+     * @param inputs Input rows (potentials) of the forward pass.
+     * @param outputs Output rows (probabilities) of the forward pass.
+     * @param aux Auxiliary buffer filled by the forward pass.
+     * @param targets Target rows, of the size of one member.
+     * @param inputGradients Output for gradients with respect to the inputs, nullptr if only the loss is needed.
+     * @param rows Number of rows (samples).
+     * @return Sum of the losses of all rows (averaged over the members).
+     */
+    double loss(const double *inputs, const double *outputs, const double *aux,
+                const double *targets, double *inputGradients, unsigned rows) const;
+};
+
+/**
+ * @brief Graph-level fusion pass.
+ *
+ * Merges every DenseLayer with a directly following ActivationLayer and DropoutLayer
+ * into a single DenseLayer whose kernels apply all three operations at once.
+ *
+ * @param layers Layers in execution order.
+ * @return The fused layers in execution order.
+ */
+vector<unique_ptr<Layer>> fuseLayers(vector<unique_ptr<Layer>> layers);
+
+#endif // LAYER_HPP
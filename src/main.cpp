@@ -24,10 +24,12 @@ vector<unsigned int> parseTopology(int number_of_layers, char* neurons_per_layer
 }
 
 void usage(){
-    cerr << "Usage: ./network -e [NUM_EPOCHS] -l [LEARNING_RATE] -b [BATCH_SIZE] INPUT_NEURONS_AMOUNT HIDDEN_LAYER_1_NEURONS_AMOUNT [...] OUTPUT_NEURONS_AMOUNT" << endl;
+    cerr << "Usage: ./network -e [NUM_EPOCHS] -l [LEARNING_RATE] -b [BATCH_SIZE] [-q] [-F] [-k SPARSITY] [-K ROUNDS] [-i EPOCHS] [-O SPARSE_MODEL] [-f] [-a ACTIVATION] [-o OPTIMIZER] [-r] [-d DROPOUT] [-H] [-w THREADS] [-n PROCESSES] [-N PLACEMENT] [-p STAGES] [-m MICRO_BATCHES] [-E MEMBERS] [-s SCHEDULE] [-W WARMUP_EPOCHS] [-t DECAY_EPOCHS] [-g DECAY_FACTOR] [-P PATIENCE] [-M METRICS_FILE] [-I LOG_INTERVAL] [-T TRACE_FILE] [-C] [-A] [-R] [-u SUBSAMPLE] INPUT_NEURONS_AMOUNT HIDDEN_LAYER_1_NEURONS_AMOUNT [...] OUTPUT_NEURONS_AMOUNT" << endl;
+    cerr << "       ./network -S SWEEP_FILE [-j JOBS] [-e NUM_EPOCHS] [-l LEARNING_RATE] [-b BATCH_SIZE] [...] [INPUT_NEURONS_AMOUNT [...] OUTPUT_NEURONS_AMOUNT]" << endl;
 }
 
-void testAndSavePredictions(Net &myNet, InputData &inputs, string output_filepath){
+template <typename NetType>
+void testAndSavePredictions(NetType &myNet, InputData &inputs, string output_filepath){
     vector<double> input, label, output;
 
     ofstream test_predictions_file(output_filepath);
@@ -52,7 +54,8 @@ void testAndSavePredictions(Net &myNet, InputData &inputs, string output_filepat
     }
 }
 
-void testAndPrintAccuracy(Net &myNet, InputData &inputs, LabelData &labels, string subsetName){
+template <typename NetType>
+void testAndPrintAccuracy(NetType &myNet, InputData &inputs, LabelData &labels, string subsetName){
     vector<double> input, label, output;
 
     inputs.resetIndex();
@@ -75,28 +78,783 @@ void testAndPrintAccuracy(Net &myNet, InputData &inputs, LabelData &labels, stri
     cout << subsetName << " Accuracy: " << accuracy_sum / labels.length() << endl;
 }
 
+void compareQuantized(Net &myNet, InputData &inputs, LabelData &labels){
+    vector<double> output;
+
+    QuantizedNet quantNet(myNet, inputs);
+
+    double floatAccuracy = 0, quantAccuracy = 0;
+    chrono::duration<double> floatTime{0}, quantTime{0};
+
+    inputs.resetIndex();
+    labels.resetIndex();
+    for(unsigned i = 0; i < inputs.validLength(); ++i)
+    {
+        const vector<double> &input = inputs.getNextValid();
+        const vector<double> &label = labels.getNextValid();
+
+        auto start = chrono::steady_clock::now();
+        myNet.feedForward(input);
+        myNet.getResults(output);
+        auto mid = chrono::steady_clock::now();
+        floatAccuracy += myNet.compare_result(output, label);
+
+        quantNet.feedForward(input);
+        quantNet.getResults(output);
+        auto end = chrono::steady_clock::now();
+        quantAccuracy += myNet.compare_result(output, label);
+
+        floatTime += mid - start;
+        quantTime += end - mid;
+    }
+    floatAccuracy /= inputs.validLength();
+    quantAccuracy /= inputs.validLength();
+
+    // Weights and biases of the float model
+    size_t floatBytes = 0;
+    const vector<unsigned> &topology = myNet.getTopology();
+    for(unsigned layerNum = 0; layerNum < topology.size() - 1; ++layerNum)
+    {
+        floatBytes += (topology[layerNum] + 1) * topology[layerNum + 1] * sizeof(double);
+    }
+
+    cout << "Float Validation Accuracy: " << floatAccuracy << endl;
+    cout << "Int8 Validation Accuracy: " << quantAccuracy << endl;
+    cout << "Accuracy Delta: " << quantAccuracy - floatAccuracy << endl;
+    cout << "Float Samples/s: " << inputs.validLength() / floatTime.count() << endl;
+    cout << "Int8 Samples/s: " << inputs.validLength() / quantTime.count() << endl;
+    cout << "Weight Memory (float / int8): " << floatBytes << " / " << quantNet.weightBytes() << " bytes" << endl;
+}
+
+void compareMixedPrecision(Net &myNet, Bf16Net &mixedNet, InputData &inputs, LabelData &labels,
+                           const TrainingOptions &options){
+    const unsigned numInputs = myNet.getTopology().front(), numOutputs = myNet.getTopology().back();
+    const unsigned batchRows = AsyncEvaluator::batchRows;
+    vector<double> batchInputs, batchLabels;
+
+    // Gather samples of the training or validation set into contiguous rows
+    auto gather = [&](unsigned first, unsigned rows, bool training, const vector<unsigned> &order) {
+        batchInputs.resize(rows * numInputs);
+        batchLabels.resize(rows * numOutputs);
+        for(unsigned r = 0; r < rows; ++r)
+        {
+            const vector<double> &input = training ? inputs.getStoredTrain(order[first + r]) : inputs.getValid(first + r);
+            const vector<double> &label = training ? labels.getStoredTrain(order[first + r]) : labels.getValid(first + r);
+            copy(input.begin(), input.end(), batchInputs.begin() + r * numInputs);
+            copy(label.begin(), label.end(), batchLabels.begin() + r * numOutputs);
+        }
+    };
+
+    // Accuracy of the copy on the validation set
+    auto validate = [&]() {
+        unsigned correct = 0;
+        for(unsigned first = 0; first < inputs.validLength(); first += batchRows)
+        {
+            const unsigned rows = min(batchRows, inputs.validLength() - first);
+            gather(first, rows, false, {});
+            mixedNet.feedForward(batchInputs.data(), rows);
+            correct += mixedNet.countCorrect(batchLabels.data());
+        }
+        return double(correct) / inputs.validLength();
+    };
+
+    cout << "Mixed precision: bf16 weights and activations, fp32 master weights and accumulation ("
+         << (bf16Instructions() ? "AVX-512 BF16 instructions" : "software conversion") << ")" << endl;
+
+    // The batches of trainNetwork(): the same permutations, the cursor carried across epochs
+    LearningRateSchedule schedule(options.schedule, options.learningRate, options.epochs);
+    vector<unsigned> order(inputs.trainLength());
+    iota(order.begin(), order.end(), 0);
+    unsigned position = 0;
+    chrono::duration<double> trainTime{0};
+    for(unsigned epoch = 0; epoch < options.epochs; ++epoch)
+    {
+        if(schedule.active())
+        {
+            mixedNet.setLearningRate(schedule.rate(epoch));
+        }
+        shuffle(order.begin(), order.end(), default_random_engine(options.seed));
+
+        double loss = 0;
+        unsigned samples = 0;
+        for(unsigned batch = 0; batch < ceil(inputs.trainLength() / options.batchSize); ++batch)
+        {
+            const unsigned rows = min(options.batchSize, inputs.trainLength() - position);
+            gather(position, rows, true, order);
+            position = (position + rows) % inputs.trainLength();
+
+            auto start = chrono::steady_clock::now();
+            loss += mixedNet.train(batchInputs.data(), batchLabels.data(), rows);
+            trainTime += chrono::steady_clock::now() - start;
+            samples += rows;
+        }
+        cout << "Bf16 Epoch " << epoch + 1 << " Train Loss (running): " << loss / samples
+             << " Validation Accuracy: " << validate() << endl;
+    }
+
+    // Both models on the validation set, batch by batch
+    vector<double> output, mixedOutput;
+    unsigned floatCorrect = 0, mixedCorrect = 0, agreements = 0;
+    chrono::duration<double> floatTime{0}, mixedTime{0};
+    for(unsigned first = 0; first < inputs.validLength(); first += batchRows)
+    {
+        const unsigned rows = min(batchRows, inputs.validLength() - first);
+        gather(first, rows, false, {});
+
+        auto start = chrono::steady_clock::now();
+        myNet.feedForward(batchInputs.data(), rows);
+        auto mid = chrono::steady_clock::now();
+        mixedNet.feedForward(batchInputs.data(), rows);
+        auto end = chrono::steady_clock::now();
+        floatTime += mid - start;
+        mixedTime += end - mid;
+
+        floatCorrect += myNet.countCorrect(batchLabels.data());
+        mixedCorrect += mixedNet.countCorrect(batchLabels.data());
+        for(unsigned r = 0; r < rows; ++r)
+        {
+            myNet.getResults(output, r);
+            mixedNet.getResults(mixedOutput, r);
+            agreements += max_element(output.begin(), output.end()) - output.begin() ==
+                          max_element(mixedOutput.begin(), mixedOutput.end()) - mixedOutput.begin();
+        }
+    }
+    const double floatAccuracy = double(floatCorrect) / inputs.validLength();
+    const double mixedAccuracy = double(mixedCorrect) / inputs.validLength();
+
+    // Weights and biases of the double model
+    size_t floatBytes = 0;
+    const vector<unsigned> &topology = myNet.getTopology();
+    for(unsigned layerNum = 0; layerNum < topology.size() - 1; ++layerNum)
+    {
+        floatBytes += (topology[layerNum] + 1) * topology[layerNum + 1] * sizeof(double);
+    }
+
+    cout << "Double Validation Accuracy: " << floatAccuracy << endl;
+    cout << "Bf16 Validation Accuracy: " << mixedAccuracy << endl;
+    cout << "Accuracy Delta: " << mixedAccuracy - floatAccuracy << endl;
+    cout << "Prediction Agreement: " << double(agreements) / inputs.validLength() << endl;
+    cout << "Bf16 Training Samples/s: " << options.epochs * inputs.trainLength() / trainTime.count() << endl;
+    cout << "Double Samples/s: " << inputs.validLength() / floatTime.count() << endl;
+    cout << "Bf16 Samples/s: " << inputs.validLength() / mixedTime.count() << endl;
+    cout << "Weight Memory (double / bf16): " << floatBytes << " / " << mixedNet.weightBytes() << " bytes" << endl;
+}
+
+void compareSparse(Net &myNet, InputData &inputs, LabelData &labels, const string &modelFile){
+    const unsigned numInputs = myNet.getTopology().front();
+    const unsigned batchRows = AsyncEvaluator::batchRows;
+    vector<double> output, sparseOutput, batchInputs;
+
+    unique_ptr<SparseNet> sparseNet = make_unique<SparseNet>(myNet);
+    if(!modelFile.empty())
+    {
+        sparseNet->save(modelFile);
+        sparseNet = make_unique<SparseNet>(modelFile);
+        cout << "Sparse model written to " << modelFile << endl;
+    }
+
+    // One sample at a time
+    unsigned denseCorrect = 0, sparseCorrect = 0, agreements = 0;
+    chrono::duration<double> denseTime{0}, sparseTime{0};
+    inputs.resetIndex();
+    labels.resetIndex();
+    for(unsigned i = 0; i < inputs.validLength(); ++i)
+    {
+        const vector<double> &input = inputs.getNextValid();
+        const vector<double> &label = labels.getNextValid();
+
+        auto start = chrono::steady_clock::now();
+        myNet.feedForward(input);
+        myNet.getResults(output);
+        auto mid = chrono::steady_clock::now();
+        sparseNet->feedForward(input);
+        sparseNet->getResults(sparseOutput);
+        auto end = chrono::steady_clock::now();
+        denseTime += mid - start;
+        sparseTime += end - mid;
+
+        denseCorrect += myNet.compare_result(output, label);
+        sparseCorrect += myNet.compare_result(sparseOutput, label);
+        agreements += max_element(output.begin(), output.end()) - output.begin() ==
+                      max_element(sparseOutput.begin(), sparseOutput.end()) - sparseOutput.begin();
+    }
+
+    // Whole batches
+    chrono::duration<double> denseBatchTime{0}, sparseBatchTime{0};
+    for(unsigned first = 0; first < inputs.validLength(); first += batchRows)
+    {
+        const unsigned rows = min(batchRows, inputs.validLength() - first);
+        batchInputs.resize(rows * numInputs);
+        for(unsigned r = 0; r < rows; ++r)
+        {
+            const vector<double> &input = inputs.getValid(first + r);
+            copy(input.begin(), input.end(), batchInputs.begin() + r * numInputs);
+        }
+
+        auto start = chrono::steady_clock::now();
+        myNet.feedForward(batchInputs.data(), rows);
+        auto mid = chrono::steady_clock::now();
+        sparseNet->feedForward(batchInputs.data(), rows);
+        auto end = chrono::steady_clock::now();
+        denseBatchTime += mid - start;
+        sparseBatchTime += end - mid;
+    }
+
+    // Weights and biases of the dense model
+    size_t denseBytes = 0;
+    const vector<unsigned> &topology = myNet.getTopology();
+    for(unsigned layerNum = 0; layerNum < topology.size() - 1; ++layerNum)
+    {
+        denseBytes += (topology[layerNum] + 1) * topology[layerNum + 1] * sizeof(double);
+    }
+
+    const double denseAccuracy = double(denseCorrect) / inputs.validLength();
+    const double sparseAccuracy = double(sparseCorrect) / inputs.validLength();
+    cout << "Stored Weights: " << sparseNet->density() << endl;
+    cout << "Dense Validation Accuracy: " << denseAccuracy << endl;
+    cout << "Sparse Validation Accuracy: " << sparseAccuracy << endl;
+    cout << "Accuracy Delta: " << sparseAccuracy - denseAccuracy << endl;
+    cout << "Prediction Agreement: " << double(agreements) / inputs.validLength() << endl;
+    cout << "Dense Samples/s: " << inputs.validLength() / denseTime.count() << endl;
+    cout << "Sparse Samples/s: " << inputs.validLength() / sparseTime.count() << endl;
+    cout << "Dense Batched Samples/s: " << inputs.validLength() / denseBatchTime.count() << endl;
+    cout << "Sparse Batched Samples/s: " << inputs.validLength() / sparseBatchTime.count() << endl;
+    cout << "Model Size (dense / sparse): " << denseBytes << " / " << sparseNet->fileBytes() << " bytes" << endl;
+}
+
+template <typename NetType>
+double trainBatch(NetType &myNet, InputData &trainingInputs, LabelData &trainingLabels, unsigned batchSize,
+                  RunningMetrics *running){
+    vector<double> output;
+    double loss = 0;
+
+    for (unsigned i = 0; i < batchSize; i++)
+    {
+        const vector<double> &input = trainingInputs.getNextTrain();
+        const vector<double> &label = trainingLabels.getNextTrain();
+
+        {
+            PROFILE_SCOPE(Forward);
+            myNet.feedForward(input);
+            myNet.getResults(output);
+        }
+        PROFILE_SCOPE(Backward);
+        myNet.backProp(label);
+        loss += myNet.getError();
+        if (running)
+        {
+            running->correct += myNet.compare_result(output, label);
+        }
+    }
+    if (running)
+    {
+        running->loss += loss;
+        running->samples += batchSize;
+    }
+    return loss / batchSize;
+}
+
+double trainBatch(Net &myNet, InputData &trainingInputs, LabelData &trainingLabels, unsigned batchSize,
+                  RunningMetrics *running){
+    // Gather the batch into contiguous rows (reused across batches)
+    static vector<double> inputs, labels;
+    const unsigned numInputs = myNet.getTopology().front(), numOutputs = myNet.getTopology().back();
+
+    // Rows of the batch this process trains on
+    unsigned first = 0, last = batchSize;
+    if (ProcessGroup *group = myNet.getProcessGroup())
+    {
+        first = group->rank() * batchSize / group->size();
+        last = (group->rank() + 1) * batchSize / group->size();
+    }
+    inputs.resize(max(last - first, 1u) * numInputs);
+    labels.resize(max(last - first, 1u) * numOutputs);
+
+    {
+        PROFILE_SCOPE(Data);
+        TraceScope trace("batch");
+        for (unsigned i = 0; i < batchSize; i++)
+        {
+            const vector<double> &input = trainingInputs.getNextTrain();
+            const vector<double> &label = trainingLabels.getNextTrain();
+            if (i >= first && i < last)
+            {
+                copy(input.begin(), input.end(), inputs.begin() + (i - first) * numInputs);
+                copy(label.begin(), label.end(), labels.begin() + (i - first) * numOutputs);
+            }
+        }
+    }
+
+    if (last == first)
+    {
+        return 0.0;
+    }
+    const double loss = myNet.forwardBackward(inputs.data(), labels.data(), last - first);
+
+    // The outputs of the batch are still in the network (the pipeline writes them there too)
+    if (running)
+    {
+        running->loss += loss;
+        running->correct += myNet.countCorrect(labels.data());
+        running->samples += last - first;
+    }
+    return loss / (last - first);
+}
+
+vector<unsigned> sampleTrainSubset(unsigned trainLength, unsigned count, unsigned seed){
+    vector<unsigned> all(trainLength), subset;
+    iota(all.begin(), all.end(), 0);
+    sample(all.begin(), all.end(), back_inserter(subset), count, default_random_engine(seed));
+    return subset;
+}
+
+template <typename NetType>
+EpochMetrics evaluateEpoch(NetType &myNet, InputData &trainingInputs, LabelData &trainingLabels,
+                           const vector<unsigned> *trainSamples, const RunningMetrics *running){
+    EpochMetrics metrics;
+    vector<double> input_v, label_v, output_v;
+    vector<double> input_t, label_t, output_t;
+
+    // Counting accuracy (first for train, then for validation set)
+    double accuracy_sum = 0;
+
+    if (running)
+    {
+        // Averages over the training passes of the epoch
+        metrics.trainLoss = running->samples > 0 ? running->loss / running->samples : 0.0;
+        metrics.trainAccuracy = running->samples > 0 ? double(running->correct) / running->samples : 0.0;
+        cout << "Train Loss (running): " << metrics.trainLoss << endl;
+        cout << "Train Accuracy (running): " << metrics.trainAccuracy << endl;
+    }
+    else if (trainSamples)
+    {
+        // Test the network on the fixed SUBSAMPLE of the training set
+        double avg_loss = 0;
+        for(unsigned index : *trainSamples)
+        {
+            const vector<double> &input = trainingInputs.getStoredTrain(index);
+            const vector<double> &label = trainingLabels.getStoredTrain(index);
+            myNet.feedForward(input);
+            myNet.getResults(output_t);
+            if (myNet.compare_result(output_t, label))
+            {
+                accuracy_sum++;
+            }
+            avg_loss += myNet.getLoss(label);
+        }
+        metrics.trainLoss = avg_loss / trainSamples->size();
+        metrics.trainAccuracy = accuracy_sum / trainSamples->size();
+        cout << "Train Loss (subsample): " << metrics.trainLoss << endl;
+        cout << "Train Accuracy (subsample): " << metrics.trainAccuracy << endl;
+    }
+    else
+    {
+        // Test the network on the TRAINING set to print loss and accuracy
+        double avg_loss = 0;
+        for(unsigned j = 0; j < trainingInputs.trainLength(); ++j)
+        {
+            input_t = trainingInputs.getNextTrain();
+            label_t = trainingLabels.getNextTrain();
+            myNet.feedForward(input_t);
+            myNet.getResults(output_t);
+            if (myNet.compare_result(output_t, label_t))
+            {
+                accuracy_sum++;
+            }
+            avg_loss += myNet.getLoss(label_t);
+        }
+        metrics.trainLoss = avg_loss / trainingInputs.trainLength();
+        metrics.trainAccuracy = accuracy_sum / trainingInputs.trainLength();
+        cout << "Train Loss: " << metrics.trainLoss << endl;
+        cout << "Train Accuracy: " << metrics.trainAccuracy << endl;
+    }
+
+    // Test the network on the VALIDATION set to print loss and accuracy
+    accuracy_sum = 0;
+    for(unsigned j = 0; j < trainingInputs.validLength(); ++j)
+    {
+        input_v = trainingInputs.getNextValid();
+        label_v = trainingLabels.getNextValid();
+        myNet.feedForward(input_v);
+        myNet.getResults(output_v);
+        if (myNet.compare_result(output_v, label_v))
+        {
+            accuracy_sum++;
+        }
+    }
+    metrics.validationAccuracy = accuracy_sum / trainingInputs.validLength();
+    cout << "Validation Accuracy: " << metrics.validationAccuracy << endl;
+    return metrics;
+}
+
+template <typename NetType>
+void trainNetwork(NetType &myNet, InputData &trainingInputs, LabelData &trainingLabels, unsigned numLayers, const TrainingOptions &options){
+    const unsigned batchSize = options.batchSize, seed = options.seed;
+
+    unsigned actual_batch_size; // Real size of the next batch (last batch can be smaller if dataset_size % batch_size != 0)
+    auto trainingStart = chrono::steady_clock::now();
+
+    LearningRateSchedule schedule(options.schedule, options.learningRate, options.epochs);
+    EarlyStopping earlyStopping(options.patience);
+    vector<double> bestState; // Weights of the best epoch so far (Net only)
+
+    // Asynchronous training, only supported by Net; the workers keep their replicas and shards across epochs
+    unique_ptr<HogwildTrainer> hogwild;
+    if constexpr (is_same_v<NetType, Net>)
+    {
+        if(options.hogwildThreads > 0)
+        {
+            hogwild = make_unique<HogwildTrainer>(myNet, trainingInputs, trainingLabels, batchSize,
+                                                  options.hogwildThreads, seed, options.numa);
+        }
+    }
+
+    // Fixed subsample of the training set the training metrics are measured on
+    vector<unsigned> trainSubset;
+    if(options.evalSubsample > 0)
+    {
+        trainSubset = sampleTrainSubset(trainingInputs.trainLength(), min(options.evalSubsample, trainingInputs.trainLength()), seed);
+    }
+    const string trainMetricsNote = options.runningMetrics ? " (running)" : options.evalSubsample > 0 ? " (subsample)" : "";
+    RunningMetrics running; // Sums of the training passes of the current epoch
+
+    // Evaluation of a snapshot of the weights while the next epoch trains (Net only)
+    unique_ptr<AsyncEvaluator> evaluator;
+    if constexpr (is_same_v<NetType, Net>)
+    {
+        if(options.asyncEvaluation && options.evaluate)
+        {
+            vector<unsigned> trainSamples;
+            if(!options.runningMetrics)
+            {
+                trainSamples = options.evalSubsample > 0 ? trainSubset : sampleTrainSubset(trainingInputs.trainLength(), trainingInputs.trainLength(), seed);
+            }
+            evaluator = make_unique<AsyncEvaluator>(myNet, trainingInputs, trainingLabels, trainSamples);
+        }
+    }
+    double evaluatedTrainSeconds = 0;
+    auto evaluatedEpochStart = trainingStart;
+    RunningMetrics evaluatedRunning;
+
+    // Print and log the metrics of the evaluation running in the background
+    auto collectEvaluation = [&]() {
+        EpochMetrics metrics;
+        chrono::steady_clock::time_point finishTime;
+        unsigned evaluatedEpoch;
+        {
+            PROFILE_SCOPE(Evaluate);
+            evaluatedEpoch = evaluator->wait(metrics, finishTime);
+        }
+        if(options.runningMetrics && evaluatedRunning.samples > 0)
+        {
+            metrics.trainLoss = evaluatedRunning.loss / evaluatedRunning.samples;
+            metrics.trainAccuracy = double(evaluatedRunning.correct) / evaluatedRunning.samples;
+        }
+        cout << "--------------------------------------------------" << endl;
+        cout << "Evaluation of epoch " << evaluatedEpoch + 1 << endl;
+        cout << "Train Loss" << trainMetricsNote << ": " << metrics.trainLoss << endl;
+        cout << "Train Accuracy" << trainMetricsNote << ": " << metrics.trainAccuracy << endl;
+        cout << "Validation Accuracy: " << metrics.validationAccuracy << endl;
+        cout << "Elapsed Time: " << chrono::duration<double>(finishTime - trainingStart).count() << " s" << endl;
+        if(options.metricsLog)
+        {
+            options.metricsLog->logEpoch(evaluatedEpoch, schedule.rate(evaluatedEpoch), metrics, trainingInputs.trainLength(),
+                                         evaluatedTrainSeconds, chrono::duration<double>(finishTime - evaluatedEpochStart).count());
+        }
+    };
+    PROFILE_ROW("setup", 0);
+
+    unsigned epoch = 0;
+    for(; epoch < options.epochs; ++epoch)
+    {
+        TraceScope traceEpoch("epoch", epoch + 1);
+        cout << "==================================================" << endl;
+        cout << "Epoch " << epoch + 1 << endl;
+
+        if(schedule.active())
+        {
+            myNet.setLearningRate(schedule.rate(epoch));
+            cout << "Learning Rate: " << schedule.rate(epoch) << endl;
+        }
+
+        // Shuffle the training data
+        {
+            PROFILE_SCOPE(Data);
+            trainingInputs.shuffleData(seed);
+            trainingLabels.shuffleData(seed);
+        }
+
+        // Set dropout (hidden layers only)
+        for(unsigned layerNum = 1; layerNum + 1 < numLayers; ++layerNum)
+        {
+            myNet.setDropout(layerNum, options.dropout);
+        }
+
+        auto epochStart = chrono::steady_clock::now(), intervalStart = epochStart;
+        double intervalLoss = 0;
+        unsigned intervalSamples = 0;
+        running = RunningMetrics();
+
+        if(hogwild)
+        {
+            PROFILE_SCOPE(Hogwild);
+            hogwild->trainEpoch(epoch);
+        }
+        else
+        {
+            for(unsigned batch = 0; batch < ceil(trainingInputs.trainLength() / batchSize); ++batch)
+            {
+                // cout << "--------------------------------------------------" << endl;
+                // cout << "Batch " << batch + 1 << endl;
+                actual_batch_size = trainingInputs.getNextBatchSize();
+                myNet.resetGradientSum();
+
+                const double loss = trainBatch(myNet, trainingInputs, trainingLabels, actual_batch_size,
+                                               options.runningMetrics ? &running : nullptr);
+
+                {
+                    PROFILE_SCOPE(Reduce);
+                    myNet.calcAvgGradient(actual_batch_size);
+                }
+                {
+                    PROFILE_SCOPE(Update);
+                    myNet.updateWeights();
+                }
+
+                intervalLoss += loss * actual_batch_size;
+                intervalSamples += actual_batch_size;
+                if(options.metricsLog && options.logInterval > 0 && (batch + 1) % options.logInterval == 0)
+                {
+                    auto now = chrono::steady_clock::now();
+                    options.metricsLog->logBatches(epoch, batch + 1, schedule.rate(epoch), intervalLoss / intervalSamples,
+                                                   intervalSamples, chrono::duration<double>(now - intervalStart).count());
+                    intervalStart = now;
+                    intervalLoss = 0;
+                    intervalSamples = 0;
+                }
+            }
+        }
+        const double trainSeconds = chrono::duration<double>(chrono::steady_clock::now() - epochStart).count();
+
+        // Unset dropout for all layers
+        for(unsigned layerNum = 0; layerNum < numLayers; ++layerNum)
+        {
+            myNet.setDropout(layerNum, 0.0);
+        }
+
+        double validationAccuracy = 0.0;
+        if(evaluator)
+        {
+            if(evaluator->busy())
+            {
+                collectEvaluation();
+            }
+            if constexpr (is_same_v<NetType, Net>)
+            {
+                evaluator->start(myNet, epoch);
+            }
+            evaluatedTrainSeconds = trainSeconds;
+            evaluatedEpochStart = epochStart;
+            evaluatedRunning = running;
+        }
+        else if(options.evaluate)
+        {
+            EpochMetrics metrics;
+            {
+                PROFILE_SCOPE(Evaluate);
+                TraceScope trace("evaluate", -1, true);
+                metrics = evaluateEpoch(myNet, trainingInputs, trainingLabels, options.evalSubsample > 0 ? &trainSubset : nullptr,
+                                        options.runningMetrics ? &running : nullptr);
+            }
+            validationAccuracy = metrics.validationAccuracy;
+            cout << "Elapsed Time: " << chrono::duration<double>(chrono::steady_clock::now() - trainingStart).count() << " s" << endl;
+            if(options.metricsLog)
+            {
+                options.metricsLog->logEpoch(epoch, schedule.rate(epoch), metrics, trainingInputs.trainLength(), trainSeconds,
+                                             chrono::duration<double>(chrono::steady_clock::now() - epochStart).count());
+            }
+        }
+        PROFILE_ROW(to_string(epoch + 1), trainingInputs.trainLength());
+        if(!schedule.needsAccuracy() && !earlyStopping.enabled())
+        {
+            continue;
+        }
+
+        if constexpr (is_same_v<NetType, Net>)
+        {
+            // Only the first process of a group evaluates, the others take its accuracy
+            if(ProcessGroup *group = myNet.getProcessGroup())
+            {
+                group->allreduce(&validationAccuracy, 1);
+            }
+        }
+        schedule.report(validationAccuracy);
+        if(earlyStopping.report(epoch, validationAccuracy))
+        {
+            if constexpr (is_same_v<NetType, Net>)
+            {
+                if(earlyStopping.enabled())
+                {
+                    bestState.resize(myNet.stateSize());
+                    myNet.saveState(bestState.data());
+                }
+            }
+        }
+        if(earlyStopping.shouldStop())
+        {
+            cout << "Early stopping: no improvement for " << options.patience << " epochs" << endl;
+            ++epoch;
+            break;
+        }
+    }
+
+    if(evaluator && evaluator->busy())
+    {
+        collectEvaluation();
+    }
+
+    // Continue from the best epoch
+    if(earlyStopping.enabled() && earlyStopping.bestEpoch() + 1 < epoch)
+    {
+        if constexpr (is_same_v<NetType, Net>)
+        {
+            myNet.loadState(bestState.data());
+            cout << "Restored the weights of epoch " << earlyStopping.bestEpoch() + 1
+                 << " (Validation Accuracy: " << earlyStopping.bestAccuracy() << ")" << endl;
+        }
+    }
+    cout << "Done training" << endl;
+}
+
+void pruneNetwork(Net &myNet, InputData &inputs, LabelData &labels, double sparsity, unsigned rounds,
+                  unsigned fineTuneEpochs, const TrainingOptions &options){
+    // Fine-tuning continues at the learning rate training ended with, without early stopping or a log
+    TrainingOptions fineTune = options;
+    fineTune.epochs = fineTuneEpochs;
+    fineTune.schedule = ScheduleOptions();
+    fineTune.patience = 0;
+    fineTune.metricsLog = nullptr;
+
+    const unsigned numLayers = myNet.getTopology().size();
+    for(unsigned round = 1; round <= rounds; ++round)
+    {
+        cout << "==================================================" << endl;
+        myNet.prune(sparsity * round / rounds);
+        cout << "Pruning round " << round << " of " << rounds << ", sparsity per layer:";
+        for(unsigned layerNum = 0; layerNum + 1 < numLayers; ++layerNum)
+        {
+            cout << " " << myNet.sparsity(layerNum);
+        }
+        cout << endl;
+        if(fineTuneEpochs > 0)
+        {
+            trainNetwork(myNet, inputs, labels, numLayers, fineTune);
+        }
+    }
+}
+
+template <typename NetType>
+void testNetwork(NetType &myNet, InputData &trainingInputs, InputData &testingInputs){
+    cout << "--------------------------------------------------" << endl;
+    cout << "Begin testing" << endl;
+
+    {
+        PROFILE_SCOPE(Test);
+        TraceScope trace("test", -1, true);
+
+        // Test on the TRAIN subset and save the predictions
+        testAndSavePredictions(myNet, trainingInputs, "train_predictions.csv");
+
+        // Test on the TEST subset and save the predictions
+        testAndSavePredictions(myNet, testingInputs, "test_predictions.csv");
+    }
+
+    // Test on the test subset and print the accuracy
+    // TODO Before submitting: comment out
+    // testAndPrintAccuracy(myNet, testingInputs, testingLabels, "Testing");
+
+    cout << "Done testing" << endl;
+
+    PROFILE_ROW("test", 0);
+    PROFILE_REPORT(cout);
+    if(PerfCounters::instance().counting())
+    {
+        PerfCounters::instance().print(cout);
+    }
+}
+
 int main(int argc, char *argv[]){
     // feenableexcept(FE_ALL_EXCEPT);
-    unsigned epochs = 1;
+    TrainingOptions options;
     bool epochsSet = false;
-    unsigned batchSize = 1;
     bool batchSizeSet = false;
     double learningRate = 0.01;
     bool learningRateSet = false;
+    bool quantize = false;
+    bool mixedPrecision = false;
+    double pruneSparsity = 0.0;
+    unsigned pruneRounds = 3;
+    unsigned fineTuneEpochs = 1;
+    string sparseModelFile;
+    bool reference = false;
+    bool hugePages = false;
+    unsigned processes = 1;
+    unsigned members = 1;
+    unsigned pipelineStages = 0;
+    unsigned microBatches = 4;
+    string sweepFile;
+    string metricsFile;
+    string traceFile;
+    bool counters = false;
+    unsigned sweepJobs = max(thread::hardware_concurrency(), 1u);
+    Activation activation = Activation::ReLU;
+    Optimizer optimizer = Optimizer::RMSProp;
 
     struct option long_options[] = {
         {"epochs", required_argument, nullptr, 'e'},
         {"learning_rate", required_argument, nullptr, 'l'},
         {"batch_size", required_argument, nullptr, 'b'},
+        {"quantize", no_argument, nullptr, 'q'},
+        {"bf16", no_argument, nullptr, 'F'},
+        {"prune", required_argument, nullptr, 'k'},
+        {"prune_rounds", required_argument, nullptr, 'K'},
+        {"fine_tune", required_argument, nullptr, 'i'},
+        {"sparse_model", required_argument, nullptr, 'O'},
+        {"fast_math", no_argument, nullptr, 'f'},
+        {"activation", required_argument, nullptr, 'a'},
+        {"optimizer", required_argument, nullptr, 'o'},
+        {"reference", no_argument, nullptr, 'r'},
+        {"dropout", required_argument, nullptr, 'd'},
+        {"huge_pages", no_argument, nullptr, 'H'},
+        {"hogwild", required_argument, nullptr, 'w'},
+        {"processes", required_argument, nullptr, 'n'},
+        {"numa", required_argument, nullptr, 'N'},
+        {"pipeline", required_argument, nullptr, 'p'},
+        {"micro_batches", required_argument, nullptr, 'm'},
+        {"ensemble", required_argument, nullptr, 'E'},
+        {"schedule", required_argument, nullptr, 's'},
+        {"warmup", required_argument, nullptr, 'W'},
+        {"decay_epochs", required_argument, nullptr, 't'},
+        {"decay_factor", required_argument, nullptr, 'g'},
+        {"patience", required_argument, nullptr, 'P'},
+        {"metrics", required_argument, nullptr, 'M'},
+        {"log_interval", required_argument, nullptr, 'I'},
+        {"trace", required_argument, nullptr, 'T'},
+        {"counters", no_argument, nullptr, 'C'},
+        {"async_eval", no_argument, nullptr, 'A'},
+        {"running_metrics", no_argument, nullptr, 'R'},
+        {"eval_subsample", required_argument, nullptr, 'u'},
+        {"sweep", required_argument, nullptr, 'S'},
+        {"jobs", required_argument, nullptr, 'j'},
         {nullptr, 0, nullptr, 0}
     };
 
     int option_index = 0;
     int c;
-    while ((c = getopt_long(argc, argv, "e:l:b:", long_options, &option_index)) != -1) {
+    while ((c = getopt_long(argc, argv, "e:l:b:qFk:K:i:O:fa:o:rd:Hw:n:N:p:m:E:s:W:t:g:P:M:I:T:CARu:S:j:", long_options, &option_index)) != -1) {
         switch (c) {
             case 'e':
-                epochs = std::atoi(optarg);
+                options.epochs = std::atoi(optarg);
                 epochsSet = true;
                 break;
             case 'l':
@@ -104,9 +862,141 @@ int main(int argc, char *argv[]){
                 learningRateSet = true;
                 break;
             case 'b':
-                batchSize = std::atoi(optarg);
+                options.batchSize = std::atoi(optarg);
                 batchSizeSet = true;
                 break;
+            case 'q':
+                quantize = true;
+                break;
+            case 'F':
+                mixedPrecision = true;
+                break;
+            case 'k':
+                pruneSparsity = std::atof(optarg);
+                if(pruneSparsity <= 0.0 || pruneSparsity >= 1.0){
+                    std::cerr << "Pruned fraction must be in (0, 1)" << std::endl;
+                    return 1;
+                }
+                break;
+            case 'K':
+                pruneRounds = std::atoi(optarg);
+                if(pruneRounds < 1){
+                    std::cerr << "Number of pruning rounds must be at least 1" << std::endl;
+                    return 1;
+                }
+                break;
+            case 'i':
+                fineTuneEpochs = std::atoi(optarg);
+                break;
+            case 'O':
+                sparseModelFile = optarg;
+                break;
+            case 'f':
+                setFastMath(true);
+                break;
+            case 'a':
+                activation = parseActivation(optarg);
+                break;
+            case 'o':
+                optimizer = parseOptimizer(optarg);
+                break;
+            case 'r':
+                reference = true;
+                break;
+            case 'd':
+                options.dropout = std::atof(optarg);
+                if(options.dropout < 0.0 || options.dropout >= 1.0){
+                    std::cerr << "Dropout probability must be in [0, 1)" << std::endl;
+                    return 1;
+                }
+                break;
+            case 'H':
+                hugePages = true;
+                break;
+            case 'w':
+                options.hogwildThreads = std::atoi(optarg);
+                break;
+            case 'n':
+                processes = std::atoi(optarg);
+                if(processes < 1){
+                    std::cerr << "Number of processes must be at least 1" << std::endl;
+                    return 1;
+                }
+                break;
+            case 'N':
+                options.numa = parseNumaPlacement(optarg);
+                break;
+            case 'p':
+                pipelineStages = std::atoi(optarg);
+                break;
+            case 'E':
+                members = std::atoi(optarg);
+                if(members < 1){
+                    std::cerr << "Number of ensemble members must be at least 1" << std::endl;
+                    return 1;
+                }
+                break;
+            case 's':
+                options.schedule.kind = parseSchedule(optarg);
+                break;
+            case 'W':
+                options.schedule.warmupEpochs = std::atoi(optarg);
+                break;
+            case 't':
+                options.schedule.decayEpochs = std::atoi(optarg);
+                if(options.schedule.decayEpochs < 1){
+                    std::cerr << "Number of decay epochs must be at least 1" << std::endl;
+                    return 1;
+                }
+                break;
+            case 'g':
+                options.schedule.decayFactor = std::atof(optarg);
+                if(options.schedule.decayFactor <= 0.0 || options.schedule.decayFactor > 1.0){
+                    std::cerr << "Decay factor must be in (0, 1]" << std::endl;
+                    return 1;
+                }
+                break;
+            case 'P':
+                options.patience = std::atoi(optarg);
+                break;
+            case 'M':
+                metricsFile = optarg;
+                break;
+            case 'I':
+                options.logInterval = std::atoi(optarg);
+                break;
+            case 'T':
+                traceFile = optarg;
+                break;
+            case 'C':
+                counters = true;
+                break;
+            case 'A':
+                options.asyncEvaluation = true;
+                break;
+            case 'R':
+                options.runningMetrics = true;
+                break;
+            case 'u':
+                options.evalSubsample = std::atoi(optarg);
+                if(options.evalSubsample < 1){
+                    std::cerr << "Evaluation subsample must have at least 1 sample" << std::endl;
+                    return 1;
+                }
+                break;
+            case 'S':
+                sweepFile = optarg;
+                break;
+            case 'j':
+                sweepJobs = std::atoi(optarg);
+                break;
+            case 'm':
+                microBatches = std::atoi(optarg);
+                if(microBatches < 1){
+                    std::cerr << "Number of micro-batches must be at least 1" << std::endl;
+                    return 1;
+                }
+                break;
             case '?':
                 std::cerr << "Unknown option or missing argument value" << std::endl;
                 usage();
@@ -118,128 +1008,280 @@ int main(int argc, char *argv[]){
         }
     }
 
-    if(!epochsSet || !learningRateSet || !batchSizeSet){
+    // In a sweep the options and the topology are only defaults of the configurations
+    if(sweepFile.empty() && (!epochsSet || !learningRateSet || !batchSizeSet)){
         usage();
         return 1;
     }
 
-    if (argc - optind < 3)
+    if(options.numa != NumaPlacement::None && options.hogwildThreads == 0){
+        std::cerr << "NUMA placement only applies to Hogwild training (-w)" << std::endl;
+        return 1;
+    }
+
+    if(options.asyncEvaluation && (options.patience > 0 || options.schedule.kind == ScheduleKind::Plateau)){
+        std::cerr << "Asynchronous evaluation cannot be combined with early stopping or the plateau schedule" << std::endl;
+        return 1;
+    }
+
+    if(options.runningMetrics && options.evalSubsample > 0){
+        std::cerr << "Running metrics (-R) and an evaluation subsample (-u) exclude each other" << std::endl;
+        return 1;
+    }
+
+    if(options.runningMetrics && options.hogwildThreads > 0){
+        std::cerr << "Running metrics are not collected by the Hogwild workers" << std::endl;
+        return 1;
+    }
+
+    if(options.runningMetrics && processes > 1){
+        std::cerr << "Running metrics are not collected across the processes of a group" << std::endl;
+        return 1;
+    }
+
+    if(mixedPrecision && (members > 1 || activation != Activation::ReLU || options.dropout > 0.0 ||
+                          options.hogwildThreads > 0 || processes > 1 || options.patience > 0 ||
+                          options.schedule.kind == ScheduleKind::Plateau)){
+        std::cerr << "Mixed precision only supports single ReLU networks trained without dropout, Hogwild, multiple processes, early stopping or the plateau schedule" << std::endl;
+        return 1;
+    }
+
+    if(pruneSparsity > 0.0 && (members > 1 || activation != Activation::ReLU || options.hogwildThreads > 0 || mixedPrecision)){
+        std::cerr << "Pruning only supports single ReLU networks trained without Hogwild or mixed precision" << std::endl;
+        return 1;
+    }
+
+    if(!sparseModelFile.empty() && pruneSparsity == 0.0){
+        std::cerr << "A sparse model file (-O) needs pruning (-k)" << std::endl;
+        return 1;
+    }
+
+    if(members > 1 && quantize){
+        std::cerr << "Quantization does not support ensembles" << std::endl;
+        return 1;
+    }
+
+    // A sweep does not need a default topology if every configuration has its own
+    const bool noTopology = !sweepFile.empty() && argc == optind;
+    if (argc - optind < 3 && !noTopology)
     {
         usage();
         return 1;
     }
     vector<unsigned> topology = parseTopology(argc - optind, &(argv[optind]));
 
-    Neuron::setLearningRate(learningRate);
+    vector<SweepConfig> sweep;
+    if(!sweepFile.empty())
+    {
+        SweepConfig defaults;
+        defaults.topology = topology;
+        defaults.learningRate = learningRate;
+        defaults.batchSize = options.batchSize;
+        defaults.epochs = options.epochs;
+        defaults.optimizer = optimizer;
+        defaults.activation = activation;
+        defaults.dropout = options.dropout;
+        defaults.seed = options.seed;
+        try
+        {
+            sweep = readSweep(sweepFile, defaults);
+        }
+        catch(const exception &error)
+        {
+            std::cerr << error.what() << std::endl;
+            return 1;
+        }
+    }
 
     // unsigned seed = static_cast<unsigned>(time(nullptr));
-    unsigned seed = 42;
+    unsigned seed = options.seed;
+    seedThreadGenerator(seed);
+    options.learningRate = learningRate;
+
+    // Timeline of the run, written when main returns (after the pipeline threads have stopped)
+    TraceFile trace(traceFile);
 
-    Net myNet(topology, seed);
+    // Hardware counters of the main thread, per phase; the run goes on without them
+    if(counters)
+    {
+        string reason = PerfCounters::instance().start();
+        if(!reason.empty())
+        {
+            cerr << "Hardware counters unavailable: " << reason << endl;
+        }
+    }
 
-    InputData trainingInputs("./data/fashion_mnist_train_vectors.csv", 255.0, batchSize);
+    InputData trainingInputs("./data/fashion_mnist_train_vectors.csv", 255.0, options.batchSize);
     LabelData trainingLabels("./data/fashion_mnist_train_labels.csv", 10, false);
-    InputData testingInputs("./data/fashion_mnist_test_vectors.csv", 255.0, batchSize);
+    InputData testingInputs("./data/fashion_mnist_test_vectors.csv", 255.0, options.batchSize);
     // LabelData testingLabels("./data/fashion_mnist_test_labels.csv", 10, false); // TODO Before submitting: comment out
 
     // split into training and validation data
     trainingInputs.splitData(0.8);
     trainingLabels.splitData(0.8);
 
-    vector<double> input, label, output;
-    vector<double> input_v, label_v, output_v;
-    vector<double> input_t, label_t, output_t;
-
-    unsigned actual_batch_size; // Real size of the next batch (last batch can be smaller if dataset_size % batch_size != 0)
-    for(unsigned epoch = 0; epoch < epochs; ++epoch)
+    // All configurations of a sweep share the dataset loaded above
+    if(!sweepFile.empty())
     {
-        cout << "==================================================" << endl;
-        cout << "Epoch " << epoch + 1 << endl;
-
-        // Shuffle the training data
-        trainingInputs.shuffleData(seed);
-        trainingLabels.shuffleData(seed);
+        cout << "Training " << sweep.size() << " configurations, " << sweepJobs << " at a time" << endl;
+        try
+        {
+            printSweep(runSweep(sweep, trainingInputs, trainingLabels, sweepJobs));
+        }
+        catch(const exception &error)
+        {
+            std::cerr << error.what() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
 
-        // Set dropout (hidden layers only)
-        // myNet.setDropout(1, 0.5);
-        // myNet.setDropout(2, 0.05);
+    // Machine-readable metrics of every epoch
+    unique_ptr<MetricsLog> metricsLog;
+    if(!metricsFile.empty())
+    {
+        metricsLog = make_unique<MetricsLog>(metricsFile, topology, members);
+        options.metricsLog = metricsLog.get();
+    }
 
-        for(unsigned batch = 0; batch < ceil(trainingInputs.trainLength() / batchSize); ++batch)
+    // The original per-neuron implementation, for comparison
+    if(reference)
+    {
+        if(activation != Activation::ReLU || optimizer != Optimizer::RMSProp || quantize || options.hogwildThreads > 0 ||
+           processes > 1 || pipelineStages > 0 || members > 1 || options.patience > 0 || options.asyncEvaluation || mixedPrecision ||
+           pruneSparsity > 0.0)
         {
-            // cout << "--------------------------------------------------" << endl;
-            // cout << "Batch " << batch + 1 << endl;
-            actual_batch_size = trainingInputs.getNextBatchSize();
-            myNet.resetGradientSum();
+            cerr << "The reference network supports neither other activations or optimizers, quantization, mixed precision, pruning, Hogwild, multi-process, pipelined, ensemble training, early stopping nor asynchronous evaluation" << endl;
+            return 1;
+        }
+        ReferenceNet::setLearningRate(learningRate);
+        ReferenceNet myNet(topology, seed);
+        trainNetwork(myNet, trainingInputs, trainingLabels, topology.size(), options);
+        testNetwork(myNet, trainingInputs, testingInputs);
+        return 0;
+    }
 
-            for (unsigned i = 0; i < actual_batch_size; i++)
-            {
-                // cout << "Epoch : Batch : Sample -> " << epoch + 1 << " : " << batch + 1 << " : " << i + 1 << endl;
-                input = trainingInputs.getNextTrain();
-                label = trainingLabels.getNextTrain();
+    // Use the network specialized at compile time if the topology matches, the dynamic one otherwise
+#ifdef STATIC_TOPOLOGY
+    if(topology == ProductionNet::topology() && activation == Activation::ReLU && optimizer == Optimizer::RMSProp &&
+       options.dropout == 0.0 &&
+       options.hogwildThreads == 0 && processes == 1 && pipelineStages == 0 && members == 1 &&
+       options.patience == 0 && !options.asyncEvaluation && !mixedPrecision && pruneSparsity == 0.0 && !quantize)
+    {
+        cout << "Using network specialized at compile time for this topology" << endl;
+        ProductionNet::setLearningRate(learningRate);
+        auto myNet = make_unique<ProductionNet>(seed);
+        trainNetwork(*myNet, trainingInputs, trainingLabels, topology.size(), options);
+        testNetwork(*myNet, trainingInputs, testingInputs);
+        return 0;
+    }
+#endif
 
-                myNet.feedForward(input);
-                myNet.getResults(output);
-                myNet.backProp(label);
-            }
+    Net myNet(topology, seed, activation, hugePages, members);
+    myNet.setLearningRate(learningRate);
+    myNet.setOptimizer(optimizer);
+    myNet.reserveRows(options.batchSize);
 
-            myNet.calcAvgGradient(actual_batch_size);
-            myNet.updateWeights();
+    // Data-parallel training: every process holds the same weights and trains on its share of each batch
+    unique_ptr<ProcessGroup> group;
+    if(processes > 1)
+    {
+        if(options.hogwildThreads > 0)
+        {
+            cerr << "Multi-process training cannot be combined with Hogwild training" << endl;
+            return 1;
         }
-
-        // Unset dropout for all layers
-        for(unsigned layerNum = 0; layerNum < topology.size(); ++layerNum)
+        try
         {
-            myNet.setDropout(layerNum, 0.0);
+            group.reset(ProcessGroup::launch(processes, myNet.gradientSize()));
         }
+        catch(const exception &error)
+        {
+            std::cerr << error.what() << std::endl;
+            return 1;
+        }
+        myNet.setProcessGroup(group.get());
+        if(group->rank() > 0)
+        {
+            // Only rank 0 reports and writes predictions
+            cout.setstate(ios::failbit);
+            seedThreadGenerator(seed, group->rank());
+            options.evaluate = false;
+            options.metricsLog = nullptr;
+            trace.discard();
+            PerfCounters::instance().stop();
+        }
+    }
 
-        // Counting accuracy (first for train, then for validation set)
-        double accuracy_sum = 0;
-
-        // Test the network on the TRAINING set to print loss and accuracy
-        double avg_loss = 0;
-        for(unsigned j = 0; j < trainingInputs.trainLength(); ++j)
+    // Pipeline-parallel training: the layers are split into stages running on their own threads
+    // (started after forking, the processes of a group each run their own pipeline)
+    unique_ptr<Pipeline> pipeline;
+    if(pipelineStages > 0)
+    {
+        if(options.hogwildThreads > 0)
         {
-            input_t = trainingInputs.getNextTrain();
-            label_t = trainingLabels.getNextTrain();
-            myNet.feedForward(input_t);
-            myNet.getResults(output_t);
-            if (myNet.compare_result(output_t, label_t))
+            cerr << "Pipelined training cannot be combined with Hogwild training" << endl;
+            return 1;
+        }
+        pipeline = make_unique<Pipeline>(myNet, pipelineStages, microBatches, seed);
+        myNet.setPipeline(pipeline.get());
+        cout << "Pipeline stages:";
+        for(unsigned stage = 0; stage < pipeline->stages(); ++stage)
+        {
+            cout << " [";
+            for(unsigned layer = pipeline->firstLayer(stage); layer < pipeline->firstLayer(stage + 1); ++layer)
             {
-                accuracy_sum++;
+                cout << (layer > pipeline->firstLayer(stage) ? ", " : "") << myNet.getLayers()[layer]->name();
             }
-            avg_loss += myNet.getLoss(label_t);
+            cout << "]";
         }
-        cout << "Train Loss: " << avg_loss / trainingInputs.trainLength() << endl;
-        cout << "Train Accuracy: " << accuracy_sum / trainingInputs.trainLength() << endl;
+        cout << endl;
+    }
 
-        // Test the network on the VALIDATION set to print loss and accuracy
-        accuracy_sum = 0;
-        for(unsigned j = 0; j < trainingInputs.validLength(); ++j)
+    // Copy of the initial weights, trained in mixed precision after the network for comparison
+    unique_ptr<Bf16Net> mixedNet;
+    if(mixedPrecision)
+    {
+        mixedNet = make_unique<Bf16Net>(myNet);
+    }
+
+    // A process of the group that dies stops the training of the others
+    try
+    {
+        trainNetwork(myNet, trainingInputs, trainingLabels, topology.size(), options);
+        if(pruneSparsity > 0.0)
         {
-            input_v = trainingInputs.getNextValid();
-            label_v = trainingLabels.getNextValid();
-            myNet.feedForward(input_v);
-            myNet.getResults(output_v);
-            if (myNet.compare_result(output_v, label_v))
-            {
-                accuracy_sum++;
-            }
+            // Every process of a group prunes the same weights and fine-tunes with the others
+            pruneNetwork(myNet, trainingInputs, trainingLabels, pruneSparsity, pruneRounds, fineTuneEpochs, options);
         }
-        cout << "Validation Accuracy: " << accuracy_sum / trainingInputs.validLength() << endl;
     }
-    cout << "Done training" << endl;
-    cout << "--------------------------------------------------" << endl;
-    cout << "Begin testing" << endl;
+    catch(const exception &error)
+    {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
+    if(group && group->rank() > 0)
+    {
+        return 0;
+    }
 
-    // Test on the TRAIN subset and save the predictions
-    testAndSavePredictions(myNet, trainingInputs, "train_predictions.csv");
+    if(pruneSparsity > 0.0)
+    {
+        cout << "--------------------------------------------------" << endl;
+        compareSparse(myNet, trainingInputs, trainingLabels, sparseModelFile);
+    }
 
-    // Test on the TEST subset and save the predictions
-    testAndSavePredictions(myNet, testingInputs, "test_predictions.csv");
+    if(quantize)
+    {
+        cout << "--------------------------------------------------" << endl;
+        compareQuantized(myNet, trainingInputs, trainingLabels);
+    }
 
-    // Test on the test subset and print the accuracy
-    // TODO Before submitting: comment out
-    // testAndPrintAccuracy(myNet, testingInputs, testingLabels, "Testing");
+    if(mixedNet)
+    {
+        cout << "--------------------------------------------------" << endl;
+        compareMixedPrecision(myNet, *mixedNet, trainingInputs, trainingLabels, options);
+    }
 
-    cout << "Done testing" << endl;
+    testNetwork(myNet, trainingInputs, testingInputs);
 }
@@ -2,12 +2,150 @@
  * @file main.hpp
  * @brief Declaration of the main functions for training and testing the neural network.
  */
+#ifndef MAIN_HPP
+#define MAIN_HPP
 
 #include <getopt.h>
 #include <iostream>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <numeric>
+#include <random>
 #include "net.hpp"
+#include "reference_net.hpp"
 #include "input_data.hpp"
 #include "label_data.hpp"
+#include "quantized_net.hpp"
+#include "bf16_net.hpp"
+#include "sparse_net.hpp"
+#include "fast_math.hpp"
+#include "random.hpp"
+#include "hogwild.hpp"
+#include "process_group.hpp"
+#include "pipeline.hpp"
+#include "sweep.hpp"
+#include "schedule.hpp"
+#include "profiler.hpp"
+#include "metrics_log.hpp"
+#include "tracer.hpp"
+#include "evaluator.hpp"
+#ifdef STATIC_TOPOLOGY
+#include "static_net.hpp"
+
+/**
+ * @brief Network specialized for the production topology given at compile time,
+ * e.g. `-DSTATIC_TOPOLOGY=784,64,32,10`.
+ */
+typedef StaticNet<STATIC_TOPOLOGY> ProductionNet;
+#endif
+
+/**
+ * @struct RunningMetrics
+ * @brief Loss and correct predictions summed over the training passes of an epoch.
+ */
+struct RunningMetrics
+{
+    /**
+     * @brief Summed loss of the samples.
+     */
+    double loss = 0.0;
+
+    /**
+     * @brief Number of correctly predicted samples.
+     */
+    unsigned correct = 0;
+
+    /**
+     * @brief Number of samples.
+     */
+    unsigned samples = 0;
+};
+
+/**
+ * @struct TrainingOptions
+ * @brief Settings of a training run given on the command line.
+ */
+struct TrainingOptions
+{
+    /**
+     * @brief Number of epochs.
+     */
+    unsigned epochs = 1;
+
+    /**
+     * @brief Size of the mini-batches (of all processes together).
+     */
+    unsigned batchSize = 1;
+
+    /**
+     * @brief Initial learning rate.
+     */
+    double learningRate = 0.01;
+
+    /**
+     * @brief How the learning rate changes over the epochs.
+     */
+    ScheduleOptions schedule;
+
+    /**
+     * @brief Epochs without improvement of the validation accuracy before stopping, 0 to train all epochs (Net only).
+     */
+    unsigned patience = 0;
+
+    /**
+     * @brief Seed used for shuffling the training data.
+     */
+    unsigned seed = 42;
+
+    /**
+     * @brief Dropout probability of the hidden layers during training.
+     */
+    double dropout = 0.0;
+
+    /**
+     * @brief Number of threads for asynchronous training (Net only), 0 for synchronous training.
+     */
+    unsigned hogwildThreads = 0;
+
+    /**
+     * @brief Placement of the Hogwild workers and their memory on the NUMA nodes.
+     */
+    NumaPlacement numa = NumaPlacement::None;
+
+    /**
+     * @brief Whether to print loss and accuracy after each epoch (only one process of a group does).
+     */
+    bool evaluate = true;
+
+    /**
+     * @brief Whether to evaluate every epoch on a snapshot of the weights on a background thread
+     * while the next epoch trains (Net only; not with a plateau schedule or early stopping).
+     */
+    bool asyncEvaluation = false;
+
+    /**
+     * @brief Whether the training loss and accuracy are the running averages of the training
+     * passes of the epoch instead of a pass over the training set after it (not with Hogwild).
+     */
+    bool runningMetrics = false;
+
+    /**
+     * @brief Number of training samples of the fixed random subsample the training loss and
+     * accuracy are measured on after every epoch, 0 for the whole training set.
+     */
+    unsigned evalSubsample = 0;
+
+    /**
+     * @brief Log of the metrics of every epoch, nullptr for none.
+     */
+    MetricsLog *metricsLog = nullptr;
+
+    /**
+     * @brief Number of batches between the batch lines of the metrics log, 0 for epoch lines only.
+     */
+    unsigned logInterval = 0;
+};
 
 /**
  * @brief Parse strings in `neurons_per_layer` as the number of neurons in the network layers,
@@ -28,11 +166,12 @@ void usage();
 /**
  * @brief Test the network and save predictions to a file.
  * 
- * @param myNet The neural network.
+ * @param myNet The neural network (Net, ReferenceNet or a StaticNet specialization).
  * @param inputs The input data for testing.
  * @param output_filepath The filepath to save the predictions.
  */
-void testAndSavePredictions(Net &myNet, InputData &inputs, string output_filepath);
+template <typename NetType>
+void testAndSavePredictions(NetType &myNet, InputData &inputs, string output_filepath);
 
 /**
  * @brief Test the network on a dataset and print accuracy.
@@ -42,7 +181,156 @@ void testAndSavePredictions(Net &myNet, InputData &inputs, string output_filepat
  * @param labels The labels for testing.
  * @param subsetName The name of the dataset subset (e.g., "Training", "Testing").
  */
-void testAndPrintAccuracy(Net &myNet, InputData &inputs, LabelData &labels, string subsetName);
+template <typename NetType>
+void testAndPrintAccuracy(NetType &myNet, InputData &inputs, LabelData &labels, string subsetName);
+
+/**
+ * @brief Feed a mini-batch through the network and accumulate its gradients, one sample at a time.
+ *
+ * @param myNet The neural network (ReferenceNet or a StaticNet specialization).
+ * @param trainingInputs The input data, positioned at the start of the batch.
+ * @param trainingLabels The labels, positioned at the start of the batch.
+ * @param batchSize Number of samples in the batch.
+ * @param running Sums the loss and the correct predictions of the samples are added to, nullptr for none.
+ * @return Average loss of the samples.
+ */
+template <typename NetType>
+double trainBatch(NetType &myNet, InputData &trainingInputs, LabelData &trainingLabels, unsigned batchSize,
+                  RunningMetrics *running = nullptr);
+
+/**
+ * @brief Feed a mini-batch through the network and accumulate its gradients, all samples at once.
+ *
+ * With a process group each process takes its own contiguous share of the batch rows,
+ * while the data cursors advance over the whole batch in every process. With a pipeline
+ * (see Net::setPipeline()) the batch streams through the layer stages in micro-batches.
+ *
+ * @param myNet The neural network.
+ * @param trainingInputs The input data, positioned at the start of the batch.
+ * @param trainingLabels The labels, positioned at the start of the batch.
+ * @param batchSize Number of samples in the batch.
+ * @param running Sums the loss and the correct predictions of the samples this process trained on
+ * are added to, nullptr for none.
+ * @return Average loss of the samples this process trained on.
+ */
+double trainBatch(Net &myNet, InputData &trainingInputs, LabelData &trainingLabels, unsigned batchSize,
+                  RunningMetrics *running = nullptr);
+
+/**
+ * @brief Draw a fixed random subsample of the training set.
+ *
+ * @param trainLength Number of training samples.
+ * @param count Size of the subsample, at most trainLength.
+ * @param seed Seed of the draw.
+ * @return Stored indices of the samples (see InputData::getStoredTrain()), in ascending order.
+ */
+vector<unsigned> sampleTrainSubset(unsigned trainLength, unsigned count, unsigned seed);
+
+/**
+ * @brief Print loss and accuracy of the network on the training set and its accuracy on the validation set.
+ *
+ * The training loss and accuracy come from the running sums of the epoch if given, else from
+ * a pass over the training subsample if given, else from a pass over the whole training set.
+ *
+ * @param myNet The neural network (Net, ReferenceNet or a StaticNet specialization).
+ * @param trainingInputs The input data, split into training and validation sets.
+ * @param trainingLabels The labels, split into training and validation sets.
+ * @param trainSamples Stored indices of the training subsample, nullptr for the whole training set.
+ * @param running Running sums of the training passes of the epoch, nullptr to measure.
+ * @return Loss and accuracies.
+ */
+template <typename NetType>
+EpochMetrics evaluateEpoch(NetType &myNet, InputData &trainingInputs, LabelData &trainingLabels,
+                           const vector<unsigned> *trainSamples = nullptr, const RunningMetrics *running = nullptr);
+
+/**
+ * @brief Train the network for a given number of epochs, printing loss and accuracy after each one.
+ *
+ * The learning rate of every epoch is set by the schedule of the options. With asynchronous
+ * evaluation, the metrics of an epoch are printed once the next one has trained. With a patience,
+ * training stops once the validation accuracy has not improved for that many epochs and
+ * the weights of the best epoch are restored (Net only). The processes of a group follow
+ * the validation accuracy measured by the first one.
+ *
+ * @param myNet The neural network (Net, ReferenceNet or a StaticNet specialization).
+ * @param trainingInputs The input data, split into training and validation sets.
+ * @param trainingLabels The labels, split into training and validation sets.
+ * @param numLayers Number of layers in the network topology.
+ * @param options Epochs, batch size, seed, dropout, learning rate schedule, early stopping, the training mode and the worker placement.
+ */
+template <typename NetType>
+void trainNetwork(NetType &myNet, InputData &trainingInputs, LabelData &trainingLabels, unsigned numLayers, const TrainingOptions &options);
+
+/**
+ * @brief Save the predictions of the trained network for the training and testing sets.
+ *
+ * @param myNet The neural network (Net, ReferenceNet or a StaticNet specialization).
+ * @param trainingInputs The training input data.
+ * @param testingInputs The testing input data.
+ */
+template <typename NetType>
+void testNetwork(NetType &myNet, InputData &trainingInputs, InputData &testingInputs);
+
+/**
+ * @brief Quantize the trained network to int8 and compare it with the float model on the validation set.
+ *
+ * Prints validation accuracy, throughput and weight memory of both models.
+ *
+ * @param myNet The trained neural network.
+ * @param inputs The input data, split into training and validation sets.
+ * @param labels The labels, split into training and validation sets.
+ */
+void compareQuantized(Net &myNet, InputData &inputs, LabelData &labels);
+
+/**
+ * @brief Train the mixed-precision copy of a network like the network itself was trained and
+ * compare both on the validation set.
+ *
+ * The copy sees the same batches in the same order (shuffled like InputData::shuffleData())
+ * with the same learning rate schedule. Prints its running training loss and validation
+ * accuracy per epoch, then validation accuracy, agreement of the predictions, throughput
+ * and weight memory of both models.
+ *
+ * @param myNet The trained neural network.
+ * @param mixedNet Copy of the network taken before training.
+ * @param inputs The input data, split into training and validation sets.
+ * @param labels The labels, split into training and validation sets.
+ * @param options Epochs, batch size, seed and learning rate schedule the network was trained with.
+ */
+void compareMixedPrecision(Net &myNet, Bf16Net &mixedNet, InputData &inputs, LabelData &labels,
+                           const TrainingOptions &options);
+
+/**
+ * @brief Iterative magnitude pruning: prune the trained network in rounds, fine-tuning it after each.
+ *
+ * Round `r` of `rounds` prunes the smallest weights of every layer up to `r / rounds` of the
+ * target sparsity (see Net::prune()), then trains the remaining weights for the fine-tuning
+ * epochs at the last learning rate. Prints the sparsity of every layer after each round.
+ *
+ * @param myNet The trained neural network.
+ * @param inputs The input data, split into training and validation sets.
+ * @param labels The labels, split into training and validation sets.
+ * @param sparsity Fraction of the weights of every layer to prune in the end.
+ * @param rounds Number of pruning rounds.
+ * @param fineTuneEpochs Number of epochs trained after every round.
+ * @param options Batch size, seed and training mode the network was trained with.
+ */
+void pruneNetwork(Net &myNet, InputData &inputs, LabelData &labels, double sparsity, unsigned rounds,
+                  unsigned fineTuneEpochs, const TrainingOptions &options);
+
+/**
+ * @brief Store the pruned network in CSR form and compare it with the dense model on the validation set.
+ *
+ * Prints validation accuracy, throughput of single samples and of batches, and the model size of
+ * both models. With a model file, the sparse model is written to it and the comparison uses the
+ * model read back from it.
+ *
+ * @param myNet The pruned neural network.
+ * @param inputs The input data, split into training and validation sets.
+ * @param labels The labels, split into training and validation sets.
+ * @param modelFile File to write the sparse model to, empty for none.
+ */
+void compareSparse(Net &myNet, InputData &inputs, LabelData &labels, const string &modelFile);
 
 /**
  * @brief The main function for training and testing the neural network.
@@ -51,4 +339,6 @@ void testAndPrintAccuracy(Net &myNet, InputData &inputs, LabelData &labels, stri
  * @param argv Array of command-line arguments.
  * @return Exit status.
  */
-int main(int argc, char *argv[]);
\ No newline at end of file
+int main(int argc, char *argv[]);
+
+#endif // MAIN_HPP
@@ -0,0 +1,79 @@
+/**
+ * @file metrics_log.cpp
+ * @brief Implementation of the machine-readable log of the training metrics.
+ */
+
+#include "metrics_log.hpp"
+#include "fast_math.hpp"
+#include <sys/resource.h>
+#include <stdexcept>
+
+/**
+ * @brief Write a number as JSON, which has no infinities or NaN (tested on the bits,
+ * `std::isfinite()` is always true under `-Ofast`).
+ */
+static void writeNumber(ofstream &file, double value)
+{
+    if (isFiniteBits(value))
+    {
+        file << value;
+    }
+    else
+    {
+        file << "null";
+    }
+}
+
+MetricsLog::MetricsLog(const string &path, const vector<unsigned> &topology, unsigned members) :
+    m_file(path),
+    m_flopsPerSample(0.0)
+{
+    if (!m_file.is_open())
+    {
+        throw runtime_error("Unable to open file: " + path);
+    }
+    for (unsigned layerNum = 0; layerNum + 1 < topology.size(); ++layerNum)
+    {
+        m_flopsPerSample += 6.0 * members * topology[layerNum] * topology[layerNum + 1];
+    }
+}
+
+long MetricsLog::peakRssKilobytes()
+{
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+void MetricsLog::writeCommon(const char *type, unsigned epoch, double learningRate, unsigned samples, double seconds)
+{
+    m_file << "{\"type\": \"" << type << "\", \"epoch\": " << epoch + 1 << ", \"learning_rate\": ";
+    writeNumber(m_file, learningRate);
+    m_file << ", \"samples_per_s\": ";
+    writeNumber(m_file, samples / seconds);
+    m_file << ", \"gflops\": ";
+    writeNumber(m_file, samples * m_flopsPerSample / seconds * 1e-9);
+    m_file << ", \"peak_rss_kb\": " << peakRssKilobytes();
+}
+
+void MetricsLog::logEpoch(unsigned epoch, double learningRate, const EpochMetrics &metrics, unsigned samples,
+                          double trainSeconds, double epochSeconds)
+{
+    writeCommon("epoch", epoch, learningRate, samples, trainSeconds);
+    m_file << ", \"train_loss\": ";
+    writeNumber(m_file, metrics.trainLoss);
+    m_file << ", \"train_accuracy\": ";
+    writeNumber(m_file, metrics.trainAccuracy);
+    m_file << ", \"validation_accuracy\": ";
+    writeNumber(m_file, metrics.validationAccuracy);
+    m_file << ", \"train_time_s\": " << trainSeconds << ", \"epoch_time_s\": " << epochSeconds << "}" << endl;
+}
+
+void MetricsLog::logBatches(unsigned epoch, unsigned batch, double learningRate, double loss, unsigned samples,
+                            double seconds)
+{
+    writeCommon("batch", epoch, learningRate, samples, seconds);
+    m_file << ", \"batch\": " << batch << ", \"loss\": ";
+    writeNumber(m_file, loss);
+    m_file << "}" << endl;
+}
@@ -0,0 +1,108 @@
+/**
+ * @file metrics_log.hpp
+ * @brief Declaration of the machine-readable log of the training metrics.
+ */
+#ifndef METRICS_LOG_HPP
+#define METRICS_LOG_HPP
+
+#include <vector>
+#include <string>
+#include <fstream>
+
+using namespace std;
+
+/**
+ * @struct EpochMetrics
+ * @brief Loss and accuracies measured after an epoch.
+ */
+struct EpochMetrics
+{
+    /**
+     * @brief Average loss on the training set.
+     */
+    double trainLoss = 0.0;
+
+    /**
+     * @brief Accuracy on the training set.
+     */
+    double trainAccuracy = 0.0;
+
+    /**
+     * @brief Accuracy on the validation set.
+     */
+    double validationAccuracy = 0.0;
+};
+
+/**
+ * @class MetricsLog
+ * @brief Writes the metrics of a training run as JSON lines, one object per epoch or batch interval.
+ *
+ * Every line has a `type` ("epoch" or "batch"), the epoch (from 1), the learning rate,
+ * the training throughput in samples/s and GFLOP/s (counted from the layer sizes: two
+ * operations per multiply-add, the backward pass twice the forward one) and the peak
+ * resident set size of the process in kB. Epoch lines add the metrics of the evaluation,
+ * the training time and the wall time of the epoch including the evaluation; batch lines
+ * the batch number and the average training loss since the previous line. Lines are
+ * flushed as they are written, so the log can be followed during the run.
+ */
+class MetricsLog
+{
+private:
+    /**
+     * @brief The log file.
+     */
+    ofstream m_file;
+
+    /**
+     * @brief Floating-point operations of training on one sample.
+     */
+    double m_flopsPerSample;
+
+    /**
+     * @brief Write the fields common to all lines, leaving the object open.
+     */
+    void writeCommon(const char *type, unsigned epoch, double learningRate, unsigned samples, double seconds);
+
+public:
+    /**
+     * @brief Constructor for the MetricsLog class, creating the file.
+     *
+     * @param path Path of the file.
+     * @param topology Number of neurons in each layer.
+     * @param members Number of models trained together (see Net).
+     * @throws std::runtime_error if the file cannot be created.
+     */
+    MetricsLog(const string &path, const vector<unsigned> &topology, unsigned members = 1);
+
+    /**
+     * @brief Log an epoch.
+     *
+     * @param epoch Index of the epoch, from 0.
+     * @param learningRate Learning rate of the epoch.
+     * @param metrics Metrics measured after the epoch.
+     * @param samples Number of training samples.
+     * @param trainSeconds Time of the training part of the epoch.
+     * @param epochSeconds Time of the whole epoch, including the evaluation.
+     */
+    void logEpoch(unsigned epoch, double learningRate, const EpochMetrics &metrics, unsigned samples,
+                  double trainSeconds, double epochSeconds);
+
+    /**
+     * @brief Log an interval of batches.
+     *
+     * @param epoch Index of the epoch, from 0.
+     * @param batch Number of batches of the epoch done so far.
+     * @param learningRate Learning rate of the epoch.
+     * @param loss Average training loss of the samples of the interval.
+     * @param samples Number of samples of the interval.
+     * @param seconds Time of the interval.
+     */
+    void logBatches(unsigned epoch, unsigned batch, double learningRate, double loss, unsigned samples, double seconds);
+
+    /**
+     * @brief Get the peak resident set size of the process in kB.
+     */
+    static long peakRssKilobytes();
+};
+
+#endif // METRICS_LOG_HPP
@@ -4,173 +4,358 @@
  */
 
 #include "net.hpp"
+#include "tracer.hpp"
+#include "pipeline.hpp"
+#include "profiler.hpp"
 #include <cassert>
 #include <limits>
 #include <string>
+#include <cstring>
 
-Net::Net(const vector<unsigned> &topology, unsigned seed) : m_error(0.0)
+Net::Net(const vector<unsigned> &topology, unsigned seed, Activation hiddenActivation, bool hugePages,
+         unsigned members) :
+    m_topology(topology),
+    m_members(max(members, 1u)),
+    m_activation(hiddenActivation),
+    m_dropout(topology.size(), 0.0),
+    m_learningRate(DenseLayer::defaultLearningRate),
+    m_optimizer(Optimizer::RMSProp),
+    m_hugePages(hugePages),
+    m_master(nullptr),
+    m_processGroup(nullptr),
+    m_pipeline(nullptr),
+    m_stateSize(0),
+    m_gradientSize(0),
+    m_capacity(0),
+    m_rows(0),
+    m_error(0.0)
 {
-    unsigned numLayers = topology.size();
+    // To generate seeds individual to neurons, member m of an ensemble is the net of seed + m
+    vector<mt19937> generators;
+    for (unsigned member = 0; member < m_members; ++member)
+    {
+        generators.emplace_back(seed + member);
+    }
+    buildLayers(generators.data());
+    reserveRows(1);
+}
 
-    std::mt19937 generator(seed); // To generate seeds individual to neurons
+Net::Net(Net &master) :
+    m_topology(master.m_topology),
+    m_members(master.m_members),
+    m_activation(master.m_activation),
+    m_dropout(master.m_dropout),
+    m_learningRate(master.m_learningRate),
+    m_optimizer(master.m_optimizer),
+    m_hugePages(master.m_hugePages),
+    m_master(&master),
+    m_processGroup(nullptr),
+    m_pipeline(nullptr),
+    m_stateSize(0),
+    m_gradientSize(0),
+    m_capacity(0),
+    m_rows(0),
+    m_error(0.0)
+{
+    buildLayers(nullptr);
+    for (unsigned layerNum = 0; layerNum < m_topology.size(); ++layerNum)
+    {
+        setDropout(layerNum, m_dropout[layerNum]);
+    }
+    setLearningRate(m_learningRate);
+    setOptimizer(m_optimizer);
+    reserveRows(master.m_capacity);
+}
 
-    for (unsigned layerNum = 0; layerNum < numLayers; ++layerNum) {
-        m_layers.push_back(Layer());
+void Net::buildLayers(mt19937 *generators)
+{
+    const vector<unsigned> &topology = m_topology;
 
-        // if last layer no outputs are set
-        unsigned numOutputs = layerNum == topology.size() - 1 ? 0 : topology[layerNum + 1];
+    // Unfused graph: dense + activation + dropout for hidden layers, dense + softmax for the output
+    vector<unique_ptr<Layer>> layers;
+    for (unsigned layerNum = 1; layerNum < topology.size(); ++layerNum)
+    {
+        // The members of an ensemble all read the inputs of the network
+        layers.push_back(make_unique<DenseLayer>(topology[layerNum - 1], topology[layerNum], m_members,
+                                                 layerNum == 1, generators));
+        m_denseLayers.push_back(static_cast<DenseLayer *>(layers.back().get()));
 
-        // creating neurons according to given topology (one additional for bias)
-        for (unsigned neuronNum = 0; neuronNum <= topology[layerNum]; ++neuronNum) {
-            m_layers.back().push_back(Neuron(topology[layerNum], numOutputs, neuronNum, generator()));
+        if (layerNum < topology.size() - 1)
+        {
+            layers.push_back(make_unique<ActivationLayer>(m_members * topology[layerNum], m_activation));
+            layers.push_back(make_unique<DropoutLayer>(m_members * topology[layerNum], 0.0));
+        }
+        else
+        {
+            layers.push_back(make_unique<SoftmaxOutputLayer>(topology[layerNum], m_members));
         }
-        // bias value
-        m_layers.back().back().setOutputVal(1.0);
     }
-}
 
-void Net::getResults(vector<double> &resultVals) const 
-{
-    resultVals.clear();
+    m_layers = fuseLayers(move(layers));
 
-    for (unsigned i = 0; i < m_layers.back().size() - 1; ++i)
+    // Find the layer responsible for dropout of each hidden layer: a standalone dropout
+    // layer if it was not fused, the dense layer otherwise
+    m_dropoutLayers.assign(topology.size(), nullptr);
+    unsigned layerNum = 0;
+    for (unique_ptr<Layer> &layer : m_layers)
     {
-        //cout << "out: " << m_layers.back()[i].getOutputVal() << endl;
-        resultVals.push_back(m_layers.back()[i].getOutputVal());
+        if (dynamic_cast<DenseLayer *>(layer.get()))
+        {
+            ++layerNum;
+            m_dropoutLayers[layerNum] = layer.get();
+        }
+        else if (dynamic_cast<DropoutLayer *>(layer.get()))
+        {
+            m_dropoutLayers[layerNum] = layer.get();
+        }
     }
+    m_dropoutLayers.back() = nullptr;
+
+    m_values.resize(m_layers.size() + 1);
+    m_aux.resize(m_layers.size());
+    m_gradients.resize(m_layers.size() + 1);
 }
 
-double Net::getLoss(const vector<double> &targetVals)
+void Net::reserveRows(unsigned rows)
 {
-    Layer &outputLayer = m_layers.back();
-    double loss = 0;
-    for(unsigned i = 0; i < outputLayer.size() - 1; ++i) // exclude bias
+    if (rows <= m_capacity)
     {
-        double outputVal = max(outputLayer[i].getOutputVal(), (double)(1.0E-15F)); // Avoid log(0)
-        loss -= targetVals[i] * log(outputVal);
+        return;
     }
-    return abs(loss) < 1e-14 ? 0.0 : loss;
-}
-
-void Net::backProp(const vector<double> &targetVals)
-{
-    Layer &outputLayer = m_layers.back();
 
-    // Categorical cross entropy loss
-    m_error = 0;
-    for(unsigned i = 0; i < outputLayer.size() - 1; ++i) // exclude bias
+    // Layout: parameters, optimizer state and gradients of all layers, then the buffers
+    size_t parameterSize = 0;
+    for (unique_ptr<Layer> &layer : m_layers)
     {
-        double outputVal = max(outputLayer[i].getOutputVal(), 0.000001); // Avoid log(0)
-        m_error -= targetVals[i] * log(outputVal);
+        parameterSize += Arena::align(layer->parameterSize());
     }
+    m_stateSize = 3 * parameterSize;
+    m_gradientSize = parameterSize;
 
-    //gradients for output neurons
-    for (unsigned i = 0; i < outputLayer.size() - 1; ++i) // -1 to skip the bias
+    // A replica only keeps its own gradients, parameters and optimizer state are the master's
+    const size_t ownedStateSize = m_master ? parameterSize : m_stateSize;
+    double *sharedParameters = m_master ? m_master->m_arena.data() : nullptr;
+
+    size_t size = ownedStateSize;
+    size += 2 * Arena::align(rows * m_layers.front()->numInputs());
+    for (unique_ptr<Layer> &layer : m_layers)
     {
-        outputLayer[i].calcOutputGradients(targetVals[i]);
+        size += 2 * Arena::align(rows * layer->numOutputs());
+        size += Arena::align(rows * layer->auxSize());
+        size += Arena::align(layer->workspaceSize(rows));
     }
 
-    //gradients on hidden layers
-    for (unsigned layerNum = m_layers.size() - 2; layerNum > 0; --layerNum)
+    // The layers copy their state over from the old arena (or their own storage)
+    Arena arena(size, m_hugePages);
+    double *parameters = m_master ? sharedParameters : arena.data();
+    double *gradients = m_master ? arena.data() : arena.data() + 2 * parameterSize;
+    double *buffer = arena.data() + ownedStateSize;
+    auto take = [&buffer](size_t count) { double *region = buffer; buffer += Arena::align(count); return region; };
+
+    m_values[0] = take(rows * m_layers.front()->numInputs());
+    m_gradients[0] = take(rows * m_layers.front()->numInputs());
+    for (unsigned k = 0; k < m_layers.size(); ++k)
     {
-        Layer &hiddenLayer = m_layers[layerNum];
-        Layer &nextLayer = m_layers[layerNum + 1];
+        Layer &layer = *m_layers[k];
+        m_values[k + 1] = take(rows * layer.numOutputs());
+        m_gradients[k + 1] = take(rows * layer.numOutputs());
+        m_aux[k] = take(rows * layer.auxSize());
 
-        for (unsigned i = 0; i < hiddenLayer.size() - 1; ++i)
-        {
-            hiddenLayer[i].calcHiddenGradients(nextLayer);
-        }
+        LayerStorage storage;
+        storage.parameters = parameters;
+        storage.optimizerState = parameters + parameterSize;
+        storage.gradients = gradients;
+        storage.workspace = take(layer.workspaceSize(rows));
+        storage.rows = rows;
+        storage.sharedParameters = m_master != nullptr;
+        layer.bindStorage(storage);
+        parameters += Arena::align(layer.parameterSize());
+        gradients += Arena::align(layer.parameterSize());
     }
 
-    // Gradients with respect to the weights
-    for (unsigned layerNum = 0; layerNum < m_layers.size() - 1; ++layerNum)
-    {
-        Layer &layer = m_layers[layerNum];
-        Layer &hiddenLayer = m_layers[layerNum + 1];
+    m_arena = move(arena);
+    m_capacity = rows;
+}
 
-        for (unsigned i = 0; i < layer.size() - 1; ++i)
+void Net::saveState(double *destination) const
+{
+    assert(!m_master);
+    memcpy(destination, m_arena.data(), m_stateSize * sizeof(double));
+}
+
+void Net::loadState(const double *source)
+{
+    assert(!m_master);
+    memcpy(m_arena.data(), source, m_stateSize * sizeof(double));
+}
+
+void Net::getResults(vector<double> &resultVals, unsigned row) const
+{
+    const unsigned numOutputs = m_topology.back();
+    const double *outputs = m_values.back() + row * m_members * numOutputs;
+    resultVals.assign(outputs, outputs + numOutputs);
+
+    // Ensemble prediction: the average of the members' probabilities
+    if (m_members > 1)
+    {
+        for (unsigned member = 1; member < m_members; ++member)
         {
-            layer[i].calcWeightGradients(hiddenLayer);
+            for (unsigned j = 0; j < numOutputs; ++j)
+            {
+                resultVals[j] += outputs[member * numOutputs + j];
+            }
+        }
+        for (double &value : resultVals)
+        {
+            value /= m_members;
         }
     }
 }
 
-void Net::updateWeights()
+double Net::getLoss(const vector<double> &targetVals)
+{
+    const unsigned last = m_layers.size() - 1;
+    return outputLayer().loss(m_values[last], m_values[last + 1], m_aux[last],
+                              targetVals.data(), nullptr, 1);
+}
+
+double Net::getLoss(const double *targets) const
 {
-    for (unsigned layerNum = 0; layerNum < m_layers.size() - 1; ++layerNum)
+    const unsigned last = m_layers.size() - 1;
+    return outputLayer().loss(m_values[last], m_values[last + 1], m_aux[last], targets, nullptr, m_rows);
+}
+
+unsigned Net::countCorrect(const double *targets) const
+{
+    const unsigned numOutputs = m_topology.back();
+    vector<double> output;
+    unsigned correct = 0;
+    for (unsigned row = 0; row < m_rows; ++row)
     {
-        Layer &actLayer = m_layers[layerNum];
+        getResults(output, row);
+        const double *target = targets + row * numOutputs;
+        correct += max_element(output.begin(), output.end()) - output.begin() ==
+                   max_element(target, target + numOutputs) - target;
+    }
+    return correct;
+}
 
-        for (unsigned i = 0; i < actLayer.size(); ++i)
-        {
-            actLayer[i].updateWeights();
-        }
+void Net::backProp(const vector<double> &targetVals)
+{
+    assert(m_rows == 1);
+    backProp(targetVals.data());
+}
+
+void Net::backProp(const double *targets)
+{
+    m_error = backwardLayers(0, m_layers.size(), 0, m_rows, targets);
+}
+
+double Net::forwardBackward(const double *inputs, const double *targets, unsigned rows)
+{
+    if (m_pipeline)
+    {
+        PROFILE_SCOPE(Pipeline);
+        return m_pipeline->forwardBackward(inputs, targets, rows);
+    }
+    {
+        PROFILE_SCOPE(Forward);
+        feedForward(inputs, rows);
     }
+    PROFILE_SCOPE(Backward);
+    backProp(targets);
+    return m_error;
 }
 
-void Net::feedForward(const vector<double> &inputVals)
+double Net::backwardLayers(unsigned first, unsigned last, unsigned row, unsigned rows, const double *targets)
 {
-    //the number of input values is the same as the number of input neurons
-    // -1 because of bias
-    assert(inputVals.size() == m_layers[0].size() - 1);
+    double loss = 0.0;
+    unsigned k = last;
 
-    // Set values of input neurons
-    for (unsigned i = 0; i < inputVals.size(); ++i)
+    // Categorical cross entropy loss and the gradients for output neurons
+    if (last == m_layers.size())
     {
-        m_layers[0][i].setOutputVal(inputVals[i]);
+        --k;
+        TraceScope trace("backward", k);
+        const unsigned width = m_layers[k]->numOutputs();
+        loss = outputLayer().loss(m_values[k] + row * width, m_values[k + 1] + row * width,
+                                  m_aux[k] + row * m_layers[k]->auxSize(), targets,
+                                  m_gradients[k] + row * width, rows);
     }
 
-    // Calculate output values of hidden neurons
-    for (unsigned layerNum = 1; layerNum < m_layers.size() - 1; ++layerNum)
+    // Gradients on hidden layers and with respect to the weights, no input gradients for the first layer
+    while (k-- > first)
     {
-        Layer &prevLayer = m_layers[layerNum -1];
-        for (unsigned i = 0; i < m_layers[layerNum].size() - 1; ++i)
-        {
-            m_layers[layerNum][i].calcPotential(prevLayer);
-            m_layers[layerNum][i].calcOutput();
-        }
+        TraceScope trace("backward", k);
+        Layer &layer = *m_layers[k];
+        const unsigned in = row * layer.numInputs(), out = row * layer.numOutputs();
+        layer.backward(m_values[k] + in, m_values[k + 1] + out, m_aux[k] + row * layer.auxSize(),
+                       m_gradients[k + 1] + out, k > 0 ? m_gradients[k] + in : nullptr, rows);
     }
+    return loss;
+}
 
-    // Calculate the network outputs - use softmax
-    Layer &outLayer = m_layers[m_layers.size() - 1];
-    Layer &prevLayer = m_layers[m_layers.size() - 2];
-    double exp_sum = 0.0;
-    double val = 0.0;
-    for (unsigned i = 0; i < outLayer.size() - 1; ++i)
+void Net::updateWeights()
+{
+    TraceScope trace("update");
+    for (unique_ptr<Layer> &layer : m_layers)
     {
-        outLayer[i].calcPotential(prevLayer);
-        val = exp(outLayer[i].getPotential());
-        exp_sum += val;
+        layer->updateWeights();
     }
+}
+
+void Net::feedForward(const vector<double> &inputVals)
+{
+    //the number of input values is the same as the number of input neurons
+    assert(inputVals.size() == m_topology[0]);
 
-    for (unsigned i = 0; i < outLayer.size() - 1; ++i)
+    feedForward(inputVals.data(), 1);
+}
+
+void Net::feedForward(const double *inputs, unsigned rows)
+{
+    loadInputs(inputs, rows);
+    forwardLayers(0, m_layers.size(), 0, rows);
+}
+
+void Net::loadInputs(const double *inputs, unsigned rows)
+{
+    reserveRows(rows);
+    m_rows = rows;
+    copy(inputs, inputs + rows * m_topology[0], m_values[0]);
+}
+
+void Net::forwardLayers(unsigned first, unsigned last, unsigned row, unsigned rows)
+{
+    for (unsigned k = first; k < last; ++k)
     {
-        outLayer[i].setOutputVal(exp(outLayer[i].getPotential()) / exp_sum);
+        TraceScope trace("forward", k);
+        Layer &layer = *m_layers[k];
+        layer.forward(m_values[k] + row * layer.numInputs(), m_values[k + 1] + row * layer.numOutputs(),
+                      m_aux[k] + row * layer.auxSize(), rows, true);
     }
-};
+}
 
 void Net::calcAvgGradient(unsigned int batchSize)
 {
-    for (unsigned layerNum = 0; layerNum < m_layers.size() - 1; ++layerNum)
+    TraceScope trace("reduce");
+    // The gradients of all layers are one contiguous region of the arena
+    if (m_processGroup)
     {
-        Layer &actLayer = m_layers[layerNum];
+        assert(!m_master);
+        m_processGroup->allreduce(m_arena.data() + m_stateSize - m_gradientSize, m_gradientSize);
+    }
 
-        for (unsigned i = 0; i < actLayer.size(); ++i)
-        {
-            actLayer[i].calcAvgGradient(batchSize);
-        }
+    for (unique_ptr<Layer> &layer : m_layers)
+    {
+        layer->calcAvgGradient(batchSize);
     }
 }
 
 void Net::resetGradientSum(){
-    for (unsigned layerNum = 0; layerNum < m_layers.size() - 1; ++layerNum)
+    for (unique_ptr<Layer> &layer : m_layers)
     {
-        Layer &actLayer = m_layers[layerNum];
-
-        for (unsigned i = 0; i < actLayer.size(); ++i)
-        {
-            actLayer[i].resetGradientSum();
-        }
+        layer->resetGradientSum();
     }
 }
 
@@ -187,9 +372,61 @@ int Net::compare_result(const vector<double> &output, const vector<double> &labe
 
 void Net::setDropout(unsigned int layer_num, double probability)
 {
-    Layer &actLayer = m_layers[layer_num];
-    for (unsigned i = 0; i < actLayer.size(); ++i)
+    m_dropout[layer_num] = probability;
+    if (m_dropoutLayers[layer_num])
+    {
+        m_dropoutLayers[layer_num]->setDropout(probability);
+    }
+}
+
+void Net::setLearningRate(double learningRate)
+{
+    m_learningRate = learningRate;
+    for (DenseLayer *layer : m_denseLayers)
+    {
+        layer->setLearningRate(learningRate);
+    }
+}
+
+void Net::setOptimizer(Optimizer optimizer)
+{
+    m_optimizer = optimizer;
+    for (DenseLayer *layer : m_denseLayers)
+    {
+        layer->setOptimizer(optimizer);
+    }
+}
+
+double Net::getWeight(unsigned layerNum, unsigned from, unsigned to) const
+{
+    const DenseLayer &layer = *m_denseLayers[layerNum];
+    return from < layer.numInputs() ? layer.getWeight(to, from) : layer.getBias(to);
+}
+
+void Net::setWeight(unsigned layerNum, unsigned from, unsigned to, double value)
+{
+    DenseLayer &layer = *m_denseLayers[layerNum];
+    if (from < layer.numInputs())
+    {
+        layer.setWeight(to, from, value);
+    }
+    else
+    {
+        layer.setBias(to, value);
+    }
+}
+
+double Net::getGradient(unsigned layerNum, unsigned from, unsigned to) const
+{
+    const DenseLayer &layer = *m_denseLayers[layerNum];
+    return from < layer.numInputs() ? layer.getWeightGradient(to, from) : 0.0;
+}
+
+void Net::prune(double fraction)
+{
+    assert(!m_master);
+    for (DenseLayer *layer : m_denseLayers)
     {
-        actLayer[i].setDropout(probability);
+        layer->prune(fraction);
     }
 }
@@ -2,106 +2,442 @@
  * @file net.hpp
  * @brief Declaration of the Net class and its methods.
  */
+#ifndef NET_HPP
+#define NET_HPP
+
 #include <vector>
+#include <memory>
 #include <cstdlib>
 #include <iostream>
 #include <algorithm>
 #include <cmath>
-#include "neuron.hpp"
+#include "layer.hpp"
+#include "arena.hpp"
+#include "process_group.hpp"
+#include "kernels.hpp"
 
 using namespace std;
 
+class Pipeline;
+
 /**
  * @class Net
  * @brief Represents a whole net topology, providing methods for training neural network.
+ *
+ * The topology is turned into a graph of layers (dense, activation, dropout, softmax
+ * output) which is then fused by fuseLayers(), so every hidden layer runs as a single
+ * dense+activation+dropout kernel in both directions. Samples can be passed one by one
+ * or as whole batches.
+ *
+ * An ensemble of several models of the same topology is trained in lockstep by packing
+ * the members side by side into every layer (see DenseLayer): the first layer of all
+ * members is one wide matrix product over the shared inputs. Every member is trained on
+ * its own loss and the ensemble predicts the average of the members' probabilities.
+ *
+ * All state lives in a single Arena, laid out as the parameters of all layers, their
+ * optimizer state, their gradients and then the per-batch buffers, each region 64-byte
+ * aligned. Construction is one allocation and a snapshot of the model is one memcpy.
  */
 class Net
 {
 private:
     /**
-     * @brief Vector holding the layers of neurons in the neural network.
+     * @brief Fused layers in execution order.
+     */
+    vector<unique_ptr<Layer>> m_layers;
+
+    /**
+     * @brief Dense layers, `m_denseLayers[l]` connects layer `l` of the topology to layer `l + 1`.
+     */
+    vector<DenseLayer *> m_denseLayers;
+
+    /**
+     * @brief Layer applying dropout to the outputs of each topology layer (nullptr for input and output).
+     */
+    vector<Layer *> m_dropoutLayers;
+
+    /**
+     * @brief Number of neurons in each layer (without the bias neurons).
+     */
+    vector<unsigned> m_topology;
+
+    /**
+     * @brief Number of independently initialized members of the ensemble trained in lockstep (1 for a single model).
+     */
+    unsigned m_members;
+
+    /**
+     * @brief Activation function of the hidden layers.
+     */
+    Activation m_activation;
+
+    /**
+     * @brief Dropout probability of each topology layer.
+     */
+    vector<double> m_dropout;
+
+    /**
+     * @brief Learning rate of the dense layers.
+     */
+    double m_learningRate;
+
+    /**
+     * @brief Update rule of the dense layers.
+     */
+    Optimizer m_optimizer;
+
+    /**
+     * @brief Whether the arena is backed by huge pages.
+     */
+    bool m_hugePages;
+
+    /**
+     * @brief Network whose parameters and optimizer state this replica uses, nullptr if the net owns them.
+     */
+    Net *m_master;
+
+    /**
+     * @brief Processes whose gradients are summed by calcAvgGradient(), nullptr when training alone.
+     */
+    ProcessGroup *m_processGroup;
+
+    /**
+     * @brief Pipeline training batches of this network, nullptr when training layer after layer.
+     */
+    Pipeline *m_pipeline;
+
+    /**
+     * @brief All state of the network: parameters, optimizer state and gradients of all
+     * layers, followed by the activation, auxiliary, gradient and workspace buffers.
+     */
+    Arena m_arena;
+
+    /**
+     * @brief Number of doubles at the start of the arena holding parameters, optimizer state and gradients.
+     */
+    size_t m_stateSize;
+
+    /**
+     * @brief Number of doubles of the gradients at the end of the model state.
+     */
+    size_t m_gradientSize;
+
+    /**
+     * @brief Number of rows the buffers can hold.
+     */
+    unsigned m_capacity;
+
+    /**
+     * @brief Number of rows of the last feedforward pass.
+     */
+    unsigned m_rows;
+
+    /**
+     * @brief Inputs of each layer, `m_values[k]` feeds `m_layers[k]` and the last entry holds the network output.
+     */
+    vector<double *> m_values;
+
+    /**
+     * @brief Auxiliary buffers of each layer (see Layer::auxSize()).
      */
-    vector<Layer> m_layers; //m_layers[layerNum][neuronNum]
+    vector<double *> m_aux;
+
+    /**
+     * @brief Gradients of the loss with respect to each entry of `m_values`.
+     */
+    vector<double *> m_gradients;
 
     /**
      * @brief Current error value of the neural network (cathegorical cross-entropy).
      */
     double m_error;
 
+    /**
+     * @brief Build the layer graph for the topology and fuse it.
+     * @param generators Generator of the weight seeds of each member, nullptr for zero weights.
+     */
+    void buildLayers(mt19937 *generators);
+
+    /**
+     * @brief The softmax output layer.
+     */
+    const SoftmaxOutputLayer &outputLayer() const { return static_cast<const SoftmaxOutputLayer &>(*m_layers.back()); }
+
 public:
     /**
      * @brief Constructor for the Net class.
-     * 
+     *
      * Initializes the neural network with the given topology and seed for random number generation.
-     * 
+     * The learning rate starts at DenseLayer::defaultLearningRate.
+     *
      * @param topology Vector representing the number of neurons in each layer.
      * @param seed Seed for random number generation.
+     * @param hiddenActivation Activation function of the hidden layers.
+     * @param hugePages Whether to back the arena by transparent huge pages.
+     * @param members Number of models of an ensemble trained in lockstep, member `m` starting
+     * from the weights of a single net of seed `seed + m`.
+     */
+    Net(const vector<unsigned> &topology, unsigned seed, Activation hiddenActivation = Activation::ReLU,
+        bool hugePages = false, unsigned members = 1);
+
+    /**
+     * @brief Constructor for a replica sharing the parameters and optimizer state of another net.
+     *
+     * The replica has its own gradients and buffers, so several replicas can train in
+     * parallel, updating the shared weights without locks (see HogwildTrainer). Its
+     * buffers hold as many rows as the master's, its learning rate and optimizer are the
+     * master's. The master must not reserve more rows while replicas exist.
+     *
+     * @param master Network owning the parameters.
+     */
+    explicit Net(Net &master);
+
+    /**
+     * @brief Make sure the buffers can hold batches of a given number of rows.
+     *
+     * A larger arena is allocated if needed and the state is moved into it. Called by
+     * feedForward(), calling it up front avoids the reallocation during training.
+     *
+     * @param rows Number of rows (samples).
+     */
+    void reserveRows(unsigned rows);
+
+    /**
+     * @brief Number of doubles of the model state (parameters, optimizer state and gradients).
+     */
+    size_t stateSize() const { return m_stateSize; }
+
+    /**
+     * @brief Number of doubles of the weight gradients, the last part of the model state
+     * (the array reduced over the processes of a group).
+     */
+    size_t gradientSize() const { return m_gradientSize; }
+
+    /**
+     * @brief Copy the model state to a buffer of stateSize() doubles (not for replicas).
+     * @param destination The buffer.
+     */
+    void saveState(double *destination) const;
+
+    /**
+     * @brief Restore the model state from a buffer filled by saveState() of a net with the same topology.
+     * @param source The buffer.
      */
-    Net(const vector<unsigned> &topology, unsigned seed);
+    void loadState(const double *source);
+
+    /**
+     * @brief Train data-parallel with other processes.
+     *
+     * calcAvgGradient() then sums the gradients of all processes first, so every process
+     * applies the same update and the weights stay identical.
+     *
+     * @param processGroup The processes, nullptr to train alone.
+     */
+    void setProcessGroup(ProcessGroup *processGroup) { m_processGroup = processGroup; }
+
+    /**
+     * @brief Get the processes the net trains with, nullptr when training alone.
+     */
+    ProcessGroup *getProcessGroup() const { return m_processGroup; }
+
+    /**
+     * @brief Train batches with a pipeline of layer stages.
+     *
+     * The pipeline is used by the training loop in place of feedForward() and backProp().
+     *
+     * @param pipeline The pipeline, created for this network, nullptr to train layer after layer.
+     */
+    void setPipeline(Pipeline *pipeline) { m_pipeline = pipeline; }
+
+    /**
+     * @brief Get the pipeline training this network, nullptr when training layer after layer.
+     */
+    Pipeline *getPipeline() const { return m_pipeline; }
+
+    /**
+     * @brief Get the arena holding all state of the network.
+     */
+    const Arena &arena() const { return m_arena; }
+
+    /**
+     * @brief Set the learning rate of the network.
+     *
+     * Can be changed between updates, e.g. by a LearningRateSchedule.
+     *
+     * @param learningRate Learning rate value.
+     */
+    void setLearningRate(double learningRate);
+
+    /**
+     * @brief Get the learning rate of the network.
+     */
+    double getLearningRate() const { return m_learningRate; }
+
+    /**
+     * @brief Set the update rule of the weights (RMSprop by default).
+     * @param optimizer The optimizer.
+     */
+    void setOptimizer(Optimizer optimizer);
+
+    /**
+     * @brief Get the update rule of the weights.
+     */
+    Optimizer getOptimizer() const { return m_optimizer; }
 
     /**
      * @brief Get the results (output values) of the neural network.
-     * @param resultVals Vector to store the output values.
+     * @param resultVals Vector to store the output values (averaged over the members of an ensemble).
+     * @param row Row of the last feedforward pass.
      */
-    void getResults(vector<double> &resultVals) const;
+    void getResults(vector<double> &resultVals, unsigned row = 0) const;
 
     /**
      * @brief Calculate the loss (categorical cross-entropy) between the network output and target values.
      * @param targetVals Target values for the output layer.
-     * @return Loss value.
+     * @return Loss value (averaged over the members of an ensemble).
      */
     double getLoss(const vector<double> &targetVals);
 
     /**
-     * @brief Backpropagate the error and update the network weights.
-     * 
-     * Computes the gradients and updates the weights of the network using backpropagation.
-     * 
+     * @brief Calculate the loss of all rows of the last feedforward pass, without gradients.
+     * @param targets Target values, one row of the output layer size per sample.
+     * @return Loss summed over the rows (averaged over the members of an ensemble).
+     */
+    double getLoss(const double *targets) const;
+
+    /**
+     * @brief Count the rows of the last feedforward pass whose prediction is correct, like compare_result().
+     * @param targets Target values, one row of the output layer size per sample.
+     * @return Number of correct rows.
+     */
+    unsigned countCorrect(const double *targets) const;
+
+    /**
+     * @brief Backpropagate the error and accumulate the weight gradients.
+     *
+     * The loss of the sample is computed together with the output gradients and can be
+     * read by getError().
+     *
      * @param targetVals Target values for the output layer.
      */
     void backProp(const vector<double> &targetVals);
 
+    /**
+     * @brief Perform a feedforward pass on a batch of samples.
+     *
+     * All samples go through each layer at once, so the dense layers run as matrix
+     * multiplications (see gemm()).
+     *
+     * @param inputs Input values of the samples, `rows` rows of the input layer size.
+     * @param rows Number of samples.
+     */
+    void feedForward(const double *inputs, unsigned rows);
+
+    /**
+     * @brief Backpropagate the error of the batch of the last feedforward pass and accumulate the weight gradients.
+     *
+     * The summed loss of the samples can be read by getError().
+     *
+     * @param targets Target values of the samples, one row of the output layer size per sample.
+     */
+    void backProp(const double *targets);
+
+    /**
+     * @brief Copy a batch into the input buffer, the first step of feedForward().
+     * @param inputs Input values of the samples, `rows` rows of the input layer size.
+     * @param rows Number of samples.
+     */
+    void loadInputs(const double *inputs, unsigned rows);
+
+    /**
+     * @brief Run the forward pass of a range of layers on a range of rows of the loaded batch.
+     *
+     * Layers only touch their own state and the given rows, so different layer ranges can
+     * run concurrently on different row ranges (see Pipeline).
+     *
+     * @param first Index of the first layer (see getLayers()).
+     * @param last Index one past the last layer.
+     * @param row First row.
+     * @param rows Number of rows.
+     */
+    void forwardLayers(unsigned first, unsigned last, unsigned row, unsigned rows);
+
+    /**
+     * @brief Run the backward pass of a range of layers on a range of rows and accumulate their weight gradients.
+     *
+     * If the range includes the output layer, the loss and the output gradients are
+     * computed first; otherwise the gradients of the outputs of the range must be ready.
+     *
+     * @param first Index of the first layer (see getLayers()).
+     * @param last Index one past the last layer.
+     * @param row First row.
+     * @param rows Number of rows.
+     * @param targets Target values of the rows, only used with the output layer.
+     * @return Loss summed over the rows, 0 without the output layer.
+     */
+    double backwardLayers(unsigned first, unsigned last, unsigned row, unsigned rows, const double *targets);
+
+    /**
+     * @brief Get the fused layers in execution order.
+     */
+    const vector<unique_ptr<Layer>> &getLayers() const { return m_layers; }
+
+    /**
+     * @brief Get the output values of the last feedforward pass.
+     * @return One row of the output layer size per sample, of that size times getMembers() for an ensemble.
+     */
+    const double *getOutputs() const { return m_values.back(); }
+
+    /**
+     * @brief Feed a batch forward and backpropagate it, accumulating the weight gradients;
+     * through the pipeline if one is set (see setPipeline()).
+     *
+     * The training step of the batched training loops; the caller resets, averages and
+     * applies the gradients around it.
+     *
+     * @param inputs Input values of the samples, `rows` rows of the input layer size.
+     * @param targets Target values of the samples, one row of the output layer size per sample.
+     * @param rows Number of samples.
+     * @return Loss summed over the samples.
+     */
+    double forwardBackward(const double *inputs, const double *targets, unsigned rows);
+
+    /**
+     * @brief Get the loss computed by the last backProp() call.
+     * @return Loss value (categorical cross-entropy), summed over the samples of a batch.
+     */
+    double getError() const { return m_error; }
 
     /**
      * @brief Update the weights of the neural network based on calculated gradients.
-     * 
-     * Iterates through each layer of the network and updates the weights of each neuron
-     * based on the computed gradients during backpropagation.
      */
     void updateWeights();
 
     /**
      * @brief Perform a feedforward pass to compute the network output.
-     * 
-     * Sets the input values, calculates the potential and output values of each neuron
-     * in hidden layers, and computes the softmax activation for the output layer.
-     * 
+     *
      * @param inputVals Vector containing the input values to the network.
      */
     void feedForward(const vector<double> &inputVals);
 
     /**
      * @brief Calculate the average gradient of each weight in the network.
-     * 
+     *
      * Calculates the average gradient for each weight in the network over a mini-batch.
-     * 
-     * @param batchSize Number of training examples in the mini-batch.
+     * With a process group, the gradients of all processes are summed first.
+     *
+     * @param batchSize Number of training examples in the mini-batch (of all processes together).
      */
     void calcAvgGradient(unsigned int batchSize);
 
     /**
      * @brief Reset the gradient sum for each weight in the network.
-     * 
-     * Resets the accumulated gradient sum for each weight in the network.
      */
     void resetGradientSum();
 
     /**
      * @brief Compare the predicted output with the ground truth label.
-     * 
-     * Compares the predicted output with the ground truth label and returns whether
-     * the prediction is correct.
-     * 
+     *
      * @param output Predicted output vector.
      * @param label Ground truth label vector.
      * @return 1 if the prediction is correct, 0 otherwise.
@@ -109,10 +445,79 @@ public:
     int compare_result(const vector<double> &output, const vector<double> &label);
 
     /**
-     * @brief Set the dropout probability for neurons in a specific layer.  
+     * @brief Set the dropout probability for neurons in a specific layer.
+     *
+     * Only hidden layers support dropout, the call is ignored for the input and output layers.
+     *
      * @param layer_num Index of the layer for which dropout probability is set.
      * @param probability Dropout probability.
      */
     void setDropout(unsigned int layer_num, double probability);
 
+    /**
+     * @brief Get the dropout probability of neurons in a specific layer.
+     * @param layer_num Index of the layer.
+     */
+    double getDropout(unsigned layer_num) const { return m_dropout[layer_num]; }
+
+    /**
+     * @brief Get the network topology the net was constructed with.
+     * @return Number of neurons in each layer (without the bias neurons).
+     */
+    const vector<unsigned> &getTopology() const { return m_topology; }
+
+    /**
+     * @brief Get the number of members of the ensemble (1 for a single model).
+     */
+    unsigned getMembers() const { return m_members; }
+
+    /**
+     * @brief Get the activation function of the hidden layers.
+     */
+    Activation getActivation() const { return m_activation; }
+
+    /**
+     * @brief Get the weight of a connection between two neighbouring layers.
+     * @param layerNum Index of the layer the connection starts in.
+     * @param from Index of the neuron in layer `layerNum` (the layer size addresses the bias neuron).
+     * @param to Index of the neuron in layer `layerNum + 1` (of the first member of an ensemble).
+     * @return The weight of the connection.
+     */
+    double getWeight(unsigned layerNum, unsigned from, unsigned to) const;
+
+    /**
+     * @brief Set the weight of a connection between two neighbouring layers.
+     * @param layerNum Index of the layer the connection starts in.
+     * @param from Index of the neuron in layer `layerNum` (the layer size addresses the bias neuron).
+     * @param to Index of the neuron in layer `layerNum + 1` (of the first member of an ensemble).
+     * @param value The weight.
+     */
+    void setWeight(unsigned layerNum, unsigned from, unsigned to, double value);
+
+    /**
+     * @brief Get the gradient of the loss with respect to the weight of a connection, as
+     * accumulated by backProp() (averaged once calcAvgGradient() has been called).
+     * @param layerNum Index of the layer the connection starts in.
+     * @param from Index of the neuron in layer `layerNum` (the layer size addresses the bias neuron).
+     * @param to Index of the neuron in layer `layerNum + 1` (of the first member of an ensemble).
+     * @return The gradient, 0 for the biases, which are not trained.
+     */
+    double getGradient(unsigned layerNum, unsigned from, unsigned to) const;
+
+    /**
+     * @brief Prune the weights with the smallest magnitudes in every dense layer, see DenseLayer::prune().
+     *
+     * Not for replicas, whose layers would not keep the pruned weights at zero.
+     *
+     * @param fraction Fraction of the weights (not the biases) of each layer to prune.
+     */
+    void prune(double fraction);
+
+    /**
+     * @brief Fraction of the weights (not the biases) of a layer that are zero.
+     * @param layerNum Index of the layer the connections start in.
+     */
+    double sparsity(unsigned layerNum) const { return m_denseLayers[layerNum]->sparsity(); }
 };
+
+#endif // NET_HPP
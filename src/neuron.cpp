@@ -1,4 +1,6 @@
 #include "neuron.hpp"
+#include "fast_math.hpp"
+#include "random.hpp"
 
 double Neuron::eta = 0.15;
 double Neuron::alpha = 0.9;
@@ -37,7 +39,7 @@ double Neuron::heWeightInit(unsigned numLayerInputs, unsigned seed)
 void Neuron::setDropout(double probability)
 {
     dropout_probability = probability;
-    dropout_probability_int = static_cast<unsigned>(probability * RAND_MAX);
+    dropout_probability_int = static_cast<uint64_t>(probability * 4294967296.0);
 }
 
 // void Neuron::updateWeights()
@@ -68,17 +70,38 @@ void Neuron::setDropout(double probability)
 // RMSprop, learning rate set to 0.001
 void Neuron::updateWeights()
 {
-    for (unsigned i = 0; i < m_outWeights.size(); ++i)
+    // Local copies, so the compiler does not have to assume the weight stores alias them
+    const double learningRate = eta, decayRate = decay, eps = epsilon;
+    double *weights = m_outWeights.data();
+    double *deltas = m_outWeightsDeltas.data();
+    const double *gradients = m_outWeightsGradients.data();
+    const unsigned numWeights = m_outWeights.size();
+
+    if (fastMathEnabled())
     {
-        double gradient = m_outWeightsGradients[i];
+        // The same rule with sqrt approximated by fastSqrt(), exact 0 for a zero average
+        for (unsigned i = 0; i < numWeights; ++i)
+        {
+            double gradient = gradients[i];
 
-        m_outWeightsDeltas[i] = decay * m_outWeightsDeltas[i] + (1 - decay) * gradient * gradient;
+            deltas[i] = decayRate * deltas[i] + (1 - decayRate) * gradient * gradient;
 
-        m_outWeights[i] += -(eta / (sqrt(m_outWeightsDeltas[i]) + epsilon)) * gradient;
+            weights[i] += -(learningRate / (fastSqrt(deltas[i]) + eps)) * gradient;
+        }
+        return;
+    }
+
+    for (unsigned i = 0; i < numWeights; ++i)
+    {
+        double gradient = gradients[i];
+
+        deltas[i] = decayRate * deltas[i] + (1 - decayRate) * gradient * gradient;
+
+        weights[i] += -(learningRate / (sqrt(deltas[i]) + eps)) * gradient;
     }
 }
 
-double Neuron::sumDOW(const Layer &nextLayer) const
+double Neuron::sumDOW(const NeuronLayer &nextLayer) const
 {
     double sum = 0.0;
 
@@ -89,17 +112,12 @@ double Neuron::sumDOW(const Layer &nextLayer) const
     return sum;
 }
 
-void Neuron::calcHiddenGradients(const Layer &nextLayer)
+void Neuron::calcHiddenGradients(const NeuronLayer &nextLayer)
 {
     m_gradient = sumDOW(nextLayer) * Neuron::transferFunctionDerivative(m_potential); 
 }
 
-void Neuron::calcOutputGradients(double targetVal)
-{
-    m_gradient = m_outVal - targetVal; // For softmax
-}
-
-void Neuron::calcWeightGradients(const Layer &nextLayer)
+void Neuron::calcWeightGradients(const NeuronLayer &nextLayer)
 {
     for(unsigned i = 0; i < m_outWeights.size(); ++i)
     {
@@ -118,7 +136,7 @@ double Neuron::transferFunctionDerivative(double x)
     return x < 0.0f ? 0.0f : 1.0f;
 }
 
-void Neuron::calcPotential(const Layer &prevLayer)
+void Neuron::calcPotential(const NeuronLayer &prevLayer)
 {
     m_potential = 0.0;
 
@@ -132,7 +150,7 @@ void Neuron::calcPotential(const Layer &prevLayer)
 void Neuron::calcOutput()
 {
     // Apply dropout with probability
-    if(rand() < dropout_probability_int){
+    if(threadGenerator().nextUint32() < dropout_probability_int){
         m_potential = 0.0;
         m_outVal = 0.0;
         return;
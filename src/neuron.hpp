@@ -2,12 +2,15 @@
  * @file neuron.hpp
  * @brief Declaration of the Neuron class and its methods.
  */
+#ifndef NEURON_HPP
+#define NEURON_HPP
 
 #include <vector>
 #include <cstdlib>
 #include <iostream>
 #include <cmath>
 #include <random>
+#include <cstdint>
 
 using namespace std;
 
@@ -18,13 +21,13 @@ using namespace std;
 class Neuron;
 
 /**
- * @typedef Layer
+ * @typedef NeuronLayer
  * @brief Represents a layer of neurons in a neural network.
  *
- * A Layer is defined as a vector of Neuron objects. It is used to organize neurons
+ * A NeuronLayer is defined as a vector of Neuron objects. It is used to organize neurons
  * within a neural network and facilitate the flow of information between layers.
  */
-typedef vector<Neuron> Layer;
+typedef vector<Neuron> NeuronLayer;
 
 /**
  * @struct Connection
@@ -75,7 +78,7 @@ private:
      * @param nextLayer The next layer of neurons.
      * @return The sum of derivatives of weights.
      */
-    double sumDOW(const Layer &nextLayer) const;
+    double sumDOW(const NeuronLayer &nextLayer) const;
 
     /**
      * @brief Apply the ReLU transfer function to the given value.
@@ -133,9 +136,9 @@ private:
     double dropout_probability; // Probability of neuron being dropped out
 
     /**
-     * @brief Probability of neuron being dropped out, but in interval from 0 to RAND_MAX.
+     * @brief Probability of neuron being dropped out, scaled to the range of RandomGenerator::nextUint32().
      */
-    int dropout_probability_int; 
+    uint64_t dropout_probability_int;
 
 public:
     /**
@@ -176,6 +179,13 @@ public:
      */
     double getOutputVal(void) const { return m_outVal; }
 
+    /**
+     * @brief Get the weight of the connection to a neuron in the next layer.
+     * @param index Index of the neuron in the next layer.
+     * @return The weight of the connection.
+     */
+    double getOutputWeight(unsigned index) const { return m_outWeights[index]; }
+
     /**
      * @brief Update the weights of the neuron using the RMSprop optimization algorithm.
      */
@@ -185,25 +195,25 @@ public:
      * @brief Calculate the gradients for hidden layer neurons.
      * @param nextLayer The next layer of neurons.
      */
-    void calcHiddenGradients(const Layer &nextLayer);
+    void calcHiddenGradients(const NeuronLayer &nextLayer);
     
     /**
-     * @brief Calculate the gradients for output layer neurons (difference between output value and desired value).
-     * @param targetVal Desired value for the neuron.
+     * @brief Set the gradient of an output layer neuron, computed by the softmax cross-entropy kernel.
+     * @param gradient Gradient of the loss with respect to the inner potential of the neuron.
      */
-    void calcOutputGradients(double targetVal);
+    void setGradient(double gradient) { m_gradient = gradient; }
 
     /**
      * @brief Calculate the weight gradients for the neuron.
      * @param nextLayer The next layer of neurons.
      */
-    void calcWeightGradients(const Layer &nextLayer);
+    void calcWeightGradients(const NeuronLayer &nextLayer);
     
     /**
      * @brief Calculate the inner potential of the neuron based on the previous layer's output.
      * @param prevLayer The previous layer of neurons.
      */
-    void calcPotential(const Layer &prevLayer);
+    void calcPotential(const NeuronLayer &prevLayer);
 
     /**
      * @brief Apply the transfer function to calculate the output value of the neuron.
@@ -221,4 +231,6 @@ public:
      */
     void resetGradientSum();
 
-};
\ No newline at end of file
+};
+
+#endif // NEURON_HPP
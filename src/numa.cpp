@@ -0,0 +1,109 @@
+/**
+ * @file numa.cpp
+ * @brief Implementation of the NUMA topology detection and thread pinning.
+ */
+
+#include "numa.hpp"
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <pthread.h>
+#include <sched.h>
+
+NumaPlacement parseNumaPlacement(const string &name)
+{
+    if (name == "none") return NumaPlacement::None;
+    if (name == "local") return NumaPlacement::Local;
+    if (name == "replicated") return NumaPlacement::Replicated;
+    throw invalid_argument("Unknown NUMA placement: " + name);
+}
+
+/**
+ * @brief Parse a kernel CPU list such as "0-3,8,10-11".
+ */
+static vector<unsigned> parseCpuList(const string &list)
+{
+    vector<unsigned> cpus;
+    stringstream ranges(list);
+    string range;
+    while (getline(ranges, range, ','))
+    {
+        if (range.empty() || range == "\n")
+        {
+            continue;
+        }
+        const size_t dash = range.find('-');
+        const unsigned first = stoul(range.substr(0, dash));
+        const unsigned last = dash == string::npos ? first : stoul(range.substr(dash + 1));
+        for (unsigned cpu = first; cpu <= last; ++cpu)
+        {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+NumaTopology::NumaTopology()
+{
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+    {
+        for (unsigned cpu = 0; cpu < max(thread::hardware_concurrency(), 1u) && cpu < CPU_SETSIZE; ++cpu)
+        {
+            CPU_SET(cpu, &allowed);
+        }
+    }
+
+    // Node directories are numbered without gaps on all but exotic machines, stop at the first missing one
+    for (unsigned node = 0; ; ++node)
+    {
+        ifstream file("/sys/devices/system/node/node" + to_string(node) + "/cpulist");
+        if (!file.is_open())
+        {
+            break;
+        }
+        string list;
+        getline(file, list);
+
+        vector<unsigned> cpus;
+        for (unsigned cpu : parseCpuList(list))
+        {
+            if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed))
+            {
+                cpus.push_back(cpu);
+            }
+        }
+        if (!cpus.empty())
+        {
+            m_cpus.push_back(move(cpus));
+        }
+    }
+
+    if (m_cpus.empty())
+    {
+        m_cpus.emplace_back();
+        for (unsigned cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        {
+            if (CPU_ISSET(cpu, &allowed))
+            {
+                m_cpus.back().push_back(cpu);
+            }
+        }
+    }
+}
+
+unsigned NumaTopology::workerCpu(unsigned worker) const
+{
+    const vector<unsigned> &cpus = m_cpus[workerNode(worker)];
+    return cpus[(worker / nodes()) % cpus.size()];
+}
+
+bool pinThread(unsigned cpu)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
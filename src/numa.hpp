@@ -0,0 +1,104 @@
+/**
+ * @file numa.hpp
+ * @brief Declaration of the NUMA topology detection and thread pinning.
+ */
+#ifndef NUMA_HPP
+#define NUMA_HPP
+
+#include <vector>
+#include <string>
+
+using namespace std;
+
+/**
+ * @enum NumaPlacement
+ * @brief Placement of the Hogwild workers and their memory.
+ */
+enum class NumaPlacement
+{
+    /**
+     * @brief Threads are scheduled by the kernel, all memory is allocated by the calling thread.
+     */
+    None,
+
+    /**
+     * @brief Workers are pinned and spread over the nodes, each allocates its own buffers and
+     * data shard (first touch), the weights are shared.
+     */
+    Local,
+
+    /**
+     * @brief As Local, and every node additionally trains its own copy of the weights,
+     * averaged into the network after every epoch.
+     */
+    Replicated
+};
+
+/**
+ * @brief Parse the name of a placement.
+ * @param name One of "none", "local", "replicated".
+ * @return The placement.
+ * @throws std::invalid_argument if the name is unknown.
+ */
+NumaPlacement parseNumaPlacement(const string &name);
+
+/**
+ * @class NumaTopology
+ * @brief CPUs of each NUMA node the process may run on.
+ *
+ * Read from `/sys/devices/system/node`; without it (or without NUMA support in the
+ * kernel) all CPUs form a single node. Nodes without allowed CPUs are left out.
+ */
+class NumaTopology
+{
+private:
+    /**
+     * @brief Allowed CPUs of each node, in increasing order.
+     */
+    vector<vector<unsigned>> m_cpus;
+
+public:
+    /**
+     * @brief Constructor detecting the topology of the machine.
+     */
+    NumaTopology();
+
+    /**
+     * @brief Constructor for a given topology.
+     * @param cpus CPUs of each node, no node may be empty.
+     */
+    explicit NumaTopology(const vector<vector<unsigned>> &cpus) : m_cpus(cpus) {}
+
+    /**
+     * @brief Get the number of nodes.
+     */
+    unsigned nodes() const { return m_cpus.size(); }
+
+    /**
+     * @brief Get the CPUs of a node.
+     * @param node Index of the node.
+     */
+    const vector<unsigned> &cpus(unsigned node) const { return m_cpus[node]; }
+
+    /**
+     * @brief Node of a worker, workers are dealt to the nodes round robin.
+     * @param worker Index of the worker.
+     */
+    unsigned workerNode(unsigned worker) const { return worker % nodes(); }
+
+    /**
+     * @brief CPU of a worker, the workers of a node take its CPUs in order (wrapping around
+     * when there are more workers than CPUs).
+     * @param worker Index of the worker.
+     */
+    unsigned workerCpu(unsigned worker) const;
+};
+
+/**
+ * @brief Restrict the calling thread to a single CPU.
+ * @param cpu The CPU.
+ * @return Whether the affinity could be set.
+ */
+bool pinThread(unsigned cpu);
+
+#endif // NUMA_HPP
@@ -0,0 +1,204 @@
+/**
+ * @file pipeline.cpp
+ * @brief Implementation of the Pipeline class.
+ */
+
+#include "pipeline.hpp"
+#include "random.hpp"
+#include "tracer.hpp"
+#include <limits>
+
+/**
+ * @brief Split layers into contiguous stages, minimizing the cost of the most expensive stage.
+ * @param costs Cost of each layer.
+ * @param stages Number of stages, at most the number of layers.
+ * @return Index of the first layer of each stage, followed by the number of layers.
+ */
+static vector<unsigned> partitionLayers(const vector<double> &costs, unsigned stages)
+{
+    const unsigned n = costs.size();
+    vector<double> prefix(n + 1, 0.0);
+    for (unsigned k = 0; k < n; ++k)
+    {
+        prefix[k + 1] = prefix[k] + costs[k];
+    }
+
+    // best[s][k]: lowest maximum stage cost of the first k layers split into s stages
+    const double infinity = numeric_limits<double>::infinity();
+    vector<vector<double>> best(stages + 1, vector<double>(n + 1, infinity));
+    vector<vector<unsigned>> split(stages + 1, vector<unsigned>(n + 1, 0));
+    best[0][0] = 0.0;
+    for (unsigned s = 1; s <= stages; ++s)
+    {
+        for (unsigned k = s; k <= n; ++k)
+        {
+            for (unsigned j = s - 1; j < k; ++j)
+            {
+                const double cost = max(best[s - 1][j], prefix[k] - prefix[j]);
+                if (cost < best[s][k])
+                {
+                    best[s][k] = cost;
+                    split[s][k] = j;
+                }
+            }
+        }
+    }
+
+    vector<unsigned> boundaries(stages + 1);
+    boundaries[stages] = n;
+    for (unsigned s = stages; s > 0; --s)
+    {
+        boundaries[s - 1] = split[s][boundaries[s]];
+    }
+    return boundaries;
+}
+
+Pipeline::Pipeline(Net &net, unsigned stages, unsigned microBatches, unsigned seed) :
+    m_net(net),
+    m_microBatches(max(microBatches, 1u)),
+    m_targets(nullptr),
+    m_rows(0),
+    m_loss(0.0),
+    m_generation(0),
+    m_finished(0),
+    m_stop(false)
+{
+    // The cost of a layer is dominated by its weights, the softmax costs about one pass over its outputs
+    const vector<unique_ptr<Layer>> &layers = m_net.getLayers();
+    vector<double> costs;
+    for (const unique_ptr<Layer> &layer : layers)
+    {
+        costs.push_back(layer->parameterSize() + layer->numOutputs());
+    }
+    m_boundaries = partitionLayers(costs, min<unsigned>(max(stages, 1u), layers.size()));
+    m_progress = make_unique<StageProgress[]>(this->stages());
+
+    // Dropout streams after the ones of the processes' main threads (see seedThreadGenerator())
+    const ProcessGroup *group = m_net.getProcessGroup();
+    const unsigned processes = group ? group->size() : 1, rank = group ? group->rank() : 0;
+    const unsigned firstStream = processes + rank * (this->stages() - 1);
+    for (unsigned stage = 1; stage < this->stages(); ++stage)
+    {
+        m_threads.emplace_back(&Pipeline::stageLoop, this, stage, seed, firstStream + stage - 1);
+    }
+}
+
+Pipeline::~Pipeline()
+{
+    m_stop.store(true, memory_order_relaxed);
+    startGeneration();
+    for (thread &stageThread : m_threads)
+    {
+        stageThread.join();
+    }
+}
+
+void Pipeline::stageLoop(unsigned stage, unsigned seed, unsigned stream)
+{
+    seedThreadGenerator(seed, stream);
+    Tracer::setThreadName("pipeline stage " + to_string(stage));
+    unsigned generation = 0;
+    while (true)
+    {
+        // Sleep between batches, so evaluation and testing get the cores of the stages
+        {
+            unique_lock<mutex> lock(m_mutex);
+            m_started.wait(lock, [&]() { return m_generation.load(memory_order_acquire) != generation; });
+            generation = m_generation.load(memory_order_acquire);
+        }
+        if (m_stop.load(memory_order_relaxed))
+        {
+            return;
+        }
+
+        runStage(stage);
+        m_finished.fetch_add(1, memory_order_release);
+    }
+}
+
+void Pipeline::startGeneration()
+{
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_generation.fetch_add(1, memory_order_release);
+    }
+    m_started.notify_all();
+}
+
+void Pipeline::runStage(unsigned stage)
+{
+    const unsigned first = m_boundaries[stage], last = m_boundaries[stage + 1];
+    const bool firstStage = stage == 0, lastStage = stage + 1 == stages();
+    const unsigned numOutputs = m_net.getTopology().back();
+    StageProgress &own = m_progress[stage];
+
+    // Only the last stage computes a loss, kept locally so the other stages never touch m_loss
+    unsigned forwarded = 0, backwarded = 0;
+    double loss = 0.0;
+    while (backwarded < m_microBatches)
+    {
+        // The last stage can backpropagate a micro-batch right after its forward pass
+        const unsigned backwardReady = lastStage ? forwarded : own.backwardReady.load(memory_order_acquire);
+        const unsigned forwardReady = firstStage ? m_microBatches : own.forwardReady.load(memory_order_acquire);
+
+        if (backwarded < backwardReady)
+        {
+            const unsigned row = backwarded * m_rows / m_microBatches;
+            const unsigned rows = (backwarded + 1) * m_rows / m_microBatches - row;
+            if (rows > 0)
+            {
+                loss += m_net.backwardLayers(first, last, row, rows, lastStage ? m_targets + row * numOutputs : nullptr);
+            }
+            ++backwarded;
+            if (!firstStage)
+            {
+                m_progress[stage - 1].backwardReady.store(backwarded, memory_order_release);
+            }
+        }
+        else if (forwarded < forwardReady)
+        {
+            const unsigned row = forwarded * m_rows / m_microBatches;
+            const unsigned rows = (forwarded + 1) * m_rows / m_microBatches - row;
+            if (rows > 0)
+            {
+                m_net.forwardLayers(first, last, row, rows);
+            }
+            ++forwarded;
+            if (!lastStage)
+            {
+                m_progress[stage + 1].forwardReady.store(forwarded, memory_order_release);
+            }
+        }
+        else
+        {
+            this_thread::yield();
+        }
+    }
+    if (lastStage)
+    {
+        m_loss = loss;
+    }
+}
+
+double Pipeline::forwardBackward(const double *inputs, const double *targets, unsigned rows)
+{
+    m_net.loadInputs(inputs, rows);
+    m_targets = targets;
+    m_rows = rows;
+    m_loss = 0.0;
+    for (unsigned stage = 0; stage < stages(); ++stage)
+    {
+        m_progress[stage].forwardReady.store(0, memory_order_relaxed);
+        m_progress[stage].backwardReady.store(0, memory_order_relaxed);
+    }
+    m_finished.store(0, memory_order_relaxed);
+
+    // Start the other stages and run the first one here
+    startGeneration();
+    runStage(0);
+    while (m_finished.load(memory_order_acquire) < stages() - 1)
+    {
+        this_thread::yield();
+    }
+    return m_loss;
+}
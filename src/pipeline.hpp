@@ -0,0 +1,183 @@
+/**
+ * @file pipeline.hpp
+ * @brief Declaration of the Pipeline class for layer-pipelined training.
+ */
+#ifndef PIPELINE_HPP
+#define PIPELINE_HPP
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "net.hpp"
+
+using namespace std;
+
+/**
+ * @class Pipeline
+ * @brief Runs the forward and backward passes of a Net as a pipeline of layer stages.
+ *
+ * The fused layers are split into contiguous stages of about equal cost (weights per
+ * stage) and every stage is owned by one thread, so its weights stay in that core's
+ * cache. A batch is split into micro-batches of consecutive rows which stream through
+ * the stages: a stage runs the forward pass of the next micro-batch whenever the previous
+ * stage has finished it, and the backward pass as soon as the next stage has produced
+ * its gradients, preferring the backward pass (one-forward-one-backward), so forward and
+ * backward work of different micro-batches overlaps. Micro-batches use disjoint rows of
+ * the network's buffers and every layer only runs on its owner thread, so no locks are
+ * needed. The weight gradients of all micro-batches are accumulated and the update is
+ * left to the caller, so the result is that of the whole batch.
+ *
+ * The first stage runs on the calling thread, the others on threads kept for the
+ * lifetime of the pipeline.
+ */
+class Pipeline
+{
+private:
+    /**
+     * @brief Progress counters of a stage, on their own cache line.
+     */
+    struct alignas(64) StageProgress
+    {
+        /**
+         * @brief Number of micro-batches whose inputs of the stage are ready.
+         */
+        atomic<unsigned> forwardReady;
+
+        /**
+         * @brief Number of micro-batches whose output gradients of the stage are ready.
+         */
+        atomic<unsigned> backwardReady;
+    };
+
+    /**
+     * @brief The network.
+     */
+    Net &m_net;
+
+    /**
+     * @brief Index of the first layer of each stage, followed by the number of layers.
+     */
+    vector<unsigned> m_boundaries;
+
+    /**
+     * @brief Number of micro-batches a batch is split into.
+     */
+    unsigned m_microBatches;
+
+    /**
+     * @brief Progress of each stage in the current batch.
+     */
+    unique_ptr<StageProgress[]> m_progress;
+
+    /**
+     * @brief Target values of the current batch.
+     */
+    const double *m_targets;
+
+    /**
+     * @brief Number of rows of the current batch.
+     */
+    unsigned m_rows;
+
+    /**
+     * @brief Loss of the current batch, written by the last stage only (published by m_finished).
+     */
+    double m_loss;
+
+    /**
+     * @brief Incremented to start a batch (or to stop the threads), under m_mutex.
+     */
+    atomic<unsigned> m_generation;
+
+    /**
+     * @brief Guards the increments of m_generation the stage threads sleep on.
+     */
+    mutex m_mutex;
+
+    /**
+     * @brief Wakes the stage threads for a new generation.
+     */
+    condition_variable m_started;
+
+    /**
+     * @brief Number of stage threads done with the current batch.
+     */
+    atomic<unsigned> m_finished;
+
+    /**
+     * @brief Whether the stage threads should exit.
+     */
+    atomic<bool> m_stop;
+
+    /**
+     * @brief Threads of the stages after the first.
+     */
+    vector<thread> m_threads;
+
+    /**
+     * @brief Increment m_generation and wake the stage threads.
+     */
+    void startGeneration();
+
+    /**
+     * @brief Run the forward and backward passes of a stage for all micro-batches of the current batch.
+     * @param stage Index of the stage.
+     */
+    void runStage(unsigned stage);
+
+    /**
+     * @brief Main loop of a stage thread.
+     * @param stage Index of the stage.
+     * @param seed Seed of the dropout generator of the thread.
+     * @param stream Stream of the dropout generator of the thread.
+     */
+    void stageLoop(unsigned stage, unsigned seed, unsigned stream);
+
+public:
+    /**
+     * @brief Constructor for the Pipeline class, starting the stage threads.
+     *
+     * @param net The network, its buffers must already hold the largest batch (see Net::reserveRows()).
+     * @param stages Number of stages, at most the number of fused layers.
+     * @param microBatches Number of micro-batches a batch is split into.
+     * @param seed Seed of the dropout generators of the stage threads.
+     */
+    Pipeline(Net &net, unsigned stages, unsigned microBatches, unsigned seed);
+
+    Pipeline(const Pipeline &) = delete;
+    Pipeline &operator=(const Pipeline &) = delete;
+
+    /**
+     * @brief Destructor, stopping the stage threads.
+     */
+    ~Pipeline();
+
+    /**
+     * @brief Get the number of stages.
+     */
+    unsigned stages() const { return m_boundaries.size() - 1; }
+
+    /**
+     * @brief Get the index of the first layer of a stage, `stage == stages()` gives the number of layers.
+     * @param stage Index of the stage.
+     */
+    unsigned firstLayer(unsigned stage) const { return m_boundaries[stage]; }
+
+    /**
+     * @brief Feed a batch forward and backpropagate it, accumulating the weight gradients.
+     *
+     * Equivalent to Net::feedForward() followed by Net::backProp(), except that the loss is
+     * returned instead of being stored in the network.
+     *
+     * @param inputs Input values of the samples, `rows` rows of the input layer size.
+     * @param targets Target values of the samples, one row of the output layer size per sample.
+     * @param rows Number of samples.
+     * @return Loss summed over the samples.
+     */
+    double forwardBackward(const double *inputs, const double *targets, unsigned rows);
+};
+
+#endif // PIPELINE_HPP
@@ -0,0 +1,224 @@
+/**
+ * @file process_group.cpp
+ * @brief Implementation of the ProcessGroup class.
+ */
+
+#include "process_group.hpp"
+#include <atomic>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <csignal>
+#include <stdexcept>
+#include <string>
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+
+struct ProcessGroup::Header
+{
+    /**
+     * @brief Number of processes waiting at the barrier.
+     */
+    alignas(64) atomic<unsigned> waiting;
+
+    /**
+     * @brief Incremented every time all processes have reached the barrier.
+     */
+    alignas(64) atomic<unsigned> generation;
+};
+
+static_assert(atomic<unsigned>::is_always_lock_free, "Shared memory barrier needs address-free atomics");
+
+/**
+ * @brief Offset of the rank buffers in the segment.
+ */
+static const size_t headerBytes = 128;
+
+/**
+ * @brief Spins of a barrier between two checks whether the other processes are still alive.
+ */
+static const unsigned livenessInterval = 1024;
+
+ProcessGroup::ProcessGroup(unsigned size, size_t count) :
+    m_rank(0),
+    m_size(size),
+    m_count((count + 7) / 8 * 8),
+    m_segment(nullptr),
+    m_segmentBytes(headerBytes + size * m_count * sizeof(double)),
+    m_parent(0)
+{
+    // The name only lives until the segment is mapped
+    const string name = "/network-allreduce-" + to_string(getpid());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0)
+    {
+        throw runtime_error("Unable to create shared memory " + name);
+    }
+    shm_unlink(name.c_str());
+
+    if (ftruncate(fd, m_segmentBytes) != 0)
+    {
+        close(fd);
+        throw runtime_error("Unable to size shared memory " + name);
+    }
+    m_segment = mmap(nullptr, m_segmentBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (m_segment == MAP_FAILED)
+    {
+        throw runtime_error("Unable to map shared memory " + name);
+    }
+
+    Header *header = new (m_segment) Header;
+    header->waiting.store(0);
+    header->generation.store(0);
+}
+
+ProcessGroup *ProcessGroup::launch(unsigned processes, size_t count)
+{
+    ProcessGroup *group = new ProcessGroup(processes, count);
+    group->m_parent = getpid();
+
+    for (unsigned rank = 1; rank < processes; ++rank)
+    {
+        pid_t pid = fork();
+        if (pid < 0)
+        {
+            // Do not leave the ranks forked so far waiting for this one
+            for (pid_t child : group->m_children)
+            {
+                kill(child, SIGKILL);
+            }
+            delete group;
+            throw runtime_error("Unable to fork rank " + to_string(rank));
+        }
+        if (pid == 0)
+        {
+            // The child only knows its own rank, and dies with rank 0 (which may be gone already)
+            prctl(PR_SET_PDEATHSIG, SIGKILL);
+            if (getppid() != group->m_parent)
+            {
+                _exit(1);
+            }
+            group->m_rank = rank;
+            group->m_children.clear();
+            return group;
+        }
+        group->m_children.push_back(pid);
+    }
+    return group;
+}
+
+ProcessGroup::~ProcessGroup()
+{
+    for (pid_t child : m_children)
+    {
+        waitpid(child, nullptr, 0);
+    }
+    munmap(m_segment, m_segmentBytes);
+}
+
+double *ProcessGroup::buffer(unsigned rank)
+{
+    return reinterpret_cast<double *>(static_cast<char *>(m_segment) + headerBytes) + rank * m_count;
+}
+
+void ProcessGroup::barrier()
+{
+    Header *header = static_cast<Header *>(m_segment);
+    const unsigned generation = header->generation.load(memory_order_acquire);
+
+    if (header->waiting.fetch_add(1, memory_order_acq_rel) == m_size - 1)
+    {
+        header->waiting.store(0, memory_order_relaxed);
+        header->generation.fetch_add(1, memory_order_release);
+        return;
+    }
+    for (unsigned spins = 1; header->generation.load(memory_order_acquire) == generation; ++spins)
+    {
+        sched_yield();
+        if (spins % livenessInterval == 0)
+        {
+            checkAlive(generation);
+        }
+    }
+}
+
+void ProcessGroup::checkAlive(unsigned generation)
+{
+    // The other ranks are killed when rank 0 exits (see launch())
+    if (m_rank > 0)
+    {
+        if (getppid() != m_parent)
+        {
+            _exit(1);
+        }
+        return;
+    }
+
+    Header *header = static_cast<Header *>(m_segment);
+    for (auto child = m_children.begin(); child != m_children.end(); ++child)
+    {
+        int status;
+        if (waitpid(*child, &status, WNOHANG) == *child)
+        {
+            m_children.erase(child);
+            // Rank that passed the barrier and finished in the meantime
+            if (header->generation.load(memory_order_acquire) != generation)
+            {
+                return;
+            }
+            // The others wait at the barrier forever, the destructor would wait for them
+            for (pid_t other : m_children)
+            {
+                kill(other, SIGKILL);
+            }
+            throw runtime_error("A process of the group exited during training");
+        }
+    }
+}
+
+void ProcessGroup::allreduce(double *values, size_t count)
+{
+    if (m_size == 1)
+    {
+        return;
+    }
+
+    const unsigned size = m_size, left = (m_rank + size - 1) % size;
+    double *own = buffer(m_rank);
+    const double *previous = buffer(left);
+
+    // Chunk boundaries, aligned to cache lines
+    const size_t chunk = (count + size - 1) / size;
+    const size_t chunkSize = (chunk + 7) / 8 * 8;
+    auto begin = [&](unsigned c) { return min(count, c * chunkSize); };
+    auto end = [&](unsigned c) { return min(count, (c + 1) * chunkSize); };
+
+    copy(values, values + count, own);
+    barrier();
+
+    // Reduce-scatter: in step s, add the left neighbour's partial sum of chunk (rank - s - 1)
+    for (unsigned s = 0; s + 1 < size; ++s)
+    {
+        const unsigned c = (m_rank + 2 * size - s - 1) % size;
+        for (size_t k = begin(c); k < end(c); ++k)
+        {
+            own[k] += previous[k];
+        }
+        barrier();
+    }
+
+    // Allgather: in step s, copy the reduced chunk (rank - s) from the left neighbour
+    for (unsigned s = 0; s + 1 < size; ++s)
+    {
+        const unsigned c = (m_rank + size - s) % size;
+        copy(previous + begin(c), previous + end(c), own + begin(c));
+        barrier();
+    }
+
+    copy(own, own + count, values);
+}
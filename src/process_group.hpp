@@ -0,0 +1,139 @@
+/**
+ * @file process_group.hpp
+ * @brief Declaration of the ProcessGroup class for multi-process data-parallel training.
+ */
+#ifndef PROCESS_GROUP_HPP
+#define PROCESS_GROUP_HPP
+
+#include <cstddef>
+#include <vector>
+#include <sys/types.h>
+
+using namespace std;
+
+/**
+ * @class ProcessGroup
+ * @brief Processes training one model together, communicating through POSIX shared memory.
+ *
+ * The group is created by fork(): the launching process becomes rank 0 and the children
+ * ranks 1 to size() - 1, all continuing from the launch() call. The shared segment holds
+ * a barrier and one buffer of `count` doubles per rank; it is unlinked right after being
+ * mapped, so nothing is left behind if a process dies. The other ranks are killed when
+ * rank 0 exits, and rank 0 stops waiting at a barrier once another rank has exited.
+ */
+class ProcessGroup
+{
+private:
+    /**
+     * @brief Header at the start of the shared segment.
+     */
+    struct Header;
+
+    /**
+     * @brief Rank of this process.
+     */
+    unsigned m_rank;
+
+    /**
+     * @brief Number of processes.
+     */
+    unsigned m_size;
+
+    /**
+     * @brief Number of doubles in the buffer of each rank.
+     */
+    size_t m_count;
+
+    /**
+     * @brief Mapping of the shared segment.
+     */
+    void *m_segment;
+
+    /**
+     * @brief Size of the mapping in bytes.
+     */
+    size_t m_segmentBytes;
+
+    /**
+     * @brief Process ids of the other ranks (rank 0 only).
+     */
+    vector<pid_t> m_children;
+
+    /**
+     * @brief Process id of rank 0.
+     */
+    pid_t m_parent;
+
+    /**
+     * @brief Constructor for the ProcessGroup class, see launch().
+     */
+    ProcessGroup(unsigned size, size_t count);
+
+    /**
+     * @brief Get the shared buffer of a rank.
+     * @param rank The rank.
+     */
+    double *buffer(unsigned rank);
+
+    /**
+     * @brief Check from a barrier that no other process of the group has died.
+     *
+     * Rank 0 reaps its children without blocking, the other ranks exit if rank 0 is gone.
+     *
+     * @param generation Generation of the barrier being waited for.
+     * @throws std::runtime_error in rank 0 if another rank exited before reaching the barrier
+     * (after killing the remaining ranks).
+     */
+    void checkAlive(unsigned generation);
+
+public:
+    /**
+     * @brief Fork the processes of a group.
+     *
+     * @param processes Number of processes, including the calling one.
+     * @param count Maximum number of doubles reduced by allreduce().
+     * @return The group, in every process of it (with a different rank()).
+     * @throws std::runtime_error if the shared memory cannot be created or a fork fails.
+     */
+    static ProcessGroup *launch(unsigned processes, size_t count);
+
+    ProcessGroup(const ProcessGroup &) = delete;
+    ProcessGroup &operator=(const ProcessGroup &) = delete;
+
+    /**
+     * @brief Destructor, rank 0 waits for the other ranks to exit.
+     */
+    ~ProcessGroup();
+
+    /**
+     * @brief Get the rank of this process.
+     */
+    unsigned rank() const { return m_rank; }
+
+    /**
+     * @brief Get the number of processes.
+     */
+    unsigned size() const { return m_size; }
+
+    /**
+     * @brief Wait until all processes reach the barrier.
+     * @throws std::runtime_error in rank 0 if another rank exited instead.
+     */
+    void barrier();
+
+    /**
+     * @brief Sum an array element-wise over all processes, in place.
+     *
+     * Ring allreduce: the array is split into size() chunks, in size() - 1 reduce-scatter
+     * steps every rank adds the chunk its left neighbour has accumulated so far to its
+     * own, after which every rank holds one fully reduced chunk; size() - 1 allgather steps
+     * then pass the reduced chunks around the ring. Each chunk is summed by one rank only,
+     * so all processes end up with bitwise identical results.
+     *
+     * @param values The array, of the same length in all processes.
+     * @param count Number of doubles, at most the count passed to launch().
+     */
+    void allreduce(double *values, size_t count);
+};
+
+#endif // PROCESS_GROUP_HPP
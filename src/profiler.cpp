@@ -0,0 +1,272 @@
+/**
+ * @file profiler.cpp
+ * @brief Implementation of the per-phase timers and hardware counters.
+ */
+
+#include "profiler.hpp"
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+
+Profiler::Profiler()
+{
+    for (atomic<uint64_t> &nanoseconds : m_current)
+    {
+        nanoseconds.store(0, memory_order_relaxed);
+    }
+}
+
+Profiler &Profiler::instance()
+{
+    static Profiler profiler;
+    return profiler;
+}
+
+const char *Profiler::phaseName(Phase phase)
+{
+    static const char *names[] = {"load", "data", "forward", "backward", "pipeline",
+                                  "reduce", "update", "hogwild", "evaluate", "test"};
+    return names[static_cast<unsigned>(phase)];
+}
+
+void Profiler::endRow(const string &label, unsigned samples)
+{
+    Row row;
+    row.label = label;
+    row.samples = samples;
+    for (unsigned phase = 0; phase < phases; ++phase)
+    {
+        row.nanoseconds[phase] = m_current[phase].exchange(0, memory_order_relaxed);
+    }
+    m_rows.push_back(row);
+}
+
+void Profiler::print(ostream &out) const
+{
+    // Training phases, their time gives the throughput
+    auto training = [](unsigned phase) {
+        return phase != static_cast<unsigned>(Phase::Load) && phase != static_cast<unsigned>(Phase::Evaluate) &&
+               phase != static_cast<unsigned>(Phase::Test);
+    };
+
+    // Only the phases that ran
+    Row sum{"all", {}, 0};
+    for (const Row &row : m_rows)
+    {
+        for (unsigned phase = 0; phase < phases; ++phase)
+        {
+            sum.nanoseconds[phase] += row.nanoseconds[phase];
+        }
+        sum.samples += row.samples;
+    }
+    vector<unsigned> shown;
+    uint64_t total = 0;
+    for (unsigned phase = 0; phase < phases; ++phase)
+    {
+        if (sum.nanoseconds[phase] > 0)
+        {
+            shown.push_back(phase);
+            total += sum.nanoseconds[phase];
+        }
+    }
+
+    out << "--------------------------------------------------" << endl;
+    out << "Time per phase [s]" << endl;
+    out << setw(8) << "epoch";
+    for (unsigned phase : shown)
+    {
+        out << setw(10) << phaseName(static_cast<Phase>(phase));
+    }
+    out << setw(10) << "total" << setw(12) << "samples/s" << endl;
+
+    auto printRow = [&](const Row &row) {
+        uint64_t rowTotal = 0, trainingTotal = 0;
+        out << setw(8) << row.label << fixed << setprecision(3);
+        for (unsigned phase : shown)
+        {
+            out << setw(10) << row.nanoseconds[phase] * 1e-9;
+            rowTotal += row.nanoseconds[phase];
+            trainingTotal += training(phase) ? row.nanoseconds[phase] : 0;
+        }
+        out << setw(10) << rowTotal * 1e-9 << setprecision(0) << setw(12);
+        if (row.samples > 0 && trainingTotal > 0)
+        {
+            out << row.samples / (trainingTotal * 1e-9);
+        }
+        else
+        {
+            out << "-";
+        }
+        out << defaultfloat << setprecision(6) << endl;
+    };
+    for (const Row &row : m_rows)
+    {
+        printRow(row);
+    }
+    printRow(sum);
+
+    out << setw(8) << "share" << fixed << setprecision(1);
+    for (unsigned phase : shown)
+    {
+        out << setw(9) << 100.0 * sum.nanoseconds[phase] / total << "%";
+    }
+    out << setw(9) << 100.0 << "%" << defaultfloat << setprecision(6) << endl;
+}
+
+// ---------------------------------------------------------------------------
+// PerfCounters
+// ---------------------------------------------------------------------------
+
+PerfCounters::PerfCounters() :
+    m_leader(-1),
+    m_enabled(false),
+    m_totals{}
+{
+    m_fds.fill(-1);
+}
+
+PerfCounters::~PerfCounters()
+{
+    for (int fd : m_fds)
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+    }
+}
+
+PerfCounters &PerfCounters::instance()
+{
+    static PerfCounters counters;
+    return counters;
+}
+
+string PerfCounters::start()
+{
+    // Type and configuration of every counter
+    const pair<uint32_t, uint64_t> events[Count] = {
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                             (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    };
+
+    string error;
+    for (unsigned counter = 0; counter < Count; ++counter)
+    {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = events[counter].first;
+        attr.config = events[counter].second;
+        attr.disabled = m_leader < 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        // Calling thread, any CPU
+        const int fd = syscall(SYS_perf_event_open, &attr, 0, -1, m_leader, 0);
+        if (fd < 0)
+        {
+            error = strerror(errno);
+            continue;
+        }
+        m_fds[counter] = fd;
+        m_order.push_back(static_cast<Counter>(counter));
+        if (m_leader < 0)
+        {
+            m_leader = fd;
+        }
+    }
+    if (m_leader < 0)
+    {
+        return error;
+    }
+
+    ioctl(m_leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(m_leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    m_owner = this_thread::get_id();
+    m_enabled.store(true, memory_order_relaxed);
+    return "";
+}
+
+void PerfCounters::read(Values &values) const
+{
+    // Number of counters, time enabled, time running, the values
+    uint64_t buffer[3 + Count] = {};
+    values.fill(0);
+    if (::read(m_leader, buffer, sizeof(buffer)) <= 0 || buffer[2] == 0)
+    {
+        return;
+    }
+
+    // Extrapolate when the group only ran part of the time
+    const double scale = double(buffer[1]) / buffer[2];
+    for (unsigned i = 0; i < buffer[0] && i < m_order.size(); ++i)
+    {
+        values[m_order[i]] = buffer[3 + i] * scale;
+    }
+}
+
+void PerfCounters::add(Phase phase, const Values &begin, const Values &end)
+{
+    Values &totals = m_totals[static_cast<unsigned>(phase)];
+    for (unsigned counter = 0; counter < Count; ++counter)
+    {
+        totals[counter] += end[counter] > begin[counter] ? end[counter] - begin[counter] : 0;
+    }
+}
+
+void PerfCounters::print(ostream &out) const
+{
+    auto available = [this](Counter counter) { return m_fds[counter] >= 0; };
+
+    out << "--------------------------------------------------" << endl;
+    out << "Hardware counters per phase (main thread, misses per 1000 instructions)" << endl;
+    out << setw(10) << "phase" << setw(16) << "cycles" << setw(16) << "instructions" << setw(8) << "IPC"
+        << setw(10) << "L1D MPKI" << setw(10) << "LLC MPKI" << setw(13) << "branch MPKI" << endl;
+
+    for (unsigned phase = 0; phase < phases; ++phase)
+    {
+        const Values &totals = m_totals[phase];
+        if (totals[Cycles] == 0 && totals[Instructions] == 0)
+        {
+            continue;
+        }
+
+        out << setw(10) << Profiler::phaseName(static_cast<Phase>(phase)) << fixed << setprecision(2);
+        out << setw(16);
+        available(Cycles) ? out << totals[Cycles] : out << "-";
+        out << setw(16);
+        available(Instructions) ? out << totals[Instructions] : out << "-";
+        out << setw(8);
+        if (available(Cycles) && available(Instructions) && totals[Cycles] > 0)
+        {
+            out << double(totals[Instructions]) / totals[Cycles];
+        }
+        else
+        {
+            out << "-";
+        }
+        for (Counter counter : {L1Misses, LlcMisses, BranchMisses})
+        {
+            out << setw(counter == BranchMisses ? 13 : 10);
+            if (available(counter) && available(Instructions) && totals[Instructions] > 0)
+            {
+                out << 1000.0 * totals[counter] / totals[Instructions];
+            }
+            else
+            {
+                out << "-";
+            }
+        }
+        out << defaultfloat << setprecision(6) << endl;
+    }
+}
@@ -0,0 +1,428 @@
+/**
+ * @file profiler.hpp
+ * @brief Declaration of the per-phase timers and hardware counters of a training run.
+ *
+ * The timers are only compiled in with `-DPROFILE` (`make network_profile`); otherwise
+ * the PROFILE_* macros expand to nothing and cost nothing, except that PROFILE_SCOPE
+ * still attributes the hardware counters to the phase when they were started at run time
+ * (PerfCounters::start()), which costs one relaxed load when they were not.
+ */
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <array>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <thread>
+
+using namespace std;
+
+/**
+ * @enum Phase
+ * @brief Phases of a run the time is attributed to.
+ */
+enum class Phase
+{
+    /**
+     * @brief Reading and parsing the dataset files.
+     */
+    Load,
+
+    /**
+     * @brief Shuffling and gathering the samples of the batches.
+     */
+    Data,
+
+    /**
+     * @brief Forward passes of the training batches.
+     */
+    Forward,
+
+    /**
+     * @brief Backward passes of the training batches.
+     */
+    Backward,
+
+    /**
+     * @brief Forward and backward passes run by a pipeline, which overlap.
+     */
+    Pipeline,
+
+    /**
+     * @brief Averaging the gradients (including the allreduce of a process group).
+     */
+    Reduce,
+
+    /**
+     * @brief Weight updates.
+     */
+    Update,
+
+    /**
+     * @brief Whole Hogwild epochs, whose phases run concurrently on the workers.
+     */
+    Hogwild,
+
+    /**
+     * @brief Loss and accuracy passes after every epoch.
+     */
+    Evaluate,
+
+    /**
+     * @brief Predictions on the training and testing sets.
+     */
+    Test,
+
+    /**
+     * @brief Number of phases.
+     */
+    Count
+};
+
+/**
+ * @class Profiler
+ * @brief Time spent in every phase, one row per epoch.
+ *
+ * Timers add to the current row; endRow() closes it. Adding is a relaxed atomic
+ * addition, so timers may run on any thread.
+ */
+class Profiler
+{
+private:
+    /**
+     * @brief Number of phases.
+     */
+    static const unsigned phases = static_cast<unsigned>(Phase::Count);
+
+    /**
+     * @brief A closed row.
+     */
+    struct Row
+    {
+        /**
+         * @brief Label of the row ("setup", the epoch number, "test").
+         */
+        string label;
+
+        /**
+         * @brief Nanoseconds of every phase.
+         */
+        array<uint64_t, phases> nanoseconds;
+
+        /**
+         * @brief Number of training samples processed in the row.
+         */
+        unsigned samples;
+    };
+
+    /**
+     * @brief Nanoseconds of every phase in the current row.
+     */
+    array<atomic<uint64_t>, phases> m_current;
+
+    /**
+     * @brief The closed rows.
+     */
+    vector<Row> m_rows;
+
+    /**
+     * @brief Constructor for the Profiler class, use instance().
+     */
+    Profiler();
+
+public:
+    /**
+     * @brief Get the profiler of the process.
+     */
+    static Profiler &instance();
+
+    /**
+     * @brief Get the name of a phase.
+     */
+    static const char *phaseName(Phase phase);
+
+    /**
+     * @brief Add time to a phase of the current row.
+     * @param phase The phase.
+     * @param nanoseconds The time.
+     */
+    void add(Phase phase, uint64_t nanoseconds)
+    {
+        m_current[static_cast<unsigned>(phase)].fetch_add(nanoseconds, memory_order_relaxed);
+    }
+
+    /**
+     * @brief Close the current row and start a new one.
+     * @param label Label of the row.
+     * @param samples Number of training samples processed in the row, 0 if it is no epoch.
+     */
+    void endRow(const string &label, unsigned samples);
+
+    /**
+     * @brief Print the rows as a table of seconds per phase, with the share of every phase
+     * and the training throughput (samples per second of the training phases).
+     * @param out The stream.
+     */
+    void print(ostream &out) const;
+};
+
+/**
+ * @class ScopedTimer
+ * @brief Adds the lifetime of the timer to a phase.
+ */
+class ScopedTimer
+{
+private:
+    /**
+     * @brief The phase.
+     */
+    Phase m_phase;
+
+    /**
+     * @brief Creation time.
+     */
+    chrono::steady_clock::time_point m_start;
+
+public:
+    /**
+     * @brief Constructor for the ScopedTimer class, starting the timer.
+     * @param phase The phase.
+     */
+    explicit ScopedTimer(Phase phase) : m_phase(phase), m_start(chrono::steady_clock::now()) {}
+
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+    /**
+     * @brief Destructor, adding the elapsed time to the phase.
+     */
+    ~ScopedTimer()
+    {
+        const auto elapsed = chrono::steady_clock::now() - m_start;
+        Profiler::instance().add(m_phase, chrono::duration_cast<chrono::nanoseconds>(elapsed).count());
+    }
+};
+
+/**
+ * @class PerfCounters
+ * @brief Hardware performance counters of the main thread, summed per phase.
+ *
+ * Counts cycles, instructions, L1 data cache read misses, last-level cache misses and
+ * branch misses of user code with `perf_event_open` as one group, scaled when the kernel
+ * multiplexes it. Counters the processor or the kernel does not offer are left out;
+ * without any (no PMU, e.g. in some virtual machines, or `perf_event_paranoid` too high)
+ * start() fails and nothing is counted. Only the thread that called start() is counted:
+ * the work of pipeline stages and Hogwild workers on other threads is not included.
+ */
+class PerfCounters
+{
+public:
+    /**
+     * @brief The counters.
+     */
+    enum Counter
+    {
+        /**
+         * @brief CPU cycles.
+         */
+        Cycles,
+
+        /**
+         * @brief Retired instructions.
+         */
+        Instructions,
+
+        /**
+         * @brief L1 data cache read misses.
+         */
+        L1Misses,
+
+        /**
+         * @brief Last-level cache misses.
+         */
+        LlcMisses,
+
+        /**
+         * @brief Mispredicted branches.
+         */
+        BranchMisses,
+
+        /**
+         * @brief Number of counters.
+         */
+        Count
+    };
+
+    /**
+     * @brief Values of all counters.
+     */
+    typedef array<uint64_t, Count> Values;
+
+private:
+    /**
+     * @brief Number of phases.
+     */
+    static const unsigned phases = static_cast<unsigned>(Phase::Count);
+
+    /**
+     * @brief File descriptor of the group leader, -1 if not counting.
+     */
+    int m_leader;
+
+    /**
+     * @brief File descriptors of all counters, -1 for those not available.
+     */
+    array<int, Count> m_fds;
+
+    /**
+     * @brief The counters in the order of the group, as read from the leader.
+     */
+    vector<Counter> m_order;
+
+    /**
+     * @brief The counted thread.
+     */
+    thread::id m_owner;
+
+    /**
+     * @brief Whether the counters are running.
+     */
+    atomic<bool> m_enabled;
+
+    /**
+     * @brief Counts of every phase.
+     */
+    array<Values, phases> m_totals;
+
+    /**
+     * @brief Constructor for the PerfCounters class, use instance().
+     */
+    PerfCounters();
+
+public:
+    /**
+     * @brief Destructor, closing the counters.
+     */
+    ~PerfCounters();
+
+    /**
+     * @brief Get the counters of the process.
+     */
+    static PerfCounters &instance();
+
+    /**
+     * @brief Open and start the counters for the calling thread.
+     * @return The reason when no counter is available, empty on success.
+     */
+    string start();
+
+    /**
+     * @brief Stop attributing counts (e.g. in the processes of a group except the first,
+     * which inherit the counters of the first one's thread).
+     */
+    void stop() { m_enabled.store(false, memory_order_relaxed); }
+
+    /**
+     * @brief Whether the counters run and the calling thread is the counted one.
+     */
+    bool counting() const { return m_enabled.load(memory_order_relaxed) && this_thread::get_id() == m_owner; }
+
+    /**
+     * @brief Read the current values of the counters (0 for those not available).
+     * @param values Output for the values.
+     */
+    void read(Values &values) const;
+
+    /**
+     * @brief Add the counts between two reads to a phase.
+     * @param phase The phase.
+     * @param begin Values at the beginning.
+     * @param end Values at the end.
+     */
+    void add(Phase phase, const Values &begin, const Values &end);
+
+    /**
+     * @brief Print the counts of every phase that ran, with IPC and misses per thousand instructions.
+     * @param out The stream.
+     */
+    void print(ostream &out) const;
+};
+
+/**
+ * @class CounterScope
+ * @brief Adds the hardware counts of its lifetime to a phase, if the counters run on the calling thread.
+ */
+class CounterScope
+{
+private:
+    /**
+     * @brief The phase.
+     */
+    Phase m_phase;
+
+    /**
+     * @brief Whether the counters were read at the beginning.
+     */
+    bool m_counting;
+
+    /**
+     * @brief Values at the beginning.
+     */
+    PerfCounters::Values m_begin;
+
+public:
+    /**
+     * @brief Constructor for the CounterScope class, reading the counters.
+     * @param phase The phase.
+     */
+    explicit CounterScope(Phase phase) : m_phase(phase), m_counting(PerfCounters::instance().counting())
+    {
+        if (m_counting)
+        {
+            PerfCounters::instance().read(m_begin);
+        }
+    }
+
+    CounterScope(const CounterScope &) = delete;
+    CounterScope &operator=(const CounterScope &) = delete;
+
+    /**
+     * @brief Destructor, adding the counts to the phase.
+     */
+    ~CounterScope()
+    {
+        if (m_counting)
+        {
+            PerfCounters::Values end;
+            PerfCounters::instance().read(end);
+            PerfCounters::instance().add(m_phase, m_begin, end);
+        }
+    }
+};
+
+#ifdef PROFILE
+/**
+ * @brief Attribute the rest of the enclosing scope to a phase.
+ */
+#define PROFILE_SCOPE(phase) ScopedTimer profileTimer(Phase::phase); CounterScope profileCounters(Phase::phase)
+
+/**
+ * @brief Close the current row of the profiler.
+ */
+#define PROFILE_ROW(label, samples) Profiler::instance().endRow(label, samples)
+
+/**
+ * @brief Print the table of the profiler.
+ */
+#define PROFILE_REPORT(out) Profiler::instance().print(out)
+#else
+#define PROFILE_SCOPE(phase) CounterScope profileCounters(Phase::phase)
+#define PROFILE_ROW(label, samples) ((void)0)
+#define PROFILE_REPORT(out) ((void)0)
+#endif
+
+#endif // PROFILER_HPP
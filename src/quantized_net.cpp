@@ -0,0 +1,217 @@
+/**
+ * @file quantized_net.cpp
+ * @brief Implementation of the QuantizedNet int8 inference engine.
+ */
+
+#include "quantized_net.hpp"
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+QuantizedNet::QuantizedNet(const Net &net, InputData &calibrationInputs)
+{
+    if (net.getActivation() != Activation::ReLU)
+    {
+        throw invalid_argument("Only networks with ReLU hidden layers can be quantized");
+    }
+
+    const vector<unsigned> &topology = net.getTopology();
+
+    // Float copy of the weights, only needed for calibration
+    vector<vector<float>> floatWeights(topology.size() - 1);
+    unsigned maxWidth = 0;
+
+    for (unsigned layerNum = 0; layerNum < topology.size() - 1; ++layerNum)
+    {
+        QuantizedLayer layer;
+        layer.numInputs = topology[layerNum];
+        layer.numOutputs = topology[layerNum + 1];
+        layer.stride = (layer.numInputs + 63) / 64 * 64;
+        layer.weights.assign(layer.numOutputs * layer.stride, 0);
+        layer.weightScales.resize(layer.numOutputs);
+        layer.biases.resize(layer.numOutputs);
+        layer.inputScale = 1.0f;
+
+        vector<float> &weights = floatWeights[layerNum];
+        weights.resize(layer.numOutputs * layer.numInputs);
+
+        for (unsigned j = 0; j < layer.numOutputs; ++j)
+        {
+            // Symmetric per-output-channel scale
+            float maxAbs = 0.0f;
+            for (unsigned i = 0; i < layer.numInputs; ++i)
+            {
+                weights[j * layer.numInputs + i] = net.getWeight(layerNum, i, j);
+                maxAbs = max(maxAbs, fabs(weights[j * layer.numInputs + i]));
+            }
+            layer.weightScales[j] = maxAbs > 0.0f ? maxAbs / 127.0f : 1.0f;
+            layer.biases[j] = net.getWeight(layerNum, layer.numInputs, j);
+
+            for (unsigned i = 0; i < layer.numInputs; ++i)
+            {
+                float q = nearbyintf(weights[j * layer.numInputs + i] / layer.weightScales[j]);
+                layer.weights[j * layer.stride + i] = static_cast<int8_t>(max(-127.0f, min(127.0f, q)));
+            }
+        }
+
+        maxWidth = max(maxWidth, max(layer.stride, layer.numOutputs));
+        m_layers.push_back(layer);
+    }
+
+    m_quantInput.assign(maxWidth, 0);
+    m_outputs.assign(maxWidth, 0.0f);
+
+    // Calibrate the input range of every layer by running the float model on the validation split
+    vector<float> maxInput(m_layers.size(), 0.0f);
+    vector<float> actIn(maxWidth), actOut(maxWidth);
+
+    calibrationInputs.resetIndex();
+    for (unsigned s = 0; s < calibrationInputs.validLength(); ++s)
+    {
+        const vector<double> &input = calibrationInputs.getNextValid();
+        for (unsigned i = 0; i < input.size(); ++i)
+        {
+            actIn[i] = input[i];
+        }
+
+        for (unsigned layerNum = 0; layerNum < m_layers.size(); ++layerNum)
+        {
+            const QuantizedLayer &layer = m_layers[layerNum];
+            const vector<float> &weights = floatWeights[layerNum];
+
+            for (unsigned i = 0; i < layer.numInputs; ++i)
+            {
+                maxInput[layerNum] = max(maxInput[layerNum], actIn[i]);
+            }
+
+            for (unsigned j = 0; j < layer.numOutputs; ++j)
+            {
+                float potential = layer.biases[j];
+                for (unsigned i = 0; i < layer.numInputs; ++i)
+                {
+                    potential += weights[j * layer.numInputs + i] * actIn[i];
+                }
+                actOut[j] = max(0.0f, potential);
+            }
+            swap(actIn, actOut);
+        }
+    }
+    calibrationInputs.resetIndex();
+
+    for (unsigned layerNum = 0; layerNum < m_layers.size(); ++layerNum)
+    {
+        m_layers[layerNum].inputScale = maxInput[layerNum] > 0.0f ? maxInput[layerNum] / 255.0f : 1.0f;
+    }
+}
+
+int32_t QuantizedNet::dotProduct(const uint8_t *a, const int8_t *b, unsigned n)
+{
+#if defined(__AVX512VNNI__) && defined(__AVX512BW__)
+    __m512i acc = _mm512_setzero_si512();
+    for (unsigned i = 0; i < n; i += 64)
+    {
+        __m512i va = _mm512_loadu_si512(a + i);
+        __m512i vb = _mm512_loadu_si512(b + i);
+        acc = _mm512_dpbusd_epi32(acc, va, vb);
+    }
+    alignas(64) int32_t lanes[16];
+    _mm512_store_si512(lanes, acc);
+    int32_t sum = 0;
+    for (unsigned i = 0; i < 16; ++i)
+    {
+        sum += lanes[i];
+    }
+    return sum;
+#elif defined(__AVX2__)
+    // Widen to int16 first, _mm256_maddubs_epi16 would saturate on 255 * 127 pairs
+    __m256i acc = _mm256_setzero_si256();
+    for (unsigned i = 0; i < n; i += 16)
+    {
+        __m256i va = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i)));
+        __m256i vb = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i)));
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(va, vb));
+    }
+    __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    sum = _mm_hadd_epi32(sum, sum);
+    sum = _mm_hadd_epi32(sum, sum);
+    return _mm_cvtsi128_si32(sum);
+#else
+    int32_t acc = 0;
+    for (unsigned i = 0; i < n; ++i)
+    {
+        acc += static_cast<int32_t>(a[i]) * static_cast<int32_t>(b[i]);
+    }
+    return acc;
+#endif
+}
+
+void QuantizedNet::quantizeInput(const float *values, const QuantizedLayer &layer)
+{
+    const float invScale = 1.0f / layer.inputScale;
+    for (unsigned i = 0; i < layer.numInputs; ++i)
+    {
+        float q = nearbyintf(values[i] * invScale);
+        m_quantInput[i] = static_cast<uint8_t>(max(0.0f, min(255.0f, q)));
+    }
+    // Padding is kept at zero so it does not contribute to the dot products
+    fill(m_quantInput.begin() + layer.numInputs, m_quantInput.begin() + layer.stride, 0);
+}
+
+void QuantizedNet::feedForward(const vector<double> &inputVals)
+{
+    assert(inputVals.size() == m_layers[0].numInputs);
+
+    for (unsigned i = 0; i < inputVals.size(); ++i)
+    {
+        m_outputs[i] = inputVals[i];
+    }
+
+    for (unsigned layerNum = 0; layerNum < m_layers.size(); ++layerNum)
+    {
+        const QuantizedLayer &layer = m_layers[layerNum];
+        const bool isOutput = layerNum == m_layers.size() - 1;
+
+        quantizeInput(m_outputs.data(), layer);
+
+        for (unsigned j = 0; j < layer.numOutputs; ++j)
+        {
+            int32_t acc = dotProduct(m_quantInput.data(), &layer.weights[j * layer.stride], layer.stride);
+            float potential = acc * layer.inputScale * layer.weightScales[j] + layer.biases[j];
+            m_outputs[j] = isOutput ? potential : max(0.0f, potential);
+        }
+    }
+
+    // Softmax on the output layer
+    const unsigned numOutputs = m_layers.back().numOutputs;
+    float maxPotential = *max_element(m_outputs.begin(), m_outputs.begin() + numOutputs);
+    float expSum = 0.0f;
+    for (unsigned j = 0; j < numOutputs; ++j)
+    {
+        m_outputs[j] = exp(m_outputs[j] - maxPotential);
+        expSum += m_outputs[j];
+    }
+    for (unsigned j = 0; j < numOutputs; ++j)
+    {
+        m_outputs[j] /= expSum;
+    }
+}
+
+void QuantizedNet::getResults(vector<double> &resultVals) const
+{
+    resultVals.assign(m_outputs.begin(), m_outputs.begin() + m_layers.back().numOutputs);
+}
+
+size_t QuantizedNet::weightBytes() const
+{
+    size_t bytes = 0;
+    for (const QuantizedLayer &layer : m_layers)
+    {
+        bytes += layer.weights.size() * sizeof(int8_t);
+        bytes += (layer.weightScales.size() + layer.biases.size() + 1) * sizeof(float);
+    }
+    return bytes;
+}
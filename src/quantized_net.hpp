@@ -0,0 +1,137 @@
+/**
+ * @file quantized_net.hpp
+ * @brief Declaration of the QuantizedNet class, an int8 inference engine for a trained Net.
+ */
+#ifndef QUANTIZED_NET_HPP
+#define QUANTIZED_NET_HPP
+
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include "net.hpp"
+#include "input_data.hpp"
+
+using namespace std;
+
+/**
+ * @struct QuantizedLayer
+ * @brief Int8 weights of the connections leading into one layer of the network.
+ *
+ * Weights are stored row-major per output neuron, each row padded with zeros to
+ * `stride` so the dot-product kernels never need a scalar tail.
+ */
+struct QuantizedLayer
+{
+    /**
+     * @brief Number of neurons of the previous layer.
+     */
+    unsigned numInputs;
+
+    /**
+     * @brief Number of neurons of the layer.
+     */
+    unsigned numOutputs;
+
+    /**
+     * @brief Length of a weight row, numInputs rounded up to a multiple of 64.
+     */
+    unsigned stride;
+
+    /**
+     * @brief Int8 weights [numOutputs][stride].
+     */
+    vector<int8_t> weights;
+
+    /**
+     * @brief Scale of the weights of every output neuron.
+     */
+    vector<float> weightScales;
+
+    /**
+     * @brief Float biases.
+     */
+    vector<float> biases;
+
+    /**
+     * @brief Quantization scale of the layer input.
+     */
+    float inputScale;
+};
+
+/**
+ * @class QuantizedNet
+ * @brief Post-training int8 quantization of a trained Net used for inference only.
+ *
+ * Weights are quantized symmetrically with one scale per output neuron, layer inputs
+ * (which are non-negative thanks to ReLU) are quantized to uint8 with one scale per layer
+ * calibrated on the validation split. Dot products run in int32 using SIMD integer
+ * multiply-add instructions (AVX-512 VNNI or AVX2 when available).
+ */
+class QuantizedNet
+{
+private:
+    /**
+     * @brief Quantized layers, `m_layers[i]` computes the outputs of layer `i + 1` of the Net.
+     */
+    vector<QuantizedLayer> m_layers;
+
+    /**
+     * @brief Quantized input of the layer being computed.
+     */
+    vector<uint8_t> m_quantInput;
+
+    /**
+     * @brief Real-valued outputs of the layer being computed.
+     */
+    vector<float> m_outputs;
+
+    /**
+     * @brief Dot product of a uint8 and an int8 vector.
+     * @param a Unsigned activations.
+     * @param b Signed weights.
+     * @param n Length of both vectors, a multiple of 64.
+     * @return Exact int32 dot product.
+     */
+    static int32_t dotProduct(const uint8_t *a, const int8_t *b, unsigned n);
+
+    /**
+     * @brief Quantize real-valued activations into `m_quantInput`.
+     * @param values Activations to quantize.
+     * @param layer Layer whose input scale and stride are used.
+     */
+    void quantizeInput(const float *values, const QuantizedLayer &layer);
+
+public:
+    /**
+     * @brief Quantize the weights of a trained net and calibrate activation scales.
+     *
+     * Activation ranges are measured by running the float model over the validation
+     * split of `calibrationInputs` (as produced by InputData::splitData).
+     *
+     * @param net Trained network to quantize.
+     * @param calibrationInputs Input data with the validation split set up.
+     * @throws std::invalid_argument if the hidden layers do not use ReLU.
+     */
+    QuantizedNet(const Net &net, InputData &calibrationInputs);
+
+    /**
+     * @brief Perform a quantized feedforward pass.
+     * @param inputVals Vector containing the input values to the network.
+     */
+    void feedForward(const vector<double> &inputVals);
+
+    /**
+     * @brief Get the results (softmax probabilities) of the last feedforward pass.
+     * @param resultVals Vector to store the output values.
+     */
+    void getResults(vector<double> &resultVals) const;
+
+    /**
+     * @brief Memory used by the quantized weights, scales and biases.
+     * @return Size in bytes.
+     */
+    size_t weightBytes() const;
+};
+
+#endif // QUANTIZED_NET_HPP
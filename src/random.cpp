@@ -0,0 +1,142 @@
+/**
+ * @file random.cpp
+ * @brief Implementation of the fast random number generator used for dropout.
+ */
+
+#include "random.hpp"
+#include <algorithm>
+
+#if defined(__AVX512F__)
+#include <immintrin.h>
+
+// The unmasked shift and rotate intrinsics trigger false -Wmaybe-uninitialized
+// warnings with GCC 12, the fully masked forms compile to the same instructions
+static inline __m512i shiftLeft(__m512i x, unsigned k) { return _mm512_mask_slli_epi64(x, 0xff, x, k); }
+static inline __m512i shiftRight(__m512i x, unsigned k) { return _mm512_mask_srli_epi64(x, 0xff, x, k); }
+#define ROTATE_LEFT(x, k) _mm512_mask_rol_epi64((x), 0xff, (x), (k))
+#endif
+
+/**
+ * @brief splitmix64, used to expand seeds into generator states.
+ */
+static uint64_t splitmix64(uint64_t &state)
+{
+    uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static inline uint64_t rotl(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+void RandomGenerator::seed(uint64_t seed)
+{
+    uint64_t state = seed;
+    for (unsigned w = 0; w < 4; ++w)
+    {
+        for (unsigned lane = 0; lane < lanes; ++lane)
+        {
+            m_state[w][lane] = splitmix64(state);
+        }
+    }
+    m_position = 2 * lanes;
+}
+
+void RandomGenerator::step(uint64_t *outputs)
+{
+    uint64_t *s0 = m_state[0], *s1 = m_state[1], *s2 = m_state[2], *s3 = m_state[3];
+
+    for (unsigned lane = 0; lane < lanes; ++lane)
+    {
+        outputs[lane] = rotl(s1[lane] * 5, 7) * 9;
+
+        const uint64_t t = s1[lane] << 17;
+        s2[lane] ^= s0[lane];
+        s3[lane] ^= s1[lane];
+        s1[lane] ^= s2[lane];
+        s0[lane] ^= s3[lane];
+        s2[lane] ^= t;
+        s3[lane] = rotl(s3[lane], 45);
+    }
+}
+
+uint32_t RandomGenerator::nextUint32()
+{
+    if (m_position == 2 * lanes)
+    {
+        step(m_buffer);
+        m_position = 0;
+    }
+    const uint64_t word = m_buffer[m_position / 2];
+    return static_cast<uint32_t>(m_position++ % 2 ? word >> 32 : word);
+}
+
+void RandomGenerator::dropoutMask(double probability, double *mask, unsigned n)
+{
+    // Compare 32-bit uniform values with the probability scaled to 2^32
+    const uint64_t threshold = static_cast<uint64_t>(probability * 4294967296.0);
+    const double keepScale = 1.0 / (1.0 - probability);
+    unsigned k = 0;
+
+#if defined(__AVX512F__)
+    // All eight generators live in four registers, one step gives sixteen mask entries
+    __m512i s0 = _mm512_load_si512(m_state[0]), s1 = _mm512_load_si512(m_state[1]);
+    __m512i s2 = _mm512_load_si512(m_state[2]), s3 = _mm512_load_si512(m_state[3]);
+    const __m512i lowBits = _mm512_set1_epi64(0xffffffffLL);
+    const __m512i thresholdVec = _mm512_set1_epi64(static_cast<long long>(threshold));
+    const __m512d keepVec = _mm512_set1_pd(keepScale);
+
+    for (; k + 2 * lanes <= n; k += 2 * lanes)
+    {
+        __m512i x = _mm512_add_epi64(s1, shiftLeft(s1, 2)); // s1 * 5
+        x = ROTATE_LEFT(x, 7);
+        const __m512i words = _mm512_add_epi64(x, shiftLeft(x, 3)); // * 9
+
+        const __m512i t = shiftLeft(s1, 17);
+        s2 = _mm512_xor_si512(s2, s0);
+        s3 = _mm512_xor_si512(s3, s1);
+        s1 = _mm512_xor_si512(s1, s2);
+        s0 = _mm512_xor_si512(s0, s3);
+        s2 = _mm512_xor_si512(s2, t);
+        s3 = ROTATE_LEFT(s3, 45);
+
+        const __mmask8 dropLow = _mm512_cmplt_epu64_mask(_mm512_and_si512(words, lowBits), thresholdVec);
+        const __mmask8 dropHigh = _mm512_cmplt_epu64_mask(shiftRight(words, 32), thresholdVec);
+        _mm512_storeu_pd(mask + k, _mm512_maskz_mov_pd(static_cast<__mmask8>(~dropLow), keepVec));
+        _mm512_storeu_pd(mask + k + lanes, _mm512_maskz_mov_pd(static_cast<__mmask8>(~dropHigh), keepVec));
+    }
+
+    _mm512_store_si512(m_state[0], s0);
+    _mm512_store_si512(m_state[1], s1);
+    _mm512_store_si512(m_state[2], s2);
+    _mm512_store_si512(m_state[3], s3);
+#endif
+
+    alignas(64) uint64_t words[lanes];
+    for (; k < n; k += 2 * lanes)
+    {
+        step(words);
+        const unsigned count = min(n - k, 2 * lanes);
+        for (unsigned i = 0; i < count; ++i)
+        {
+            const uint64_t value = i < lanes ? words[i] & 0xffffffffULL : words[i - lanes] >> 32;
+            mask[k + i] = value < threshold ? 0.0 : keepScale;
+        }
+    }
+}
+
+RandomGenerator &threadGenerator()
+{
+    static thread_local RandomGenerator generator;
+    return generator;
+}
+
+void seedThreadGenerator(uint64_t seed, unsigned stream)
+{
+    // Streams get unrelated splitmix64 starting points
+    uint64_t state = seed ^ (0x632be59bd9b4e019ULL * (stream + 1));
+    threadGenerator().seed(splitmix64(state));
+}
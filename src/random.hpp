@@ -0,0 +1,101 @@
+/**
+ * @file random.hpp
+ * @brief Declaration of the fast random number generator used for dropout.
+ */
+#ifndef RANDOM_HPP
+#define RANDOM_HPP
+
+#include <cstdint>
+
+using namespace std;
+
+/**
+ * @class RandomGenerator
+ * @brief Eight interleaved xoshiro256** generators.
+ *
+ * The states of the eight generators are stored lane by lane, so one step of all of
+ * them compiles to a handful of vector instructions and yields sixteen 32-bit uniform
+ * numbers. Unlike rand(), a generator has no hidden global state: every thread uses its
+ * own instance returned by threadGenerator().
+ */
+class RandomGenerator
+{
+public:
+    /**
+     * @brief Number of interleaved generators.
+     */
+    static const unsigned lanes = 8;
+
+private:
+    /**
+     * @brief State words of the generators, `m_state[w][lane]`.
+     */
+    alignas(64) uint64_t m_state[4][lanes];
+
+    /**
+     * @brief Output of the last step, consumed by nextUint32().
+     */
+    alignas(64) uint64_t m_buffer[lanes];
+
+    /**
+     * @brief Number of 32-bit values of `m_buffer` already consumed.
+     */
+    unsigned m_position;
+
+    /**
+     * @brief Advance all generators by one step.
+     * @param outputs Output array for one 64-bit value per generator.
+     */
+    void step(uint64_t *outputs);
+
+public:
+    /**
+     * @brief Constructor for the RandomGenerator class.
+     * @param seed Seed of the generator.
+     */
+    RandomGenerator(uint64_t seed = 0) { this->seed(seed); }
+
+    /**
+     * @brief Reseed the generator.
+     *
+     * The state words are expanded from the seed by splitmix64, as recommended by the
+     * authors of xoshiro.
+     *
+     * @param seed Seed of the generator.
+     */
+    void seed(uint64_t seed);
+
+    /**
+     * @brief Get a uniformly distributed 32-bit value.
+     */
+    uint32_t nextUint32();
+
+    /**
+     * @brief Generate an inverted dropout mask.
+     *
+     * Each entry is 0 with the given probability and `1 / (1 - probability)` otherwise.
+     *
+     * @param probability Dropout probability.
+     * @param mask Output array for the mask.
+     * @param n Number of entries.
+     */
+    void dropoutMask(double probability, double *mask, unsigned n);
+};
+
+/**
+ * @brief Get the generator of the calling thread.
+ */
+RandomGenerator &threadGenerator();
+
+/**
+ * @brief Seed the generator of the calling thread.
+ *
+ * Threads working on the same run should pass the run seed and their own stream index,
+ * so their sequences are independent but reproducible.
+ *
+ * @param seed Seed of the run.
+ * @param stream Index of the thread within the run.
+ */
+void seedThreadGenerator(uint64_t seed, unsigned stream = 0);
+
+#endif // RANDOM_HPP
@@ -0,0 +1,188 @@
+/**
+ * @file reference_net.cpp
+ * @brief Implementation of the ReferenceNet class, the original per-neuron network.
+ */
+
+#include "reference_net.hpp"
+#include <cassert>
+#include <limits>
+#include <string>
+
+ReferenceNet::ReferenceNet(const vector<unsigned> &topology, unsigned seed) :
+    m_topology(topology),
+    m_error(0.0),
+    m_outputPotentials(topology.back()),
+    m_outputProbabilities(topology.back()),
+    m_outputGradients(topology.back()),
+    m_logSumExp(0.0)
+{
+    unsigned numLayers = topology.size();
+
+    std::mt19937 generator(seed); // To generate seeds individual to neurons
+
+    for (unsigned layerNum = 0; layerNum < numLayers; ++layerNum) {
+        m_layers.push_back(NeuronLayer());
+
+        // if last layer no outputs are set
+        unsigned numOutputs = layerNum == topology.size() - 1 ? 0 : topology[layerNum + 1];
+
+        // creating neurons according to given topology (one additional for bias)
+        for (unsigned neuronNum = 0; neuronNum <= topology[layerNum]; ++neuronNum) {
+            m_layers.back().push_back(Neuron(topology[layerNum], numOutputs, neuronNum, generator()));
+        }
+        // bias value
+        m_layers.back().back().setOutputVal(1.0);
+    }
+}
+
+void ReferenceNet::getResults(vector<double> &resultVals) const 
+{
+    resultVals.assign(m_outputProbabilities.begin(), m_outputProbabilities.end());
+}
+
+double ReferenceNet::getLoss(const vector<double> &targetVals)
+{
+    return crossEntropy(m_outputPotentials.data(), m_outputProbabilities.data(), m_logSumExp,
+                        targetVals.data(), nullptr, m_outputPotentials.size());
+}
+
+void ReferenceNet::backProp(const vector<double> &targetVals)
+{
+    NeuronLayer &outputLayer = m_layers.back();
+
+    // Categorical cross entropy loss and the gradients for output neurons
+    m_error = crossEntropy(m_outputPotentials.data(), m_outputProbabilities.data(), m_logSumExp,
+                           targetVals.data(), m_outputGradients.data(), m_outputGradients.size());
+
+    for (unsigned i = 0; i < outputLayer.size() - 1; ++i) // -1 to skip the bias
+    {
+        outputLayer[i].setGradient(m_outputGradients[i]);
+    }
+
+    //gradients on hidden layers
+    for (unsigned layerNum = m_layers.size() - 2; layerNum > 0; --layerNum)
+    {
+        NeuronLayer &hiddenLayer = m_layers[layerNum];
+        NeuronLayer &nextLayer = m_layers[layerNum + 1];
+
+        for (unsigned i = 0; i < hiddenLayer.size() - 1; ++i)
+        {
+            hiddenLayer[i].calcHiddenGradients(nextLayer);
+        }
+    }
+
+    // Gradients with respect to the weights
+    for (unsigned layerNum = 0; layerNum < m_layers.size() - 1; ++layerNum)
+    {
+        NeuronLayer &layer = m_layers[layerNum];
+        NeuronLayer &hiddenLayer = m_layers[layerNum + 1];
+
+        for (unsigned i = 0; i < layer.size() - 1; ++i)
+        {
+            layer[i].calcWeightGradients(hiddenLayer);
+        }
+    }
+}
+
+void ReferenceNet::updateWeights()
+{
+    for (unsigned layerNum = 0; layerNum < m_layers.size() - 1; ++layerNum)
+    {
+        NeuronLayer &actLayer = m_layers[layerNum];
+
+        for (unsigned i = 0; i < actLayer.size(); ++i)
+        {
+            actLayer[i].updateWeights();
+        }
+    }
+}
+
+void ReferenceNet::feedForward(const vector<double> &inputVals)
+{
+    //the number of input values is the same as the number of input neurons
+    // -1 because of bias
+    assert(inputVals.size() == m_layers[0].size() - 1);
+
+    // Set values of input neurons
+    for (unsigned i = 0; i < inputVals.size(); ++i)
+    {
+        m_layers[0][i].setOutputVal(inputVals[i]);
+    }
+
+    // Calculate output values of hidden neurons
+    for (unsigned layerNum = 1; layerNum < m_layers.size() - 1; ++layerNum)
+    {
+        NeuronLayer &prevLayer = m_layers[layerNum -1];
+        for (unsigned i = 0; i < m_layers[layerNum].size() - 1; ++i)
+        {
+            m_layers[layerNum][i].calcPotential(prevLayer);
+            m_layers[layerNum][i].calcOutput();
+        }
+    }
+
+    // Calculate the network outputs - use softmax
+    NeuronLayer &outLayer = m_layers[m_layers.size() - 1];
+    NeuronLayer &prevLayer = m_layers[m_layers.size() - 2];
+    for (unsigned i = 0; i < outLayer.size() - 1; ++i)
+    {
+        outLayer[i].calcPotential(prevLayer);
+        m_outputPotentials[i] = outLayer[i].getPotential();
+    }
+
+    m_logSumExp = softmax(m_outputPotentials.data(), m_outputProbabilities.data(), m_outputProbabilities.size());
+
+    for (unsigned i = 0; i < outLayer.size() - 1; ++i)
+    {
+        outLayer[i].setOutputVal(m_outputProbabilities[i]);
+    }
+}
+
+void ReferenceNet::calcAvgGradient(unsigned int batchSize)
+{
+    for (unsigned layerNum = 0; layerNum < m_layers.size() - 1; ++layerNum)
+    {
+        NeuronLayer &actLayer = m_layers[layerNum];
+
+        for (unsigned i = 0; i < actLayer.size(); ++i)
+        {
+            actLayer[i].calcAvgGradient(batchSize);
+        }
+    }
+}
+
+void ReferenceNet::resetGradientSum(){
+    for (unsigned layerNum = 0; layerNum < m_layers.size() - 1; ++layerNum)
+    {
+        NeuronLayer &actLayer = m_layers[layerNum];
+
+        for (unsigned i = 0; i < actLayer.size(); ++i)
+        {
+            actLayer[i].resetGradientSum();
+        }
+    }
+}
+
+int ReferenceNet::compare_result(const vector<double> &output, const vector<double> &label)
+{
+    auto maxElementIter = max_element(output.begin(), output.end());
+    unsigned index_o = distance(output.begin(), maxElementIter);
+
+    auto maxElementIter_l = max_element(label.begin(), label.end());
+    unsigned index_l = distance(label.begin(), maxElementIter_l);
+
+    return (index_o == index_l);
+}
+
+void ReferenceNet::setDropout(unsigned int layer_num, double probability)
+{
+    NeuronLayer &actLayer = m_layers[layer_num];
+    for (unsigned i = 0; i < actLayer.size(); ++i)
+    {
+        actLayer[i].setDropout(probability);
+    }
+}
+
+double ReferenceNet::getWeight(unsigned layerNum, unsigned from, unsigned to) const
+{
+    return m_layers[layerNum][from].getOutputWeight(to);
+}
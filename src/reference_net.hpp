@@ -0,0 +1,181 @@
+/**
+ * @file reference_net.hpp
+ * @brief Declaration of the ReferenceNet class and its methods.
+ */
+#ifndef REFERENCE_NET_HPP
+#define REFERENCE_NET_HPP
+
+#include <vector>
+#include <cstdlib>
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include "neuron.hpp"
+#include "kernels.hpp"
+
+using namespace std;
+
+/**
+ * @class ReferenceNet
+ * @brief The original per-neuron implementation of the network.
+ *
+ * Kept as a straightforward reference the optimized Net is validated against; it starts
+ * from the same weights as Net for the same seed.
+ */
+class ReferenceNet
+{
+private:
+    /**
+     * @brief Vector holding the layers of neurons in the neural network.
+     */
+    vector<NeuronLayer> m_layers; //m_layers[layerNum][neuronNum]
+
+    /**
+     * @brief Number of neurons in each layer (without the bias neurons).
+     */
+    vector<unsigned> m_topology;
+
+    /**
+     * @brief Current error value of the neural network (cathegorical cross-entropy).
+     */
+    double m_error;
+
+    /**
+     * @brief Inner potentials of the output neurons from the last feedforward pass.
+     */
+    vector<double> m_outputPotentials;
+
+    /**
+     * @brief Softmax probabilities of the output neurons from the last feedforward pass.
+     */
+    vector<double> m_outputProbabilities;
+
+    /**
+     * @brief Gradients of the loss with respect to the output potentials.
+     */
+    vector<double> m_outputGradients;
+
+    /**
+     * @brief Log-sum-exp of the output potentials from the last feedforward pass.
+     */
+    double m_logSumExp;
+
+public:
+    /**
+     * @brief Constructor for the ReferenceNet class.
+     * 
+     * Initializes the neural network with the given topology and seed for random number generation.
+     * 
+     * @param topology Vector representing the number of neurons in each layer.
+     * @param seed Seed for random number generation.
+     */
+    ReferenceNet(const vector<unsigned> &topology, unsigned seed);
+
+    /**
+     * @brief Set the learning rate of all neurons.
+     * @param learningRate Learning rate value.
+     */
+    static void setLearningRate(double learningRate) { Neuron::setLearningRate(learningRate); }
+
+    /**
+     * @brief Get the results (output values) of the neural network.
+     * @param resultVals Vector to store the output values.
+     */
+    void getResults(vector<double> &resultVals) const;
+
+    /**
+     * @brief Calculate the loss (categorical cross-entropy) between the network output and target values.
+     * @param targetVals Target values for the output layer.
+     * @return Loss value.
+     */
+    double getLoss(const vector<double> &targetVals);
+
+    /**
+     * @brief Backpropagate the error and update the network weights.
+     * 
+     * Computes the gradients and updates the weights of the network using backpropagation.
+     * The loss of the sample is computed together with the output gradients and can be
+     * read by getError().
+     * 
+     * @param targetVals Target values for the output layer.
+     */
+    void backProp(const vector<double> &targetVals);
+
+    /**
+     * @brief Get the loss computed by the last backProp() call.
+     * @return Loss value (categorical cross-entropy).
+     */
+    double getError() const { return m_error; }
+
+
+    /**
+     * @brief Update the weights of the neural network based on calculated gradients.
+     * 
+     * Iterates through each layer of the network and updates the weights of each neuron
+     * based on the computed gradients during backpropagation.
+     */
+    void updateWeights();
+
+    /**
+     * @brief Perform a feedforward pass to compute the network output.
+     * 
+     * Sets the input values, calculates the potential and output values of each neuron
+     * in hidden layers, and computes the softmax activation for the output layer.
+     * 
+     * @param inputVals Vector containing the input values to the network.
+     */
+    void feedForward(const vector<double> &inputVals);
+
+    /**
+     * @brief Calculate the average gradient of each weight in the network.
+     * 
+     * Calculates the average gradient for each weight in the network over a mini-batch.
+     * 
+     * @param batchSize Number of training examples in the mini-batch.
+     */
+    void calcAvgGradient(unsigned int batchSize);
+
+    /**
+     * @brief Reset the gradient sum for each weight in the network.
+     * 
+     * Resets the accumulated gradient sum for each weight in the network.
+     */
+    void resetGradientSum();
+
+    /**
+     * @brief Compare the predicted output with the ground truth label.
+     * 
+     * Compares the predicted output with the ground truth label and returns whether
+     * the prediction is correct.
+     * 
+     * @param output Predicted output vector.
+     * @param label Ground truth label vector.
+     * @return 1 if the prediction is correct, 0 otherwise.
+     */
+    int compare_result(const vector<double> &output, const vector<double> &label);
+
+    /**
+     * @brief Set the dropout probability for neurons in a specific layer.  
+     * @param layer_num Index of the layer for which dropout probability is set.
+     * @param probability Dropout probability.
+     */
+    void setDropout(unsigned int layer_num, double probability);
+
+    /**
+     * @brief Get the network topology the net was constructed with.
+     * @return Number of neurons in each layer (without the bias neurons).
+     */
+    const vector<unsigned> &getTopology() const { return m_topology; }
+
+    /**
+     * @brief Get the weight of a connection between two neighbouring layers.
+     * @param layerNum Index of the layer the connection starts in.
+     * @param from Index of the neuron in layer `layerNum` (the layer size addresses the bias neuron).
+     * @param to Index of the neuron in layer `layerNum + 1`.
+     * @return The weight of the connection.
+     */
+    double getWeight(unsigned layerNum, unsigned from, unsigned to) const;
+
+};
+
+#endif // REFERENCE_NET_HPP
@@ -0,0 +1,101 @@
+/**
+ * @file schedule.cpp
+ * @brief Implementation of the learning rate schedules and of early stopping.
+ */
+
+#include "schedule.hpp"
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+
+ScheduleKind parseSchedule(const string &name)
+{
+    if (name == "constant") return ScheduleKind::Constant;
+    if (name == "step") return ScheduleKind::Step;
+    if (name == "cosine") return ScheduleKind::Cosine;
+    if (name == "plateau") return ScheduleKind::Plateau;
+    throw invalid_argument("Unknown learning rate schedule: " + name);
+}
+
+// ---------------------------------------------------------------------------
+// LearningRateSchedule
+// ---------------------------------------------------------------------------
+
+LearningRateSchedule::LearningRateSchedule(const ScheduleOptions &options, double initialRate, unsigned epochs) :
+    m_options(options),
+    m_initialRate(initialRate),
+    m_epochs(epochs),
+    m_plateauScale(1.0),
+    m_bestAccuracy(-1.0),
+    m_epochsSinceBest(0)
+{
+}
+
+double LearningRateSchedule::rate(unsigned epoch) const
+{
+    const unsigned warmup = m_options.warmupEpochs;
+    if (epoch < warmup)
+    {
+        return m_initialRate * (epoch + 1) / (warmup + 1);
+    }
+
+    const unsigned step = epoch - warmup;
+    switch (m_options.kind)
+    {
+        case ScheduleKind::Step:
+            return m_initialRate * pow(m_options.decayFactor, step / max(m_options.decayEpochs, 1u));
+        case ScheduleKind::Cosine:
+        {
+            const unsigned length = max(m_epochs, warmup + 1) - warmup;
+            return m_initialRate * 0.5 * (1.0 + cos(M_PI * step / length));
+        }
+        case ScheduleKind::Plateau:
+            return m_initialRate * m_plateauScale;
+        default:
+            return m_initialRate;
+    }
+}
+
+void LearningRateSchedule::report(double accuracy)
+{
+    if (m_options.kind != ScheduleKind::Plateau)
+    {
+        return;
+    }
+    if (accuracy > m_bestAccuracy)
+    {
+        m_bestAccuracy = accuracy;
+        m_epochsSinceBest = 0;
+    }
+    else if (++m_epochsSinceBest >= max(m_options.decayEpochs, 1u))
+    {
+        // Give the lower rate as many epochs to improve
+        m_plateauScale *= m_options.decayFactor;
+        m_epochsSinceBest = 0;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// EarlyStopping
+// ---------------------------------------------------------------------------
+
+EarlyStopping::EarlyStopping(unsigned patience) :
+    m_patience(patience),
+    m_bestAccuracy(-1.0),
+    m_bestEpoch(0),
+    m_epochsSinceBest(0)
+{
+}
+
+bool EarlyStopping::report(unsigned epoch, double accuracy)
+{
+    if (accuracy > m_bestAccuracy)
+    {
+        m_bestAccuracy = accuracy;
+        m_bestEpoch = epoch;
+        m_epochsSinceBest = 0;
+        return true;
+    }
+    ++m_epochsSinceBest;
+    return false;
+}
@@ -0,0 +1,212 @@
+/**
+ * @file schedule.hpp
+ * @brief Declaration of the learning rate schedules and of early stopping.
+ */
+#ifndef SCHEDULE_HPP
+#define SCHEDULE_HPP
+
+#include <string>
+
+using namespace std;
+
+/**
+ * @enum ScheduleKind
+ * @brief How the learning rate changes from epoch to epoch (after the warmup).
+ */
+enum class ScheduleKind
+{
+    /**
+     * @brief The learning rate stays at its initial value.
+     */
+    Constant,
+
+    /**
+     * @brief The learning rate is multiplied by the decay factor every few epochs.
+     */
+    Step,
+
+    /**
+     * @brief The learning rate follows half a cosine from its initial value down to zero over the remaining epochs.
+     */
+    Cosine,
+
+    /**
+     * @brief The learning rate is multiplied by the decay factor when the validation accuracy stops improving.
+     */
+    Plateau
+};
+
+/**
+ * @brief Parse the name of a schedule.
+ * @param name One of "constant", "step", "cosine", "plateau".
+ * @return The schedule.
+ * @throws std::invalid_argument if the name is unknown.
+ */
+ScheduleKind parseSchedule(const string &name);
+
+/**
+ * @struct ScheduleOptions
+ * @brief Settings of a learning rate schedule given on the command line.
+ */
+struct ScheduleOptions
+{
+    /**
+     * @brief The schedule after the warmup.
+     */
+    ScheduleKind kind = ScheduleKind::Constant;
+
+    /**
+     * @brief Number of epochs over which the learning rate rises linearly to its initial value.
+     */
+    unsigned warmupEpochs = 0;
+
+    /**
+     * @brief Epochs between two decays (Step), or without improvement before a decay (Plateau).
+     */
+    unsigned decayEpochs = 2;
+
+    /**
+     * @brief Factor the learning rate is multiplied by at every decay.
+     */
+    double decayFactor = 0.5;
+};
+
+/**
+ * @class LearningRateSchedule
+ * @brief Learning rate of every epoch of a training run.
+ *
+ * During the warmup epoch `e` uses `(e + 1) / (warmup + 1)` of the initial rate. The
+ * schedule itself starts counting epochs after the warmup. The Plateau schedule needs
+ * the validation accuracy of every epoch (see report()).
+ */
+class LearningRateSchedule
+{
+private:
+    /**
+     * @brief The settings.
+     */
+    ScheduleOptions m_options;
+
+    /**
+     * @brief Learning rate given on the command line.
+     */
+    double m_initialRate;
+
+    /**
+     * @brief Total number of epochs of the run.
+     */
+    unsigned m_epochs;
+
+    /**
+     * @brief Product of the decays applied by the Plateau schedule so far.
+     */
+    double m_plateauScale;
+
+    /**
+     * @brief Best validation accuracy reported so far.
+     */
+    double m_bestAccuracy;
+
+    /**
+     * @brief Number of epochs reported since the best accuracy (or the last decay).
+     */
+    unsigned m_epochsSinceBest;
+
+public:
+    /**
+     * @brief Constructor for the LearningRateSchedule class.
+     *
+     * @param options The settings.
+     * @param initialRate Learning rate given on the command line.
+     * @param epochs Total number of epochs of the run.
+     */
+    LearningRateSchedule(const ScheduleOptions &options, double initialRate, unsigned epochs);
+
+    /**
+     * @brief Whether the learning rate ever differs from the initial one.
+     */
+    bool active() const { return m_options.kind != ScheduleKind::Constant || m_options.warmupEpochs > 0; }
+
+    /**
+     * @brief Whether the schedule needs the validation accuracy of every epoch.
+     */
+    bool needsAccuracy() const { return m_options.kind == ScheduleKind::Plateau; }
+
+    /**
+     * @brief Get the learning rate of an epoch.
+     * @param epoch Index of the epoch, from 0.
+     * @return The learning rate.
+     */
+    double rate(unsigned epoch) const;
+
+    /**
+     * @brief Report the validation accuracy after an epoch (Plateau only, ignored by the others).
+     * @param accuracy The validation accuracy.
+     */
+    void report(double accuracy);
+};
+
+/**
+ * @class EarlyStopping
+ * @brief Stops training when the validation accuracy has not improved for a number of epochs.
+ */
+class EarlyStopping
+{
+private:
+    /**
+     * @brief Number of epochs without improvement before stopping, 0 to never stop.
+     */
+    unsigned m_patience;
+
+    /**
+     * @brief Best validation accuracy so far.
+     */
+    double m_bestAccuracy;
+
+    /**
+     * @brief Index of the epoch with the best validation accuracy.
+     */
+    unsigned m_bestEpoch;
+
+    /**
+     * @brief Number of epochs since the best one.
+     */
+    unsigned m_epochsSinceBest;
+
+public:
+    /**
+     * @brief Constructor for the EarlyStopping class.
+     * @param patience Number of epochs without improvement before stopping, 0 to never stop.
+     */
+    explicit EarlyStopping(unsigned patience);
+
+    /**
+     * @brief Whether early stopping is enabled.
+     */
+    bool enabled() const { return m_patience > 0; }
+
+    /**
+     * @brief Report the validation accuracy after an epoch.
+     * @param epoch Index of the epoch.
+     * @param accuracy The validation accuracy.
+     * @return Whether it is the best so far (and the weights should be kept).
+     */
+    bool report(unsigned epoch, double accuracy);
+
+    /**
+     * @brief Whether the patience has run out.
+     */
+    bool shouldStop() const { return enabled() && m_epochsSinceBest >= m_patience; }
+
+    /**
+     * @brief Get the index of the epoch with the best validation accuracy.
+     */
+    unsigned bestEpoch() const { return m_bestEpoch; }
+
+    /**
+     * @brief Get the best validation accuracy.
+     */
+    double bestAccuracy() const { return m_bestAccuracy; }
+};
+
+#endif // SCHEDULE_HPP
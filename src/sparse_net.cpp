@@ -0,0 +1,331 @@
+/**
+ * @file sparse_net.cpp
+ * @brief Implementation of the SparseNet CSR inference engine.
+ */
+
+#include "sparse_net.hpp"
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+#if defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+/**
+ * @brief First bytes of a model file.
+ */
+static const char sparseMagic[8] = {'S', 'P', 'A', 'R', 'S', 'E', 'N', '1'};
+
+/**
+ * @brief Whether the model file stores the column indices of a layer in 16 bits.
+ */
+static bool narrowColumns(unsigned numInputs)
+{
+    return numInputs <= 65536;
+}
+
+SparseNet::SparseNet(const Net &net) :
+    m_rows(0)
+{
+    if (net.getActivation() != Activation::ReLU)
+    {
+        throw invalid_argument("Only networks with ReLU hidden layers can be stored as sparse");
+    }
+    if (net.getMembers() > 1)
+    {
+        throw invalid_argument("Ensembles cannot be stored as sparse");
+    }
+
+    const vector<unsigned> &topology = net.getTopology();
+    for (unsigned layerNum = 0; layerNum < topology.size() - 1; ++layerNum)
+    {
+        SparseLayer layer;
+        layer.numInputs = topology[layerNum];
+        layer.numOutputs = topology[layerNum + 1];
+        layer.rowStarts.push_back(0);
+        for (unsigned j = 0; j < layer.numOutputs; ++j)
+        {
+            for (unsigned i = 0; i < layer.numInputs; ++i)
+            {
+                const double weight = net.getWeight(layerNum, i, j);
+                if (weight != 0.0)
+                {
+                    layer.columns.push_back(i);
+                    layer.values.push_back(weight);
+                }
+            }
+            layer.rowStarts.push_back(layer.columns.size());
+            layer.biases.push_back(net.getWeight(layerNum, layer.numInputs, j));
+        }
+        m_layers.push_back(layer);
+    }
+}
+
+SparseNet::SparseNet(const string &path) :
+    m_rows(0)
+{
+    ifstream file(path, ios::binary);
+    if (!file.is_open())
+    {
+        throw runtime_error("Unable to open file: " + path);
+    }
+
+    auto read = [&](void *data, size_t bytes) {
+        if (!file.read(static_cast<char *>(data), bytes))
+        {
+            throw runtime_error("Truncated model file: " + path);
+        }
+    };
+
+    char magic[sizeof(sparseMagic)];
+    read(magic, sizeof(magic));
+    if (memcmp(magic, sparseMagic, sizeof(magic)) != 0)
+    {
+        throw runtime_error("Not a sparse model file: " + path);
+    }
+    uint32_t layers;
+    read(&layers, sizeof(layers));
+    for (uint32_t layerNum = 0; layerNum < layers; ++layerNum)
+    {
+        SparseLayer layer;
+        uint32_t header[3]; // inputs, outputs, non-zero weights
+        read(header, sizeof(header));
+        // Checked before anything is allocated from them
+        if (header[0] == 0 || header[1] == 0 || header[1] == UINT32_MAX ||
+            uint64_t(header[2]) > uint64_t(header[0]) * header[1] ||
+            (layerNum > 0 && header[0] != m_layers.back().numOutputs))
+        {
+            throw runtime_error("Inconsistent model file: " + path);
+        }
+        layer.numInputs = header[0];
+        layer.numOutputs = header[1];
+        layer.rowStarts.resize(layer.numOutputs + 1);
+        read(layer.rowStarts.data(), layer.rowStarts.size() * sizeof(uint32_t));
+        layer.columns.resize(header[2]);
+        if (narrowColumns(layer.numInputs))
+        {
+            vector<uint16_t> columns(header[2]);
+            read(columns.data(), columns.size() * sizeof(uint16_t));
+            copy(columns.begin(), columns.end(), layer.columns.begin());
+        }
+        else
+        {
+            read(layer.columns.data(), layer.columns.size() * sizeof(uint32_t));
+        }
+        layer.values.resize(header[2]);
+        read(layer.values.data(), layer.values.size() * sizeof(float));
+        layer.biases.resize(layer.numOutputs);
+        read(layer.biases.data(), layer.biases.size() * sizeof(float));
+
+        // The kernels index with these without bounds checks
+        if (layer.rowStarts.front() != 0 || layer.rowStarts.back() != header[2] ||
+            !is_sorted(layer.rowStarts.begin(), layer.rowStarts.end()) ||
+            any_of(layer.columns.begin(), layer.columns.end(),
+                   [&layer](uint32_t column) { return column >= layer.numInputs; }))
+        {
+            throw runtime_error("Inconsistent model file: " + path);
+        }
+        m_layers.push_back(layer);
+    }
+    if (m_layers.empty())
+    {
+        throw runtime_error("Empty model file: " + path);
+    }
+}
+
+void SparseNet::save(const string &path) const
+{
+    ofstream file(path, ios::binary);
+    if (!file.is_open())
+    {
+        throw runtime_error("Unable to open file: " + path);
+    }
+
+    auto write = [&](const void *data, size_t bytes) {
+        file.write(static_cast<const char *>(data), bytes);
+    };
+
+    write(sparseMagic, sizeof(sparseMagic));
+    const uint32_t layers = m_layers.size();
+    write(&layers, sizeof(layers));
+    for (const SparseLayer &layer : m_layers)
+    {
+        const uint32_t header[3] = {layer.numInputs, layer.numOutputs, static_cast<uint32_t>(layer.values.size())};
+        write(header, sizeof(header));
+        write(layer.rowStarts.data(), layer.rowStarts.size() * sizeof(uint32_t));
+        if (narrowColumns(layer.numInputs))
+        {
+            vector<uint16_t> columns(layer.columns.begin(), layer.columns.end());
+            write(columns.data(), columns.size() * sizeof(uint16_t));
+        }
+        else
+        {
+            write(layer.columns.data(), layer.columns.size() * sizeof(uint32_t));
+        }
+        write(layer.values.data(), layer.values.size() * sizeof(float));
+        write(layer.biases.data(), layer.biases.size() * sizeof(float));
+    }
+    if (!file)
+    {
+        throw runtime_error("Unable to write file: " + path);
+    }
+}
+
+float SparseNet::sparseDot(const float *values, const uint32_t *columns, unsigned n, const float *inputs)
+{
+    unsigned k = 0;
+    float sum = 0.0f;
+#if defined(__AVX512F__)
+    // Gather the inputs of 16 weights at a time, the tail with a mask
+    __m512 acc = _mm512_setzero_ps();
+    for (; k + 16 <= n; k += 16)
+    {
+        const __m512i index = _mm512_loadu_si512(columns + k);
+        const __m512 gathered = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), 0xFFFF, index, inputs, 4);
+        acc = _mm512_fmadd_ps(_mm512_loadu_ps(values + k), gathered, acc);
+    }
+    if (k < n)
+    {
+        const __mmask16 mask = (1u << (n - k)) - 1;
+        const __m512i index = _mm512_maskz_loadu_epi32(mask, columns + k);
+        const __m512 gathered = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), mask, index, inputs, 4);
+        acc = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, values + k), gathered, acc);
+        k = n;
+    }
+    alignas(64) float lanes[16];
+    _mm512_store_ps(lanes, acc);
+    for (unsigned i = 0; i < 16; ++i)
+    {
+        sum += lanes[i];
+    }
+#endif
+    for (; k < n; ++k)
+    {
+        sum += values[k] * inputs[columns[k]];
+    }
+    return sum;
+}
+
+void SparseNet::softmax(const float *potentials)
+{
+    const unsigned numOutputs = m_layers.back().numOutputs;
+    for (unsigned r = 0; r < m_rows; ++r)
+    {
+        float *probabilities = &m_probabilities[r * numOutputs];
+        float maxPotential = potentials[r];
+        for (unsigned j = 1; j < numOutputs; ++j)
+        {
+            maxPotential = max(maxPotential, potentials[j * m_rows + r]);
+        }
+        float expSum = 0.0f;
+        for (unsigned j = 0; j < numOutputs; ++j)
+        {
+            probabilities[j] = exp(potentials[j * m_rows + r] - maxPotential);
+            expSum += probabilities[j];
+        }
+        for (unsigned j = 0; j < numOutputs; ++j)
+        {
+            probabilities[j] /= expSum;
+        }
+    }
+}
+
+void SparseNet::feedForward(const vector<double> &inputVals)
+{
+    assert(inputVals.size() == m_layers[0].numInputs);
+    feedForward(inputVals.data(), 1);
+}
+
+void SparseNet::feedForward(const double *inputs, unsigned rows)
+{
+    unsigned maxWidth = 0;
+    for (const SparseLayer &layer : m_layers)
+    {
+        maxWidth = max(maxWidth, max(layer.numInputs, layer.numOutputs));
+    }
+    m_rows = rows;
+    m_inputs.resize(maxWidth * rows);
+    m_outputs.resize(maxWidth * rows);
+    m_probabilities.resize(m_layers.back().numOutputs * rows);
+
+    // Neuron-major: the values of neuron i of all rows are contiguous
+    const unsigned numInputs = m_layers.front().numInputs;
+    for (unsigned r = 0; r < rows; ++r)
+    {
+        for (unsigned i = 0; i < numInputs; ++i)
+        {
+            m_inputs[i * rows + r] = inputs[r * numInputs + i];
+        }
+    }
+
+    for (unsigned layerNum = 0; layerNum < m_layers.size(); ++layerNum)
+    {
+        const SparseLayer &layer = m_layers[layerNum];
+        const bool isOutput = layerNum == m_layers.size() - 1;
+
+        for (unsigned j = 0; j < layer.numOutputs; ++j)
+        {
+            const unsigned start = layer.rowStarts[j], end = layer.rowStarts[j + 1];
+            float *outputs = &m_outputs[j * rows];
+            if (rows == 1)
+            {
+                outputs[0] = sparseDot(&layer.values[start], &layer.columns[start], end - start, m_inputs.data()) +
+                             layer.biases[j];
+            }
+            else
+            {
+                fill(outputs, outputs + rows, layer.biases[j]);
+                for (unsigned k = start; k < end; ++k)
+                {
+                    const float weight = layer.values[k];
+                    const float *input = &m_inputs[layer.columns[k] * rows];
+                    for (unsigned r = 0; r < rows; ++r)
+                    {
+                        outputs[r] += weight * input[r];
+                    }
+                }
+            }
+            if (!isOutput)
+            {
+                for (unsigned r = 0; r < rows; ++r)
+                {
+                    outputs[r] = max(0.0f, outputs[r]);
+                }
+            }
+        }
+        swap(m_inputs, m_outputs);
+    }
+    softmax(m_inputs.data());
+}
+
+void SparseNet::getResults(vector<double> &resultVals, unsigned row) const
+{
+    const unsigned numOutputs = m_layers.back().numOutputs;
+    resultVals.assign(&m_probabilities[row * numOutputs], &m_probabilities[row * numOutputs] + numOutputs);
+}
+
+double SparseNet::density() const
+{
+    size_t stored = 0, total = 0;
+    for (const SparseLayer &layer : m_layers)
+    {
+        stored += layer.values.size();
+        total += size_t(layer.numInputs) * layer.numOutputs;
+    }
+    return total > 0 ? double(stored) / total : 0.0;
+}
+
+size_t SparseNet::fileBytes() const
+{
+    size_t bytes = sizeof(sparseMagic) + sizeof(uint32_t);
+    for (const SparseLayer &layer : m_layers)
+    {
+        bytes += 3 * sizeof(uint32_t) + layer.rowStarts.size() * sizeof(uint32_t) +
+                 layer.columns.size() * (narrowColumns(layer.numInputs) ? sizeof(uint16_t) : sizeof(uint32_t)) +
+                 layer.values.size() * sizeof(float) + layer.biases.size() * sizeof(float);
+    }
+    return bytes;
+}
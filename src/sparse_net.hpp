@@ -0,0 +1,163 @@
+/**
+ * @file sparse_net.hpp
+ * @brief Declaration of the SparseNet class, a CSR inference engine for a pruned Net.
+ */
+#ifndef SPARSE_NET_HPP
+#define SPARSE_NET_HPP
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include "net.hpp"
+
+using namespace std;
+
+/**
+ * @struct SparseLayer
+ * @brief Non-zero weights of the connections leading into one layer of the network, in CSR form.
+ *
+ * The weights of output neuron `j` are `values[rowStarts[j]]` up to `values[rowStarts[j + 1]]`,
+ * those of the inputs `columns[rowStarts[j]]` up to `columns[rowStarts[j + 1]]`.
+ */
+struct SparseLayer
+{
+    /**
+     * @brief Number of neurons of the previous layer.
+     */
+    unsigned numInputs;
+
+    /**
+     * @brief Number of neurons of the layer.
+     */
+    unsigned numOutputs;
+
+    /**
+     * @brief Offsets of the rows into columns and values, numOutputs + 1 of them.
+     */
+    vector<uint32_t> rowStarts;
+
+    /**
+     * @brief Input of every non-zero weight, ascending within a row.
+     */
+    vector<uint32_t> columns;
+
+    /**
+     * @brief The non-zero weights.
+     */
+    vector<float> values;
+
+    /**
+     * @brief Biases of all neurons of the layer.
+     */
+    vector<float> biases;
+};
+
+/**
+ * @class SparseNet
+ * @brief Inference engine for a pruned Net, evaluating only the non-zero weights.
+ *
+ * Weights and biases are stored as float. A single sample is fed forward with one sparse
+ * matrix-vector product per layer, which gathers the inputs of 16 weights at a time with
+ * AVX-512 when the compiler targets it. A batch is fed forward with its activations
+ * transposed (one row of all samples per neuron), so every non-zero weight is applied to
+ * all samples with contiguous vector operations.
+ *
+ * The model file stores the CSR arrays with 16-bit column indices when the layer has at
+ * most 65536 inputs, so its size grows with the number of non-zero weights only.
+ */
+class SparseNet
+{
+private:
+    /**
+     * @brief Layers, `m_layers[i]` computes the outputs of layer `i + 1` of the Net.
+     */
+    vector<SparseLayer> m_layers;
+
+    /**
+     * @brief Number of rows of the last feedforward pass.
+     */
+    unsigned m_rows;
+
+    /**
+     * @brief Activations of the layer being computed and of its input, neuron-major for a batch.
+     */
+    vector<float> m_inputs, m_outputs;
+
+    /**
+     * @brief Softmax probabilities of the last feedforward pass [rows][outputs].
+     */
+    vector<float> m_probabilities;
+
+    /**
+     * @brief Dot product of the non-zero weights of a row with the inputs they connect to.
+     * @param values Non-zero weights.
+     * @param columns Inputs of the weights.
+     * @param n Number of non-zero weights.
+     * @param inputs Dense input vector.
+     * @return The dot product.
+     */
+    static float sparseDot(const float *values, const uint32_t *columns, unsigned n, const float *inputs);
+
+    /**
+     * @brief Turn the output potentials of every row into softmax probabilities.
+     * @param potentials Potentials of the output layer, neuron-major [outputs][rows].
+     */
+    void softmax(const float *potentials);
+
+public:
+    /**
+     * @brief Store the non-zero weights of a trained (usually pruned) net.
+     * @param net Trained network.
+     * @throws std::invalid_argument if the hidden layers do not use ReLU or the network is an ensemble.
+     */
+    explicit SparseNet(const Net &net);
+
+    /**
+     * @brief Load a model written by save().
+     * @param path The file.
+     * @throws std::runtime_error if the file cannot be read, is no model, its layer sizes are
+     * zero or do not chain, or its weight counts, row offsets or column indices are out of range.
+     */
+    explicit SparseNet(const string &path);
+
+    /**
+     * @brief Write the model to a file.
+     * @param path The file.
+     * @throws std::runtime_error if the file cannot be written.
+     */
+    void save(const string &path) const;
+
+    /**
+     * @brief Perform a feedforward pass of one sample with sparse matrix-vector products.
+     * @param inputVals Vector containing the input values to the network.
+     */
+    void feedForward(const vector<double> &inputVals);
+
+    /**
+     * @brief Perform a feedforward pass of a batch.
+     * @param inputs Input values, one row of the input layer size per sample.
+     * @param rows Number of samples.
+     */
+    void feedForward(const double *inputs, unsigned rows);
+
+    /**
+     * @brief Get the softmax probabilities of a row of the last feedforward pass.
+     * @param resultVals Vector to store the output values.
+     * @param row The row.
+     */
+    void getResults(vector<double> &resultVals, unsigned row = 0) const;
+
+    /**
+     * @brief Fraction of the weights (not the biases) that are stored.
+     */
+    double density() const;
+
+    /**
+     * @brief Size of the model file written by save().
+     * @return Size in bytes.
+     */
+    size_t fileBytes() const;
+};
+
+#endif // SPARSE_NET_HPP
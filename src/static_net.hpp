@@ -0,0 +1,396 @@
+/**
+ * @file static_net.hpp
+ * @brief Declaration and implementation of the StaticNet class template, a network whose
+ * topology is fixed at compile time.
+ */
+#ifndef STATIC_NET_HPP
+#define STATIC_NET_HPP
+
+#include <array>
+#include <vector>
+#include <tuple>
+#include <utility>
+#include <random>
+#include <cmath>
+#include <algorithm>
+#include <cassert>
+#include "kernels.hpp"
+#include "fast_math.hpp"
+
+using namespace std;
+
+/**
+ * @struct StaticLayer
+ * @brief Fully connected layer with `In` inputs and `Out` outputs, all buffers statically sized.
+ *
+ * Weights are stored row-major per output neuron, `weights[j * In + i]` connects input `i`
+ * to output `j`. As in Net, the bias weights keep their initial values during training.
+ */
+template <unsigned In, unsigned Out>
+struct StaticLayer
+{
+    alignas(64) array<double, Out * In> weights;
+    alignas(64) array<double, Out * In> weightDeltas;
+    alignas(64) array<double, Out * In> weightGradients;
+    alignas(64) array<double, Out> biases;
+    alignas(64) array<double, Out> potentials;
+    alignas(64) array<double, Out> outputs;
+    alignas(64) array<double, Out> gradients;
+};
+
+/**
+ * @class StaticNet
+ * @brief Network with the topology given as template parameters, e.g. `StaticNet<784, 64, 32, 10>`.
+ *
+ * Provides the same training interface as Net (ReLU hidden layers, softmax output, RMSprop),
+ * but all loop bounds are compile-time constants, so the compiler can fully unroll and
+ * vectorize the kernels without remainder handling or bounds bookkeeping. Weights are
+ * initialized exactly like Net for the same seed.
+ */
+template <unsigned... Sizes>
+class StaticNet
+{
+public:
+    /**
+     * @brief Number of layers including the input layer.
+     */
+    static constexpr unsigned numLayers = sizeof...(Sizes);
+
+    /**
+     * @brief Number of neurons in each layer.
+     */
+    static constexpr unsigned sizes[numLayers] = {Sizes...};
+
+    static_assert(numLayers >= 2, "StaticNet needs at least an input and an output layer");
+
+private:
+    template <size_t... I>
+    static auto makeLayers(index_sequence<I...>) -> tuple<StaticLayer<sizes[I], sizes[I + 1]>...>;
+
+    /**
+     * @brief Tuple of the layers, `get<L>(m_layers)` computes layer `L + 1` of the topology.
+     */
+    decltype(makeLayers(make_index_sequence<numLayers - 1>{})) m_layers;
+
+    /**
+     * @brief Values of the input layer.
+     */
+    alignas(64) array<double, sizes[0]> m_inputs;
+
+    /**
+     * @brief Log-sum-exp of the output potentials from the last feedforward pass.
+     */
+    double m_logSumExp = 0.0;
+
+    /**
+     * @brief Loss computed by the last backProp() call.
+     */
+    double m_error = 0.0;
+
+    /**
+     * @brief Overall learning rate.
+     */
+    inline static double eta = 0.15;
+
+    /**
+     * @brief Decay factor for RMSprop optimization.
+     */
+    inline static double decay = 0.9;
+
+    /**
+     * @brief Small constant used to prevent division by zero.
+     */
+    inline static double epsilon = 1e-8;
+
+    /**
+     * @brief Get the outputs of the layer feeding layer `L` of `m_layers`.
+     */
+    template <unsigned L>
+    const double *layerInputs() const
+    {
+        if constexpr (L == 0)
+        {
+            return m_inputs.data();
+        }
+        else
+        {
+            return get<L - 1>(m_layers).outputs.data();
+        }
+    }
+
+    template <unsigned L>
+    void forwardLayer()
+    {
+        constexpr unsigned In = sizes[L];
+        constexpr unsigned Out = sizes[L + 1];
+        auto &layer = get<L>(m_layers);
+        const double *in = layerInputs<L>();
+
+        for (unsigned j = 0; j < Out; ++j)
+        {
+            const double *w = &layer.weights[j * In];
+            double potential = 0.0;
+#pragma GCC unroll 16
+            for (unsigned i = 0; i < In; ++i)
+            {
+                potential += in[i] * w[i];
+            }
+            potential += layer.biases[j];
+            layer.potentials[j] = abs(potential) < 1e-14 ? 0.0 : potential;
+        }
+
+        if constexpr (L + 2 < numLayers)
+        {
+#pragma GCC unroll 16
+            for (unsigned j = 0; j < Out; ++j)
+            {
+                layer.outputs[j] = max(0.0, layer.potentials[j]);
+            }
+            forwardLayer<L + 1>();
+        }
+        else
+        {
+            // Softmax on the output layer
+            m_logSumExp = softmax(layer.potentials.data(), layer.outputs.data(), Out);
+        }
+    }
+
+    template <unsigned L>
+    void backwardLayer()
+    {
+        constexpr unsigned In = sizes[L];
+        constexpr unsigned Out = sizes[L + 1];
+        auto &layer = get<L>(m_layers);
+        const double *in = layerInputs<L>();
+
+        // Gradients with respect to the weights
+        for (unsigned j = 0; j < Out; ++j)
+        {
+            const double gradient = layer.gradients[j];
+            double *wg = &layer.weightGradients[j * In];
+#pragma GCC unroll 16
+            for (unsigned i = 0; i < In; ++i)
+            {
+                wg[i] += gradient * in[i];
+            }
+        }
+
+        if constexpr (L > 0)
+        {
+            // Gradients of the previous (hidden) layer
+            auto &prevLayer = get<L - 1>(m_layers);
+            array<double, In> sums{};
+            for (unsigned j = 0; j < Out; ++j)
+            {
+                const double gradient = layer.gradients[j];
+                const double *w = &layer.weights[j * In];
+#pragma GCC unroll 16
+                for (unsigned i = 0; i < In; ++i)
+                {
+                    sums[i] += w[i] * gradient;
+                }
+            }
+#pragma GCC unroll 16
+            for (unsigned i = 0; i < In; ++i)
+            {
+                prevLayer.gradients[i] = prevLayer.potentials[i] < 0.0 ? 0.0 : sums[i];
+            }
+            backwardLayer<L - 1>();
+        }
+    }
+
+    template <size_t N>
+    static void rmsprop(array<double, N> &values, array<double, N> &deltas, const array<double, N> &gradients)
+    {
+        if (fastMathEnabled())
+        {
+            // Same approximation as Neuron::updateWeights()
+#pragma GCC unroll 8
+            for (unsigned i = 0; i < N; ++i)
+            {
+                deltas[i] = decay * deltas[i] + (1 - decay) * gradients[i] * gradients[i];
+                values[i] += -(eta / (fastSqrt(deltas[i]) + epsilon)) * gradients[i];
+            }
+            return;
+        }
+
+#pragma GCC unroll 8
+        for (unsigned i = 0; i < N; ++i)
+        {
+            deltas[i] = decay * deltas[i] + (1 - decay) * gradients[i] * gradients[i];
+            values[i] += -(eta / (sqrt(deltas[i]) + epsilon)) * gradients[i];
+        }
+    }
+
+    template <typename Function, size_t... I>
+    void forEachLayer(Function function, index_sequence<I...>)
+    {
+        (function(get<I>(m_layers)), ...);
+    }
+
+    template <typename Function>
+    void forEachLayer(Function function)
+    {
+        forEachLayer(function, make_index_sequence<numLayers - 1>{});
+    }
+
+    const auto &outputLayer() const { return get<numLayers - 2>(m_layers); }
+
+public:
+    /**
+     * @brief Constructor for the StaticNet class.
+     *
+     * Initializes the weights the same way Net does for the same seed.
+     *
+     * @param seed Seed for random number generation.
+     */
+    StaticNet(unsigned seed)
+    {
+        std::mt19937 generator(seed); // To generate seeds individual to neurons
+        unsigned layerNum = 0;
+
+        forEachLayer([&](auto &layer) {
+            const unsigned numInputs = sizes[layerNum];
+            const unsigned numOutputs = sizes[layerNum + 1];
+
+            // One seed per source neuron, the last one belongs to the bias
+            for (unsigned i = 0; i <= numInputs; ++i)
+            {
+                std::mt19937 neuronGenerator(generator());
+                for (unsigned j = 0; j < numOutputs; ++j)
+                {
+                    std::mt19937 weightGenerator(neuronGenerator());
+                    std::normal_distribution<> distribution(0, std::sqrt(2.0 / numInputs));
+                    double weight = distribution(weightGenerator);
+                    (i < numInputs ? layer.weights[j * numInputs + i] : layer.biases[j]) = weight;
+                }
+            }
+            layer.weightDeltas.fill(0.0);
+            layer.weightGradients.fill(0.0);
+            ++layerNum;
+        });
+    }
+
+    /**
+     * @brief Topology of this specialization.
+     * @return Number of neurons in each layer.
+     */
+    static vector<unsigned> topology() { return vector<unsigned>(sizes, sizes + numLayers); }
+
+    /**
+     * @brief Set the learning rate used by updateWeights().
+     * @param learningRate Learning rate value.
+     */
+    static void setLearningRate(double learningRate) { eta = learningRate; }
+
+    /**
+     * @brief Perform a feedforward pass to compute the network output.
+     * @param inputVals Vector containing the input values to the network.
+     */
+    void feedForward(const vector<double> &inputVals)
+    {
+        assert(inputVals.size() == sizes[0]);
+        copy(inputVals.begin(), inputVals.end(), m_inputs.begin());
+        forwardLayer<0>();
+    }
+
+    /**
+     * @brief Get the results (output values) of the neural network.
+     * @param resultVals Vector to store the output values.
+     */
+    void getResults(vector<double> &resultVals) const
+    {
+        resultVals.assign(outputLayer().outputs.begin(), outputLayer().outputs.end());
+    }
+
+    /**
+     * @brief Calculate the loss (categorical cross-entropy) between the network output and target values.
+     * @param targetVals Target values for the output layer.
+     * @return Loss value.
+     */
+    double getLoss(const vector<double> &targetVals)
+    {
+        return crossEntropy(outputLayer().potentials.data(), outputLayer().outputs.data(), m_logSumExp,
+                            targetVals.data(), nullptr, sizes[numLayers - 1]);
+    }
+
+    /**
+     * @brief Backpropagate the error and accumulate the weight gradients.
+     * @param targetVals Target values for the output layer.
+     */
+    void backProp(const vector<double> &targetVals)
+    {
+        auto &layer = get<numLayers - 2>(m_layers);
+        m_error = crossEntropy(layer.potentials.data(), layer.outputs.data(), m_logSumExp,
+                               targetVals.data(), layer.gradients.data(), sizes[numLayers - 1]);
+        backwardLayer<numLayers - 2>();
+    }
+
+    /**
+     * @brief Get the loss computed by the last backProp() call.
+     * @return Loss value (categorical cross-entropy).
+     */
+    double getError() const { return m_error; }
+
+    /**
+     * @brief Update the weights using the RMSprop optimization algorithm.
+     */
+    void updateWeights()
+    {
+        forEachLayer([](auto &layer) {
+            rmsprop(layer.weights, layer.weightDeltas, layer.weightGradients);
+        });
+    }
+
+    /**
+     * @brief Calculate the average gradient of each weight over a mini-batch.
+     * @param batchSize Number of training examples in the mini-batch.
+     */
+    void calcAvgGradient(unsigned int batchSize)
+    {
+        const double scale = 1.0 / batchSize;
+        forEachLayer([scale](auto &layer) {
+            for (double &g : layer.weightGradients)
+            {
+                g *= scale;
+            }
+        });
+    }
+
+    /**
+     * @brief Reset the gradient sum for each weight in the network.
+     */
+    void resetGradientSum()
+    {
+        forEachLayer([](auto &layer) {
+            layer.weightGradients.fill(0.0);
+        });
+    }
+
+    /**
+     * @brief Compare the predicted output with the ground truth label.
+     * @param output Predicted output vector.
+     * @param label Ground truth label vector.
+     * @return 1 if the prediction is correct, 0 otherwise.
+     */
+    int compare_result(const vector<double> &output, const vector<double> &label)
+    {
+        auto maxElementIter = max_element(output.begin(), output.end());
+        auto maxElementIter_l = max_element(label.begin(), label.end());
+        return distance(output.begin(), maxElementIter) == distance(label.begin(), maxElementIter_l);
+    }
+
+    /**
+     * @brief Dropout is not supported by the specialized kernels, only disabling it is accepted.
+     * @param layer_num Index of the layer.
+     * @param probability Dropout probability, must be 0.
+     */
+    void setDropout(unsigned int layer_num, double probability)
+    {
+        (void)layer_num;
+        assert(probability == 0.0);
+        (void)probability;
+    }
+};
+
+#endif // STATIC_NET_HPP
@@ -0,0 +1,281 @@
+/**
+ * @file sweep.cpp
+ * @brief Implementation of the hyperparameter sweep.
+ */
+
+#include "sweep.hpp"
+#include "random.hpp"
+#include "fast_math.hpp"
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <numeric>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <stdexcept>
+
+/**
+ * @brief Parse a topology written as comma-separated layer sizes.
+ */
+static vector<unsigned> parseSweepTopology(const string &value)
+{
+    vector<unsigned> topology;
+    stringstream sizes(value);
+    string size;
+    while (getline(sizes, size, ','))
+    {
+        size_t pos;
+        topology.push_back(stoul(size, &pos));
+        if (pos != size.size())
+        {
+            throw invalid_argument("Not a valid unsigned integer: " + size);
+        }
+    }
+    if (topology.size() < 3)
+    {
+        throw invalid_argument("A topology needs at least 3 layers: " + value);
+    }
+    return topology;
+}
+
+/**
+ * @brief Parse a learning rate, which must be positive.
+ */
+static double parseSweepLearningRate(const string &value)
+{
+    const double learningRate = stod(value);
+    if (!isFiniteBits(learningRate) || learningRate <= 0.0)
+    {
+        throw invalid_argument("Learning rate must be positive");
+    }
+    return learningRate;
+}
+
+/**
+ * @brief Parse a dropout probability, which must be in [0, 1) like the one of -d.
+ */
+static double parseSweepDropout(const string &value)
+{
+    const double dropout = stod(value);
+    if (!isFiniteBits(dropout) || dropout < 0.0 || dropout >= 1.0)
+    {
+        throw invalid_argument("Dropout probability must be in [0, 1)");
+    }
+    return dropout;
+}
+
+vector<SweepConfig> readSweep(const string &path, const SweepConfig &defaults)
+{
+    ifstream file(path);
+    if (!file.is_open())
+    {
+        throw runtime_error("Unable to open file: " + path);
+    }
+
+    vector<SweepConfig> configs;
+    string line;
+    for (unsigned lineNum = 1; getline(file, line); ++lineNum)
+    {
+        stringstream tokens(line);
+        string token;
+        if (!(tokens >> token) || token[0] == '#')
+        {
+            continue;
+        }
+
+        SweepConfig config = defaults;
+        do
+        {
+            const size_t equals = token.find('=');
+            const string key = token.substr(0, equals);
+            const string value = equals == string::npos ? "" : token.substr(equals + 1);
+            try
+            {
+                if (key == "topology") config.topology = parseSweepTopology(value);
+                else if (key == "lr") config.learningRate = parseSweepLearningRate(value);
+                else if (key == "batch") config.batchSize = stoul(value);
+                else if (key == "epochs") config.epochs = stoul(value);
+                else if (key == "optimizer") config.optimizer = parseOptimizer(value);
+                else if (key == "activation") config.activation = parseActivation(value);
+                else if (key == "dropout") config.dropout = parseSweepDropout(value);
+                else if (key == "seed") config.seed = stoul(value);
+                else throw invalid_argument("unknown key " + key);
+            }
+            catch (const exception &error)
+            {
+                throw invalid_argument(path + ":" + to_string(lineNum) + ": " + token + ": " + error.what());
+            }
+        } while (tokens >> token);
+
+        if (config.topology.empty() || config.batchSize == 0)
+        {
+            throw invalid_argument(path + ":" + to_string(lineNum) + ": no topology or batch size");
+        }
+        configs.push_back(config);
+    }
+    return configs;
+}
+
+/**
+ * @brief Train one configuration, reading the dataset through its const accessors only.
+ */
+static SweepResult trainConfig(const SweepConfig &config, const InputData &inputs, const LabelData &labels)
+{
+    SweepResult result;
+    result.config = config;
+    auto start = chrono::steady_clock::now();
+
+    Net net(config.topology, config.seed, config.activation);
+    net.setLearningRate(config.learningRate);
+    net.setOptimizer(config.optimizer);
+    net.reserveRows(config.batchSize);
+    seedThreadGenerator(config.seed);
+
+    const unsigned numInputs = config.topology.front(), numOutputs = config.topology.back();
+    const unsigned batchSize = config.batchSize;
+    vector<double> batchInputs(batchSize * numInputs), batchLabels(batchSize * numOutputs);
+
+    // The model's own sample order
+    vector<unsigned> order(inputs.trainLength());
+    iota(order.begin(), order.end(), 0);
+    mt19937 generator(config.seed);
+
+    for (unsigned epoch = 0; epoch < config.epochs; ++epoch)
+    {
+        shuffle(order.begin(), order.end(), generator);
+        for (unsigned layerNum = 1; layerNum + 1 < config.topology.size(); ++layerNum)
+        {
+            net.setDropout(layerNum, config.dropout);
+        }
+
+        double lossSum = 0.0;
+        const unsigned numBatches = inputs.trainLength() / batchSize;
+        for (unsigned batch = 0; batch < numBatches; ++batch)
+        {
+            for (unsigned i = 0; i < batchSize; ++i)
+            {
+                const vector<double> &input = inputs.getTrain(order[batch * batchSize + i]);
+                const vector<double> &label = labels.getTrain(order[batch * batchSize + i]);
+                copy(input.begin(), input.end(), batchInputs.begin() + i * numInputs);
+                copy(label.begin(), label.end(), batchLabels.begin() + i * numOutputs);
+            }
+
+            net.resetGradientSum();
+            lossSum += net.forwardBackward(batchInputs.data(), batchLabels.data(), batchSize);
+            net.calcAvgGradient(batchSize);
+            net.updateWeights();
+        }
+        result.trainLoss = lossSum / max(numBatches * batchSize, 1u);
+    }
+
+    // Validation accuracy, a batch at a time
+    for (unsigned layerNum = 0; layerNum < config.topology.size(); ++layerNum)
+    {
+        net.setDropout(layerNum, 0.0);
+    }
+    unsigned correct = 0;
+    for (unsigned first = 0; first < inputs.validLength(); first += batchSize)
+    {
+        const unsigned rows = min(batchSize, inputs.validLength() - first);
+        for (unsigned i = 0; i < rows; ++i)
+        {
+            const vector<double> &input = inputs.getValid(first + i);
+            copy(input.begin(), input.end(), batchInputs.begin() + i * numInputs);
+        }
+        net.feedForward(batchInputs.data(), rows);
+
+        const double *outputs = net.getOutputs();
+        for (unsigned i = 0; i < rows; ++i)
+        {
+            const vector<double> &label = labels.getValid(first + i);
+            const double *row = outputs + i * numOutputs;
+            correct += distance(row, max_element(row, row + numOutputs)) ==
+                       distance(label.begin(), max_element(label.begin(), label.end()));
+        }
+    }
+    result.validationAccuracy = inputs.validLength() > 0 ? double(correct) / inputs.validLength() : 0.0;
+    result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+vector<SweepResult> runSweep(const vector<SweepConfig> &configs, const InputData &inputs,
+                             const LabelData &labels, unsigned threads)
+{
+    // Longest jobs first
+    vector<double> costs;
+    for (const SweepConfig &config : configs)
+    {
+        if (inputs.trainLength() > 0 && (config.topology.front() != inputs.getTrain(0).size() ||
+                                         config.topology.back() != labels.getTrain(0).size()))
+        {
+            throw invalid_argument("Topology does not match the input and label sizes of the dataset");
+        }
+        if (config.batchSize > inputs.trainLength())
+        {
+            throw invalid_argument("Batch size " + to_string(config.batchSize) + " is larger than the training set (" +
+                                   to_string(inputs.trainLength()) + " samples)");
+        }
+        double weights = 0.0;
+        for (unsigned layerNum = 0; layerNum + 1 < config.topology.size(); ++layerNum)
+        {
+            weights += double(config.topology[layerNum]) * config.topology[layerNum + 1];
+        }
+        costs.push_back(weights * config.epochs);
+    }
+    vector<unsigned> schedule(configs.size());
+    iota(schedule.begin(), schedule.end(), 0);
+    stable_sort(schedule.begin(), schedule.end(), [&costs](unsigned a, unsigned b) { return costs[a] > costs[b]; });
+
+    vector<SweepResult> results(configs.size());
+    atomic<unsigned> next(0);
+    auto work = [&]() {
+        for (unsigned job = next++; job < schedule.size(); job = next++)
+        {
+            const unsigned index = schedule[job];
+            results[index] = trainConfig(configs[index], inputs, labels);
+        }
+    };
+
+    vector<thread> workers;
+    for (unsigned worker = 1; worker < min<size_t>(max(threads, 1u), configs.size()); ++worker)
+    {
+        workers.emplace_back(work);
+    }
+    work();
+    for (thread &worker : workers)
+    {
+        worker.join();
+    }
+    return results;
+}
+
+void printSweep(vector<SweepResult> results)
+{
+    stable_sort(results.begin(), results.end(), [](const SweepResult &a, const SweepResult &b) {
+        return a.validationAccuracy > b.validationAccuracy;
+    });
+
+    cout << setw(5) << "rank" << setw(22) << "topology" << setw(10) << "lr" << setw(7) << "batch"
+         << setw(8) << "epochs" << setw(10) << "optimizer" << setw(12) << "activation" << setw(9) << "dropout"
+         << setw(12) << "train loss" << setw(11) << "valid acc" << setw(10) << "time [s]" << endl;
+
+    for (unsigned rank = 0; rank < results.size(); ++rank)
+    {
+        const SweepConfig &config = results[rank].config;
+        string topology;
+        for (unsigned size : config.topology)
+        {
+            topology += (topology.empty() ? "" : ",") + to_string(size);
+        }
+
+        cout << setw(5) << rank + 1 << setw(22) << topology << setw(10) << defaultfloat << config.learningRate
+             << setw(7) << config.batchSize << setw(8) << config.epochs
+             << setw(10) << optimizerName(config.optimizer)
+             << setw(12) << activationName(config.activation)
+             << setw(9) << config.dropout
+             << fixed << setprecision(4) << setw(12) << results[rank].trainLoss
+             << setw(11) << results[rank].validationAccuracy
+             << setprecision(2) << setw(10) << results[rank].seconds << defaultfloat << setprecision(6) << endl;
+    }
+}
@@ -0,0 +1,132 @@
+/**
+ * @file sweep.hpp
+ * @brief Declaration of the hyperparameter sweep, training many models concurrently on one dataset.
+ */
+#ifndef SWEEP_HPP
+#define SWEEP_HPP
+
+#include <vector>
+#include <string>
+#include "net.hpp"
+#include "input_data.hpp"
+#include "label_data.hpp"
+
+using namespace std;
+
+/**
+ * @struct SweepConfig
+ * @brief Hyperparameters of one model of a sweep.
+ */
+struct SweepConfig
+{
+    /**
+     * @brief Number of neurons in each layer.
+     */
+    vector<unsigned> topology;
+
+    /**
+     * @brief Learning rate.
+     */
+    double learningRate = 0.01;
+
+    /**
+     * @brief Size of the mini-batches.
+     */
+    unsigned batchSize = 1;
+
+    /**
+     * @brief Number of epochs.
+     */
+    unsigned epochs = 1;
+
+    /**
+     * @brief Update rule of the weights.
+     */
+    Optimizer optimizer = Optimizer::RMSProp;
+
+    /**
+     * @brief Activation function of the hidden layers.
+     */
+    Activation activation = Activation::ReLU;
+
+    /**
+     * @brief Dropout probability of the hidden layers during training.
+     */
+    double dropout = 0.0;
+
+    /**
+     * @brief Seed of the weights, the shuffles and the dropout masks.
+     */
+    unsigned seed = 42;
+};
+
+/**
+ * @struct SweepResult
+ * @brief Outcome of training one model of a sweep.
+ */
+struct SweepResult
+{
+    /**
+     * @brief The hyperparameters.
+     */
+    SweepConfig config;
+
+    /**
+     * @brief Average training loss of the last epoch, measured during training.
+     */
+    double trainLoss = 0.0;
+
+    /**
+     * @brief Accuracy on the validation set after the last epoch.
+     */
+    double validationAccuracy = 0.0;
+
+    /**
+     * @brief Wall-clock training time in seconds.
+     */
+    double seconds = 0.0;
+};
+
+/**
+ * @brief Read the configurations of a sweep from a file.
+ *
+ * Every non-empty line not starting with `#` is one configuration of whitespace-separated
+ * `key=value` pairs: `topology=784,64,32,10`, `lr=0.001`, `batch=32`, `epochs=5`,
+ * `optimizer=rmsprop|sgd`, `activation=relu|leaky_relu|gelu|identity`, `dropout=0.1`,
+ * `seed=42`. Missing keys take their values from `defaults`.
+ *
+ * @param path Path of the file.
+ * @param defaults Values of the keys missing on a line.
+ * @return The configurations in file order.
+ * @throws std::runtime_error if the file cannot be read.
+ * @throws std::invalid_argument if a line is malformed, has no topology, a learning rate
+ * that is not positive or a dropout probability outside [0, 1).
+ */
+vector<SweepConfig> readSweep(const string &path, const SweepConfig &defaults);
+
+/**
+ * @brief Train all configurations concurrently on a shared dataset.
+ *
+ * The dataset is only read: every model keeps its own sample order, so the models
+ * neither copy the data nor interfere with each other. Models are scheduled on a pool
+ * of threads, the most expensive ones (weights times epochs) first, so the longest
+ * runs do not end up last.
+ *
+ * @param configs The configurations.
+ * @param inputs The input data, split into training and validation sets.
+ * @param labels The labels, split into training and validation sets.
+ * @param threads Number of models trained at the same time.
+ * @return The results, in the order of the configurations.
+ * @throws std::invalid_argument if a topology does not match the dataset or a batch is larger
+ * than the training set.
+ */
+vector<SweepResult> runSweep(const vector<SweepConfig> &configs, const InputData &inputs,
+                             const LabelData &labels, unsigned threads);
+
+/**
+ * @brief Print the results as a table ranked by validation accuracy.
+ * @param results The results.
+ */
+void printSweep(vector<SweepResult> results);
+
+#endif // SWEEP_HPP
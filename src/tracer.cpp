@@ -0,0 +1,237 @@
+/**
+ * @file tracer.cpp
+ * @brief Implementation of the timeline tracer.
+ */
+
+#include "tracer.hpp"
+#include <unistd.h>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <mutex>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+atomic<bool> Tracer::s_enabled(false);
+thread_local unsigned Tracer::s_summaryDepth = 0;
+
+/**
+ * @brief A recorded scope.
+ */
+struct TraceEvent
+{
+    /**
+     * @brief Name, a string literal.
+     */
+    const char *name;
+
+    /**
+     * @brief Index shown with the name, negative for none.
+     */
+    int arg;
+
+    /**
+     * @brief Begin time in nanoseconds.
+     */
+    int64_t begin;
+
+    /**
+     * @brief End time in nanoseconds.
+     */
+    int64_t end;
+};
+
+/**
+ * @brief Ring buffer of the events of one thread.
+ */
+struct TraceBuffer
+{
+    /**
+     * @brief The events, `count % Tracer::capacity` is the next one to write.
+     */
+    unique_ptr<TraceEvent[]> events;
+
+    /**
+     * @brief Number of events recorded, written by the owner thread only.
+     */
+    atomic<uint64_t> count;
+
+    /**
+     * @brief Name of the thread in the trace.
+     */
+    string name;
+};
+
+/**
+ * @brief Buffers of all threads that have recorded, kept after the threads exit.
+ */
+static vector<unique_ptr<TraceBuffer>> traceBuffers;
+
+/**
+ * @brief Guards traceBuffers (taken once per thread, not per event).
+ */
+static mutex traceBuffersMutex;
+
+/**
+ * @brief Buffer of the calling thread, nullptr until its first event.
+ */
+static thread_local TraceBuffer *threadTraceBuffer = nullptr;
+
+/**
+ * @brief Time start() was called, the origin of the trace.
+ */
+static int64_t traceOrigin = 0;
+
+/**
+ * @brief Get the buffer of the calling thread, registering it on first use.
+ */
+static TraceBuffer &threadBuffer()
+{
+    if (!threadTraceBuffer)
+    {
+        auto buffer = make_unique<TraceBuffer>();
+        buffer->events = make_unique<TraceEvent[]>(Tracer::capacity);
+        buffer->count.store(0, memory_order_relaxed);
+
+        lock_guard<mutex> lock(traceBuffersMutex);
+        buffer->name = traceBuffers.empty() ? "main" : "thread " + to_string(traceBuffers.size());
+        threadTraceBuffer = buffer.get();
+        traceBuffers.push_back(move(buffer));
+    }
+    return *threadTraceBuffer;
+}
+
+int64_t Tracer::now()
+{
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Tracer::start()
+{
+    traceOrigin = now();
+    threadBuffer();
+    s_enabled.store(true, memory_order_relaxed);
+}
+
+void Tracer::discard()
+{
+    s_enabled.store(false, memory_order_relaxed);
+    lock_guard<mutex> lock(traceBuffersMutex);
+    for (unique_ptr<TraceBuffer> &buffer : traceBuffers)
+    {
+        buffer->count.store(0, memory_order_relaxed);
+    }
+}
+
+void Tracer::setThreadName(const string &name)
+{
+    if (enabled())
+    {
+        TraceBuffer &buffer = threadBuffer();
+        lock_guard<mutex> lock(traceBuffersMutex);
+        buffer.name = name;
+    }
+}
+
+void Tracer::record(const char *name, int arg, int64_t begin, int64_t end)
+{
+    TraceBuffer &buffer = threadBuffer();
+    const uint64_t count = buffer.count.load(memory_order_relaxed);
+    buffer.events[count % capacity] = TraceEvent{name, arg, begin, end};
+    buffer.count.store(count + 1, memory_order_release);
+}
+
+void Tracer::write(const string &path)
+{
+    s_enabled.store(false, memory_order_relaxed);
+
+    ofstream file(path);
+    if (!file.is_open())
+    {
+        throw runtime_error("Unable to open file: " + path);
+    }
+
+    const int pid = getpid();
+    uint64_t overwritten = 0;
+    bool first = true;
+    auto separator = [&]() -> const char * {
+        const char *text = first ? "\n" : ",\n";
+        first = false;
+        return text;
+    };
+
+    lock_guard<mutex> lock(traceBuffersMutex);
+    file << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [" << fixed << setprecision(3);
+    for (unsigned tid = 0; tid < traceBuffers.size(); ++tid)
+    {
+        const TraceBuffer &buffer = *traceBuffers[tid];
+        const uint64_t count = buffer.count.load(memory_order_acquire);
+        if (count == 0)
+        {
+            continue;
+        }
+        file << separator() << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": " << pid << ", \"tid\": " << tid
+             << ", \"args\": {\"name\": \"" << buffer.name << "\"}}";
+
+        // Oldest kept event first
+        const uint64_t kept = min<uint64_t>(count, capacity);
+        overwritten += count - kept;
+        for (uint64_t i = count - kept; i < count; ++i)
+        {
+            const TraceEvent &event = buffer.events[i % capacity];
+            file << separator() << "{\"name\": \"" << event.name;
+            if (event.arg >= 0)
+            {
+                file << " " << event.arg;
+            }
+            file << "\", \"ph\": \"X\", \"pid\": " << pid << ", \"tid\": " << tid
+                 << ", \"ts\": " << (event.begin - traceOrigin) * 1e-3 << ", \"dur\": " << (event.end - event.begin) * 1e-3;
+            if (event.arg >= 0)
+            {
+                file << ", \"args\": {\"index\": " << event.arg << "}";
+            }
+            file << "}";
+        }
+    }
+    file << "\n], \"otherData\": {\"overwritten_events\": " << overwritten << "}}" << endl;
+}
+
+// ---------------------------------------------------------------------------
+// TraceFile
+// ---------------------------------------------------------------------------
+
+TraceFile::TraceFile(const string &path) :
+    m_path(path)
+{
+    if (!m_path.empty())
+    {
+        Tracer::start();
+    }
+}
+
+TraceFile::~TraceFile()
+{
+    if (m_path.empty())
+    {
+        return;
+    }
+    try
+    {
+        Tracer::write(m_path);
+    }
+    catch (const exception &error)
+    {
+        cerr << error.what() << endl;
+    }
+}
+
+void TraceFile::discard()
+{
+    if (!m_path.empty())
+    {
+        Tracer::discard();
+        m_path.clear();
+    }
+}
@@ -0,0 +1,183 @@
+/**
+ * @file tracer.hpp
+ * @brief Declaration of the timeline tracer writing Chrome trace-event JSON.
+ */
+#ifndef TRACER_HPP
+#define TRACER_HPP
+
+#include <string>
+#include <atomic>
+#include <cstdint>
+
+using namespace std;
+
+/**
+ * @class Tracer
+ * @brief Records the begin and end of scopes on every thread and writes them as a
+ * Chrome trace-event file, viewable in Perfetto (ui.perfetto.dev) or chrome://tracing.
+ *
+ * Every thread writes its events into its own ring buffer, allocated on its first event,
+ * so recording takes no locks: one thread writes a buffer and publishes its position with
+ * a release store. When a buffer is full, the oldest events are overwritten. Tracing is
+ * off until start() is called; a disabled TraceScope costs one relaxed load.
+ */
+class Tracer
+{
+public:
+    /**
+     * @brief Number of events kept per thread.
+     */
+    static const unsigned capacity = 1 << 16;
+
+    /**
+     * @brief Start recording.
+     */
+    static void start();
+
+    /**
+     * @brief Stop recording, and drop the events recorded so far.
+     */
+    static void discard();
+
+    /**
+     * @brief Stop recording and write the events of all threads.
+     *
+     * The recording threads must not record events while the file is written (they may
+     * still be alive, e.g. idle pipeline stages).
+     *
+     * @param path Path of the file.
+     * @throws std::runtime_error if the file cannot be written.
+     */
+    static void write(const string &path);
+
+    /**
+     * @brief Whether events of the calling thread are recorded (not inside a summary scope).
+     */
+    static bool enabled() { return s_enabled.load(memory_order_relaxed) && s_summaryDepth == 0; }
+
+    /**
+     * @brief Get the current time in nanoseconds since an arbitrary origin.
+     */
+    static int64_t now();
+
+    /**
+     * @brief Name the calling thread in the trace (by default "thread N").
+     * @param name The name.
+     */
+    static void setThreadName(const string &name);
+
+    /**
+     * @brief Record a scope of the calling thread.
+     *
+     * @param name Name of the scope, a string literal (it is not copied).
+     * @param arg Index shown with the name (e.g. of a layer or an epoch), negative for none.
+     * @param begin Begin time (see now()).
+     * @param end End time.
+     */
+    static void record(const char *name, int arg, int64_t begin, int64_t end);
+
+    /**
+     * @brief Number of summary scopes the calling thread is in (see TraceScope).
+     */
+    static thread_local unsigned s_summaryDepth;
+
+private:
+    /**
+     * @brief Whether events are recorded.
+     */
+    static atomic<bool> s_enabled;
+};
+
+/**
+ * @class TraceScope
+ * @brief Records its lifetime as an event of the calling thread when tracing is enabled.
+ *
+ * A summary scope records itself but none of the scopes inside it, so long phases made
+ * of many small steps (e.g. the evaluation, one sample at a time) do not fill the buffer.
+ */
+class TraceScope
+{
+private:
+    /**
+     * @brief Name of the event, a string literal.
+     */
+    const char *m_name;
+
+    /**
+     * @brief Index shown with the name, negative for none.
+     */
+    int m_arg;
+
+    /**
+     * @brief Begin time, negative if tracing was disabled.
+     */
+    int64_t m_begin;
+
+    /**
+     * @brief Whether the scopes inside are not recorded.
+     */
+    bool m_summary;
+
+public:
+    /**
+     * @brief Constructor for the TraceScope class, starting the event.
+     * @param name Name of the event, a string literal.
+     * @param arg Index shown with the name (e.g. of a layer or an epoch), negative for none.
+     * @param summary Whether to leave out the scopes inside this one.
+     */
+    explicit TraceScope(const char *name, int arg = -1, bool summary = false) :
+        m_name(name), m_arg(arg), m_begin(Tracer::enabled() ? Tracer::now() : -1), m_summary(summary && m_begin >= 0)
+    {
+        Tracer::s_summaryDepth += m_summary;
+    }
+
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+    /**
+     * @brief Destructor, recording the event.
+     */
+    ~TraceScope()
+    {
+        if (m_begin >= 0)
+        {
+            Tracer::s_summaryDepth -= m_summary;
+            Tracer::record(m_name, m_arg, m_begin, Tracer::now());
+        }
+    }
+};
+
+/**
+ * @class TraceFile
+ * @brief Traces from construction to destruction into a file, if a path is given.
+ */
+class TraceFile
+{
+private:
+    /**
+     * @brief Path of the file, empty if not tracing.
+     */
+    string m_path;
+
+public:
+    /**
+     * @brief Constructor for the TraceFile class, starting the tracer if a path is given.
+     * @param path Path of the file, empty to not trace.
+     */
+    explicit TraceFile(const string &path);
+
+    TraceFile(const TraceFile &) = delete;
+    TraceFile &operator=(const TraceFile &) = delete;
+
+    /**
+     * @brief Destructor, writing the file (errors are reported on the standard error output).
+     */
+    ~TraceFile();
+
+    /**
+     * @brief Stop tracing without writing the file (e.g. in the processes of a group except the first).
+     */
+    void discard();
+};
+
+#endif // TRACER_HPP